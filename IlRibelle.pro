@@ -3,6 +3,9 @@ TEMPLATE = app
 QT += qml quick widgets svg multimedia
 android: QT += androidextras
 
+# QCborStreamWriter and QCborStreamReader are only available since Qt 5.12
+!versionAtLeast(QT_VERSION, 5.12.0): error("Qt 5.12 or later is required")
+
 # CONFIG += c++14
 QMAKE_CXXFLAGS += -std=c++14 -Wall -Wextra
 
@@ -19,8 +22,15 @@ SOURCES += \
 	src/iconsgenerator.cpp \
 	src/remotefileprovider.cpp \
 	src/remotefileproviderfactory.cpp \
-	src/roleshelpers.cpp \
 	src/ilribellenewscompleter.cpp \
+	src/finiarchiveresolver.cpp \
+	src/squarespacejsoncache.cpp \
+	src/channeljournal.cpp \
+	src/columnarsnapshot.cpp \
+	src/rolescbor.cpp \
+	src/filegarbagecollector.cpp \
+	src/filewriter.cpp \
+	src/storagequota.cpp \
 	MiscNative/miscnative.cpp
 
 android: SOURCES += src/jnionload.cpp \
@@ -66,11 +76,25 @@ HEADERS += \
 	include/defaultchannelcompleter.h \
 	include/defaultnewscompleter.h \
 	include/ilribellenewscompleter.h \
+	include/finiarchiveresolver.h \
+	include/squarespacejsoncache.h \
 	include/channelupdater.h \
 	include/ilribellechannelupdater.h \
 	include/standardroles.h \
 	include/roleshelpers.h \
+	include/rolenamestable.h \
+	include/orderstatisticlist.h \
+	include/newsurlkey.h \
+	include/newssortkey.h \
+	include/newsidentityindex.h \
+	include/slabpool.h \
 	include/rolesqmlaccessor.h \
+	include/channeljournal.h \
+	include/columnarsnapshot.h \
+	include/rolescbor.h \
+	include/filegarbagecollector.h \
+	include/filewriter.h \
+	include/storagequota.h \
 	MiscNative/miscnative.h
 
 ANDROID_PACKAGE_SOURCE_DIR = $$PWD/android
@@ -21,23 +21,143 @@
 #ifndef __ALL_NEWS_COMPLETER_H__
 #define __ALL_NEWS_COMPLETER_H__
 
-#include <QSet>
 #include <functional>
 #include <QHash>
+#include <QList>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QObject>
 #include <QCoreApplication>
+#include <QDebug>
+#include <set>
+#include <utility>
 #include "include/utilities.h"
+#include "include/standardroles.h"
 
 /**
- * \brief The class completing all news of a channel
+ * \brief The criteria used to decide which news are completed and in which
+ *        order
  *
- * This class completes all news from the given channel. The template parameter
+ * An instance of this structure is shared between the ChannelUpdater and the
+ * AllNewsCompleter. News explicitly requested (e.g. because the user opened
+ * them) are completed first, then news in the visible range extended by the
+ * prefetch window. All other news are only completed when
+ * completeOtherNews is true
+ */
+struct NewsCompletionPriorities {
+	/**
+	 * \brief The index of the first visible news or -1 if unknown
+	 */
+	int firstVisibleNews;
+
+	/**
+	 * \brief The index of the last visible news or -1 if unknown
+	 */
+	int lastVisibleNews;
+
+	/**
+	 * \brief The number of news before and after the visible range that
+	 *        are completed together with visible news
+	 */
+	int prefetchWindow;
+
+	/**
+	 * \brief The ids of news to complete before anything else
+	 *
+	 * The first element is the one with the highest priority
+	 */
+	QList<unsigned int> requestedNews;
+
+	/**
+	 * \brief If true also news outside the visible range and prefetch
+	 *        window are completed
+	 */
+	bool completeOtherNews;
+};
+
+namespace __internal {
+	/**
+	 * \brief The number of news completed in parallel when we have no
+	 *        statistics yet
+	 */
+	const int initialParallelNews = 3;
+
+	/**
+	 * \brief The weight of a new sample in the moving averages of latency
+	 *        and error rate
+	 */
+	const double completionStatsWeight = 0.2;
+
+	/**
+	 * \brief Above this error rate we reduce the number of news completed
+	 *        in parallel
+	 */
+	const double maxCompletionErrorRate = 0.25;
+
+	/**
+	 * \brief If the latency of a completion is this many times the average
+	 *        we reduce the number of news completed in parallel
+	 */
+	const double completionLatencySlowdown = 2.0;
+
+	/**
+	 * \brief The delay in milliseconds before retrying a failed completion
+	 *        for the first time. It is doubled at every failure
+	 */
+	const qint64 firstCompletionRetryDelay = 10000;
+
+	/**
+	 * \brief The maximum delay in milliseconds before retrying a failed
+	 *        completion
+	 */
+	const qint64 maxCompletionRetryDelay = 600000;
+
+	/**
+	 * \brief The number of failed attempts (not counting network errors)
+	 *        after which a news is no longer completed in background
+	 */
+	const int maxCompletionAttempts = 5;
+
+	/**
+	 * \brief The interval in milliseconds between checks of completion
+	 *        deadlines and retries
+	 */
+	const int completionWatchdogInterval = 1000;
+}
+
+/**
+ * \brief The class completing the news of a channel
+ *
+ * This class completes news from the given channel. The template parameter
  * Channel is the Channel class (must be a template instantiation of the Channel
- * class). Instances of this class call the workFinishedCallback functional when
- * all news have been completed. After calling start(), you should wait for the
- * functional to  be called before deleting this object. If you call start more
- * than once while news are already been completed, nothing happends. If you
- * call start again after the functional has been called, news are completed
- * again (only news that are not yet complete)
+ * class). An instance of this class lives as long as the channel: it keeps an
+ * up-to-date queue of news that are not complete (ordered by publication date,
+ * newest first) listening to the signals of the channel, so that no scan of
+ * all news is needed when completion starts. Which news are completed and in
+ * which order depends on the NewsCompletionPriorities object passed to the
+ * constructor: explicitly requested news first, then visible news, then news
+ * in the prefetch window (nearest first) and finally, if allowed, all other
+ * news from the newest to the oldest. News whose attached files were evicted
+ * to free space (see the attachmentsEvicted role) are never completed as
+ * "other news", only when requested, visible or in the prefetch window.
+ *
+ * The number of news completed in parallel adapts itself between the bounds
+ * given in the constructor: it grows slowly while completions succeed with a
+ * stable latency and shrinks when latency increases or errors become frequent.
+ * Every completion has a deadline: when it expires the news completer is
+ * aborted so that its slot is freed. News whose completion failed or timed out
+ * are retried later with an exponential backoff. After too many failures that
+ * are not due to the network we stop completing the news in background: it
+ * stays incomplete and is still retried (with the maximum backoff) when it is
+ * visible, in the prefetch window or requested. Network errors and timeouts
+ * never make us give up, they only delay the next attempt.
+ *
+ * Call start() to begin completing news. The workFinishedCallback functional
+ * is called when there is nothing more to complete according to the
+ * priorities, after that isRunning() returns false. If priorities change while
+ * news are being completed, call prioritiesChanged(). Calling start() while
+ * news are being completed does nothing
  */
 template <class ChannelType, class NewsCompleter>
 class AllNewsCompleter
@@ -47,19 +167,37 @@ public:
 	 * \brief Constructor
 	 *
 	 * \param channel the channel with the news to complete
+	 * \param priorities the criteria to choose news to complete. The
+	 *                   object must remain valid for the whole lifetime of
+	 *                   this object
 	 * \param workFinishedCallback the functional to call when all news have
 	 *                             been completed
+	 * \param minParallelNews the minimum number of news that are completed
+	 *                        in parallel
 	 * \param maxParallelNews the maximum number of news that are completed
-	 *                        in parallel. If negative all news are
-	 *                        completed in parallel
+	 *                        in parallel
+	 * \param completionTimeout the time in milliseconds after which the
+	 *                          completion of a news is aborted
 	 */
-	AllNewsCompleter(ChannelType* channel, const std::function<void()>& workFinishedCallback, int maxParallelNews = 3);
+	AllNewsCompleter(ChannelType* channel, const NewsCompletionPriorities* priorities, const std::function<void()>& workFinishedCallback, int minParallelNews = 1, int maxParallelNews = 6, int completionTimeout = 60000);
 
 	/**
 	 * \brief Destructor
+	 *
+	 * This aborts all news completers that are still running
 	 */
 	~AllNewsCompleter();
 
+	/**
+	 * \brief Copy constructor is disabled
+	 */
+	AllNewsCompleter(const AllNewsCompleter&) = delete;
+
+	/**
+	 * \brief Copy operator is disabled
+	 */
+	AllNewsCompleter& operator=(const AllNewsCompleter&) = delete;
+
 	/**
 	 * \brief Starts completing news
 	 *
@@ -68,7 +206,89 @@ public:
 	 */
 	void start();
 
+	/**
+	 * \brief Tells this object that priorities have changed
+	 *
+	 * Explicitly requested news are started immediately, even if the
+	 * number of parallel news has already been reached. Free slots are then
+	 * filled with news selected with the new priorities
+	 */
+	void prioritiesChanged();
+
+	/**
+	 * \brief Asks to stop as soon as possible
+	 *
+	 * No new news is started, the workFinishedCallback functional is called
+	 * as soon as the news currently being completed are done
+	 */
+	void stopWhenPossible();
+
+	/**
+	 * \brief Returns true if we are completing news
+	 *
+	 * This is true from the call to start() to the call of the
+	 * workFinishedCallback functional
+	 * \return true if we are completing news
+	 */
+	bool isRunning() const
+	{
+		return m_running;
+	}
+
+	/**
+	 * \brief Returns the current number of news completed in parallel
+	 *
+	 * \return the current number of news completed in parallel
+	 */
+	int numParallelNews() const
+	{
+		return m_numParallelNews;
+	}
+
+	/**
+	 * \brief Allows the news with the given id to be retried immediately
+	 *
+	 * Call this when the user explicitly asks for a news whose completion
+	 * failed, so that it does not wait for the backoff delay. Call
+	 * prioritiesChanged() or start() afterwards
+	 * \param id the id of the news
+	 */
+	void retryNow(unsigned int id);
+
 private:
+	/**
+	 * \brief Adds the news at the given index to the queue of news to
+	 *        complete if it is not complete, removes it otherwise
+	 *
+	 * \param index the index of the news
+	 */
+	void updateIncompleteNews(int index);
+
+	/**
+	 * \brief Removes the news with the given id from the queue of news to
+	 *        complete
+	 *
+	 * \param id the id of the news
+	 */
+	void removeIncompleteNews(unsigned int id);
+
+	/**
+	 * \brief The function called when news are about to be removed from
+	 *        the channel
+	 *
+	 * \param startIndex the index of the first news that will be removed
+	 * \param endIndex the index of the last news that will be removed
+	 */
+	void newsAboutToBeDeleted(int startIndex, int endIndex);
+
+	/**
+	 * \brief The function called when a news of the channel changes
+	 *
+	 * \param index the index of the news
+	 * \param roles the roles that changed
+	 */
+	void newsUpdated(int index, const QVector<int>& roles);
+
 	/**
 	 * \brief The function called when parsing of a news is completed
 	 *
@@ -78,10 +298,83 @@ private:
 	 */
 	void parsingCompleted(unsigned int id);
 
+	/**
+	 * \brief Aborts news completers whose deadline has expired
+	 *
+	 * This is called periodically while we are running. It also starts
+	 * news whose retry time has come
+	 */
+	void checkDeadlines();
+
+	/**
+	 * \brief Updates the number of news completed in parallel
+	 *
+	 * \param latency the time in milliseconds the completion took
+	 * \param success whether the completion was successful or not
+	 */
+	void adaptParallelNews(qint64 latency, bool success);
+
+	/**
+	 * \brief Schedules a new attempt to complete the news with the given id
+	 *
+	 * If completion failed too many times for reasons other than the
+	 * network, the news is removed from the queue of news completed in
+	 * background (see m_incompleteNews)
+	 * \param id the id of the news
+	 * \param networkFailure true if completion failed because of a network
+	 *                       error or a timeout
+	 */
+	void scheduleRetry(unsigned int id, bool networkFailure);
+
+	/**
+	 * \brief Starts completing news until the number of parallel news is
+	 *        reached or there is nothing more to complete
+	 *
+	 * If nothing is being completed at the end and no news is waiting to
+	 * be retried, the workFinishedCallback functional is called
+	 * \param startAllRequested if true all explicitly requested news are
+	 *                          started, even if the number of parallel news
+	 *                          is exceeded
+	 */
+	void fillCompletionSlots(bool startAllRequested);
+
+	/**
+	 * \brief Stops running and calls the workFinishedCallback functional
+	 */
+	void finish();
+
+	/**
+	 * \brief Returns the id of the next news to complete according to
+	 *        priorities
+	 *
+	 * \param onlyRequested if true only explicitly requested news are
+	 *                      considered
+	 * \param id filled with the id of the news to complete
+	 * \param waitingForRetry set to true if there are news that could be
+	 *                        completed but are waiting to be retried
+	 * \return false if there is no news to complete now
+	 */
+	bool nextNewsToComplete(bool onlyRequested, unsigned int& id, bool& waitingForRetry) const;
+
+	/**
+	 * \brief Returns true if the completion of the news with the given id
+	 *        can be started now
+	 *
+	 * \param id the id of the news
+	 * \param now the current time (see m_clock)
+	 * \param waitingForRetry set to true if the news is not complete but is
+	 *                        waiting to be retried
+	 * \return true if the news is not complete, nobody is completing it
+	 *         and it is not waiting to be retried
+	 */
+	bool canStartCompletion(unsigned int id, qint64 now, bool& waitingForRetry) const;
+
 	/**
 	 * \brief The function which starts the completion process for one news
+	 *
+	 * \param newsId the id of the news to complete
 	 */
-	void completeNextNews();
+	void completeNews(unsigned int newsId);
 
 	/**
 	 * \brief A helper function to extract the type of the News from the
@@ -104,28 +397,83 @@ private:
 	 */
 	ChannelType* const m_channel;
 
+	/**
+	 * \brief The criteria to choose news to complete
+	 */
+	const NewsCompletionPriorities* const m_priorities;
+
 	/**
 	 * \brief The functional called when all news have been completed
 	 */
 	std::function<void()> m_workFinishedCallback;
 
+	/**
+	 * \brief The minimum number of news that are completed in parallel
+	 */
+	const int m_minParallelNews;
+
 	/**
 	 * \brief The maximum number of news that are completed in parallel
-	 *
-	 * If negative all news are completed in parallel
 	 */
 	const int m_maxParallelNews;
 
 	/**
-	 * \brief The set of news that will be completed. Elements of the set
-	 *        are news ids
+	 * \brief The time in milliseconds after which a completion is aborted
 	 */
-	QSet<int> m_newsToComplete;
+	const qint64 m_completionTimeout;
 
 	/**
-	 * \brief The number of news being currently completed
+	 * \brief The current number of news that are completed in parallel
 	 */
-	int m_numNewsBeingCompleted;
+	int m_numParallelNews;
+
+	/**
+	 * \brief The moving average of the time needed to complete a news in
+	 *        milliseconds
+	 *
+	 * This is negative until the first completion
+	 */
+	double m_averageLatency;
+
+	/**
+	 * \brief The moving average of the rate of failed completions
+	 */
+	double m_errorRate;
+
+	/**
+	 * \brief The number of successful completions since the last change of
+	 *        m_numParallelNews
+	 */
+	int m_successesSinceLastChange;
+
+	/**
+	 * \brief The queue of news that are not complete
+	 *
+	 * The first element of each pair is minus the publication date in
+	 * milliseconds since epoch, the second one is the news id. This way
+	 * the newest news is the first one
+	 */
+	std::set<std::pair<qint64, unsigned int>> m_incompleteNews;
+
+	/**
+	 * \brief The key of each news in m_incompleteNews
+	 */
+	QHash<unsigned int, qint64> m_incompleteNewsKeys;
+
+	/**
+	 * \brief The structure with information about a news being completed
+	 */
+	struct ActiveCompletion {
+		/**
+		 * \brief The news completer
+		 */
+		NewsCompleter* completer;
+
+		/**
+		 * \brief The time when completion started (see m_clock)
+		 */
+		qint64 startTime;
+	};
 
 	/**
 	 * \brief The map of active news completers
@@ -133,100 +481,550 @@ private:
 	 * This stores the news completer for the given news id. We need this to
 	 * destroy the news completers that have finished their job
 	 */
-	QHash<int, NewsCompleter*> m_activeNewsCompleters;
+	QHash<unsigned int, ActiveCompletion> m_activeCompletions;
+
+	/**
+	 * \brief The structure with information about a news whose completion
+	 *        failed
+	 */
+	struct RetryInfo {
+		/**
+		 * \brief The number of failed attempts, used to compute the
+		 *        backoff delay
+		 */
+		int attempts;
+
+		/**
+		 * \brief The number of failed attempts not due to the network
+		 */
+		int failures;
+
+		/**
+		 * \brief True if we gave up completing the news in background
+		 */
+		bool givenUp;
+
+		/**
+		 * \brief The time after which we can try again (see m_clock)
+		 */
+		qint64 retryTime;
+	};
+
+	/**
+	 * \brief The map of news whose completion has failed
+	 */
+	QHash<unsigned int, RetryInfo> m_retries;
+
+	/**
+	 * \brief The clock used to measure times
+	 */
+	QElapsedTimer m_clock;
+
+	/**
+	 * \brief The timer to periodically check deadlines and retries
+	 */
+	QTimer m_watchdogTimer;
+
+	/**
+	 * \brief The index of the news that is being added to the channel
+	 */
+	int m_indexOfNewsToAdd;
+
+	/**
+	 * \brief The connections to signals of the channel
+	 *
+	 * We need them to disconnect in the destructor
+	 */
+	QList<QMetaObject::Connection> m_channelConnections;
+
+	/**
+	 * \brief True between the call to start() and the call to the
+	 *        workFinishedCallback functional
+	 */
+	bool m_running;
+
+	/**
+	 * \brief If true no more news are started
+	 */
+	bool m_stopping;
+
+	/**
+	 * \brief True while we are inside fillCompletionSlots()
+	 *
+	 * News completers may finish synchronously inside start(), this
+	 * prevents recursive calls
+	 */
+	bool m_fillingSlots;
 };
 
 // Implemetation of template functions
 
 template <class ChannelType, class NewsCompleter>
-AllNewsCompleter<ChannelType, NewsCompleter>::AllNewsCompleter(ChannelType* channel, const std::function<void()>& workFinishedCallback, int maxParallelNews)
+AllNewsCompleter<ChannelType, NewsCompleter>::AllNewsCompleter(ChannelType* channel, const NewsCompletionPriorities* priorities, const std::function<void()>& workFinishedCallback, int minParallelNews, int maxParallelNews, int completionTimeout)
 	: m_channel(channel)
+	, m_priorities(priorities)
 	, m_workFinishedCallback(workFinishedCallback)
-	, m_maxParallelNews(maxParallelNews)
-	, m_newsToComplete()
-	, m_numNewsBeingCompleted(0)
-	, m_activeNewsCompleters()
+	, m_minParallelNews(qMax(1, minParallelNews))
+	, m_maxParallelNews(qMax(m_minParallelNews, maxParallelNews))
+	, m_completionTimeout(completionTimeout)
+	, m_numParallelNews(qBound(m_minParallelNews, __internal::initialParallelNews, m_maxParallelNews))
+	, m_averageLatency(-1.0)
+	, m_errorRate(0.0)
+	, m_successesSinceLastChange(0)
+	, m_incompleteNews()
+	, m_incompleteNewsKeys()
+	, m_activeCompletions()
+	, m_retries()
+	, m_clock()
+	, m_watchdogTimer()
+	, m_indexOfNewsToAdd(-1)
+	, m_channelConnections()
+	, m_running(false)
+	, m_stopping(false)
+	, m_fillingSlots(false)
 {
+	m_clock.start();
+
+	m_watchdogTimer.setInterval(__internal::completionWatchdogInterval);
+	QObject::connect(&m_watchdogTimer, &QTimer::timeout, [this]() { this->checkDeadlines(); });
+
+	// Filling the queue with news already in the channel. From now on the queue is kept
+	// up-to-date using signals from the channel
+	for (int i = 0; i < m_channel->numNews(); ++i) {
+		updateIncompleteNews(i);
+	}
+
+	m_channelConnections.append(QObject::connect(m_channel, &ChannelType::aboutToAddNews, [this](int index) { this->m_indexOfNewsToAdd = index; }));
+	m_channelConnections.append(QObject::connect(m_channel, &ChannelType::newsAdded, [this]() { this->updateIncompleteNews(this->m_indexOfNewsToAdd); }));
+	m_channelConnections.append(QObject::connect(m_channel, &ChannelType::aboutToDeleteNews, [this](int startIndex, int endIndex) { this->newsAboutToBeDeleted(startIndex, endIndex); }));
+	m_channelConnections.append(QObject::connect(m_channel, &ChannelType::newsUpdated, [this](int index, const QVector<int>& roles) { this->newsUpdated(index, roles); }));
 }
 
 template <class ChannelType, class NewsCompleter>
 AllNewsCompleter<ChannelType, NewsCompleter>::~AllNewsCompleter()
 {
-	// Nothing to do here
+	for (const auto& c: m_channelConnections) {
+		QObject::disconnect(c);
+	}
+
+	// Aborting and deleting news completers still running
+	for (const auto& a: m_activeCompletions) {
+		a.completer->abort();
+		delete a.completer;
+	}
 }
 
 template <class ChannelType, class NewsCompleter>
 void AllNewsCompleter<ChannelType, NewsCompleter>::start()
 {
 	// Checking if news are already been completed
-	if (m_numNewsBeingCompleted != 0) {
+	if (m_running) {
 		return;
 	}
 
-	m_newsToComplete.clear();
-	// Filling the set of news to complete with all news not already completed
-	for (int i = 0; i < m_channel->numNews(); ++i) {
-		if (!m_channel->news(i).template getData<NewsRoles::complete>()) {
-			m_newsToComplete.insert(m_channel->news(i).id());
+	m_running = true;
+	m_stopping = false;
+	m_watchdogTimer.start();
+
+	fillCompletionSlots(true);
+}
+
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::prioritiesChanged()
+{
+	if (!m_running || m_stopping) {
+		return;
+	}
+
+	// Requested news do not wait for a free slot
+	fillCompletionSlots(true);
+}
+
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::stopWhenPossible()
+{
+	if (!m_running) {
+		return;
+	}
+
+	m_stopping = true;
+
+	if (m_activeCompletions.isEmpty() && !m_fillingSlots) {
+		finish();
+	}
+}
+
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::updateIncompleteNews(int index)
+{
+	if ((index < 0) || (index >= m_channel->numNews())) {
+		return;
+	}
+
+	const News& news = m_channel->news(index);
+	const unsigned int id = news.id();
+
+	// Removing the news first, the publication date could have changed
+	removeIncompleteNews(id);
+
+	if (!news.template getData<NewsRoles::complete>()) {
+		const qint64 key = -news.template getData<NewsRoles::pubDate>().toMSecsSinceEpoch();
+
+		// News whose files were evicted to free space are only completed when requested or
+		// visible, otherwise they would be downloaded again right away. The same holds for news
+		// we gave up completing in background
+		if (!news.template getData<NewsRoles::attachmentsEvicted>() && !m_retries.value(id).givenUp) {
+			m_incompleteNews.insert(std::make_pair(key, id));
 		}
+		m_incompleteNewsKeys.insert(id, key);
+	} else {
+		m_retries.remove(id);
 	}
+}
 
-	// Checking that we have at least one news to complete
-	if (m_newsToComplete.isEmpty()) {
-		// Nothing to do, we can call the callback
-		m_workFinishedCallback();
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::removeIncompleteNews(unsigned int id)
+{
+	auto it = m_incompleteNewsKeys.find(id);
 
+	if (it != m_incompleteNewsKeys.end()) {
+		m_incompleteNews.erase(std::make_pair(it.value(), id));
+		m_incompleteNewsKeys.erase(it);
+	}
+}
+
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::newsAboutToBeDeleted(int startIndex, int endIndex)
+{
+	for (int i = startIndex; i <= endIndex; ++i) {
+		const unsigned int id = m_channel->news(i).id();
+
+		removeIncompleteNews(id);
+		m_retries.remove(id);
+
+		// If the news is being completed, aborting the completer, it must not use the news
+		// anymore
+		auto it = m_activeCompletions.find(id);
+		if (it != m_activeCompletions.end()) {
+			NewsCompleter* const completer = it.value().completer;
+			m_activeCompletions.erase(it);
+
+			completer->abort();
+			QCoreApplication::postEvent(&(CommandEventReceiver::instance()), new CommandEvent([completer]() { delete completer; }));
+		}
+	}
+
+	// If nothing else is running and we were asked to stop, we have finished. Otherwise free
+	// slots are filled at the next check of deadlines
+	if (m_running && m_stopping && m_activeCompletions.isEmpty() && !m_fillingSlots) {
+		finish();
+	}
+}
+
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::newsUpdated(int index, const QVector<int>& roles)
+{
+	if ((index < 0) || (index >= m_channel->numNews())) {
 		return;
 	}
 
-	// Requesting data for the news to complete. We do at most m_maxParallelNews, but if
-	// m_maxParallelNews is negative, we request all news now
-	const auto newsToRequest = (m_maxParallelNews < 0) ? m_newsToComplete.size() : m_maxParallelNews;
-	while ((m_numNewsBeingCompleted != newsToRequest) && (!m_newsToComplete.isEmpty())) {
-		completeNextNews();
+	const News& news = m_channel->news(index);
+
+	if (roles.isEmpty() || roles.contains(news.template getIndex<NewsRoles::complete>()) || roles.contains(news.template getIndex<NewsRoles::pubDate>()) || roles.contains(news.template getIndex<NewsRoles::attachmentsEvicted>())) {
+		updateIncompleteNews(index);
 	}
 }
 
 template <class ChannelType, class NewsCompleter>
 void AllNewsCompleter<ChannelType, NewsCompleter>::parsingCompleted(unsigned int id)
 {
+	auto it = m_activeCompletions.find(id);
+
+	if (Q_UNLIKELY(it == m_activeCompletions.end())) {
+		qDebug() << "INTERNAL ERROR: completion finished for a news which is not being completed, id:" << id;
+
+		return;
+	}
+
+	NewsCompleter* const completer = it.value().completer;
+	const qint64 latency = m_clock.elapsed() - it.value().startTime;
+	const bool success = completer->succeeded();
+	m_activeCompletions.erase(it);
+
 	// Scheduling the news completer for removal
-	QCoreApplication::postEvent(&(CommandEventReceiver::instance()), new CommandEvent([ptr = m_activeNewsCompleters[id]]() { delete ptr; }));
+	QCoreApplication::postEvent(&(CommandEventReceiver::instance()), new CommandEvent([completer]() { delete completer; }));
+
+	adaptParallelNews(latency, success);
+
+	if (success) {
+		m_retries.remove(id);
+
+		// The completer should have set the news complete. If not, we do not try again
+		removeIncompleteNews(id);
+	} else {
+		scheduleRetry(id, completer->networkFailure());
+	}
+
+	// If the news completer has finished inside start(), fillCompletionSlots() will take care
+	// of everything
+	if (m_fillingSlots) {
+		return;
+	}
+
+	if (m_stopping) {
+		if (m_activeCompletions.isEmpty()) {
+			finish();
+		}
+
+		return;
+	}
+
+	// Enqueueing another request or calling the callback if we have completed everything
+	fillCompletionSlots(false);
+}
+
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::checkDeadlines()
+{
+	const qint64 now = m_clock.elapsed();
+
+	// Collecting completions whose deadline has expired
+	QList<unsigned int> expired;
+	for (auto it = m_activeCompletions.constBegin(); it != m_activeCompletions.constEnd(); ++it) {
+		if ((now - it.value().startTime) > m_completionTimeout) {
+			expired.append(it.key());
+		}
+	}
 
-	m_activeNewsCompleters.remove(id);
+	for (auto id: expired) {
+		NewsCompleter* const completer = m_activeCompletions.take(id).completer;
 
-	// Here we decrement the number of news being completed
-	--m_numNewsBeingCompleted;
+		qDebug() << "Completion of news with id" << id << "timed out";
 
-	// Checking if we have completed everything
-	if (m_newsToComplete.isEmpty() && (m_numNewsBeingCompleted == 0)) {
-		// Ok, we can call the callback
-		m_workFinishedCallback();
+		completer->abort();
+		QCoreApplication::postEvent(&(CommandEventReceiver::instance()), new CommandEvent([completer]() { delete completer; }));
+
+		adaptParallelNews(m_completionTimeout, false);
+		scheduleRetry(id, true);
+	}
+
+	if (m_stopping) {
+		if (m_activeCompletions.isEmpty()) {
+			finish();
+		}
+	} else {
+		// Filling free slots, this also starts news whose retry time has come
+		fillCompletionSlots(false);
+	}
+}
+
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::adaptParallelNews(qint64 latency, bool success)
+{
+	const double w = __internal::completionStatsWeight;
+
+	m_errorRate = (1.0 - w) * m_errorRate + w * (success ? 0.0 : 1.0);
+
+	bool decrease = false;
+	if (!success) {
+		decrease = (m_errorRate > __internal::maxCompletionErrorRate);
+	} else {
+		if (m_averageLatency < 0.0) {
+			m_averageLatency = latency;
+		}
+
+		// If completions are getting much slower, we are probably asking too much to the server
+		// or to the connection
+		decrease = (latency > (__internal::completionLatencySlowdown * m_averageLatency));
+		m_averageLatency = (1.0 - w) * m_averageLatency + w * latency;
+	}
+
+	if (decrease) {
+		m_numParallelNews = qMax(m_minParallelNews, m_numParallelNews - 1);
+		m_successesSinceLastChange = 0;
+	} else if (success && (++m_successesSinceLastChange >= m_numParallelNews) && (m_errorRate <= __internal::maxCompletionErrorRate)) {
+		// Things are going well, trying with one more news in parallel
+		m_numParallelNews = qMin(m_maxParallelNews, m_numParallelNews + 1);
+		m_successesSinceLastChange = 0;
+	}
+}
+
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::scheduleRetry(unsigned int id, bool networkFailure)
+{
+	const int index = m_channel->newsIndexByID(id);
+
+	// The news could have been removed in the meantime
+	if (index == -1) {
+		m_retries.remove(id);
 
 		return;
-	} else if (!m_newsToComplete.isEmpty()) {
-		// If we get here we can enqueue another request
-		completeNextNews();
+	}
+
+	RetryInfo& info = m_retries[id];
+	++info.attempts;
+	if (!networkFailure) {
+		++info.failures;
+	}
+
+	// Limiting the shift to avoid overflows, the delay is capped anyway
+	const int shift = qMin(info.attempts - 1, 16);
+	const qint64 delay = qMin(__internal::maxCompletionRetryDelay, __internal::firstCompletionRetryDelay << shift);
+	info.retryTime = m_clock.elapsed() + delay;
+
+	if (!info.givenUp && (info.failures >= __internal::maxCompletionAttempts)) {
+		qDebug() << "Giving up completing news with id" << id << "in background";
+
+		// The news remains incomplete and can still be completed when visible or requested, it
+		// is only removed from the queue of other news
+		info.givenUp = true;
+		auto it = m_incompleteNewsKeys.constFind(id);
+		if (it != m_incompleteNewsKeys.constEnd()) {
+			m_incompleteNews.erase(std::make_pair(it.value(), id));
+		}
+	}
+}
+
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::retryNow(unsigned int id)
+{
+	auto it = m_retries.find(id);
+
+	if (it != m_retries.end()) {
+		it.value().retryTime = 0;
 	}
 }
 
 template <class ChannelType, class NewsCompleter>
-void AllNewsCompleter<ChannelType, NewsCompleter>::completeNextNews()
+void AllNewsCompleter<ChannelType, NewsCompleter>::fillCompletionSlots(bool startAllRequested)
 {
-	// Extracting the first value from the set
-	const int newsId = *(m_newsToComplete.begin());
-	m_newsToComplete.erase(m_newsToComplete.begin());
+	m_fillingSlots = true;
+
+	unsigned int newsId;
+	bool waitingForRetry = false;
+	if (startAllRequested) {
+		while (!m_stopping && nextNewsToComplete(true, newsId, waitingForRetry)) {
+			completeNews(newsId);
+		}
+	}
+
+	while (!m_stopping && (m_activeCompletions.size() < m_numParallelNews) && nextNewsToComplete(false, newsId, waitingForRetry)) {
+		completeNews(newsId);
+	}
 
+	m_fillingSlots = false;
+
+	// Checking if we have completed everything. If some news is waiting to be retried, we keep
+	// running, the watchdog timer will start it
+	if (m_activeCompletions.isEmpty() && (m_stopping || !waitingForRetry)) {
+		finish();
+	}
+}
+
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::finish()
+{
+	m_running = false;
+	m_stopping = false;
+	m_watchdogTimer.stop();
+
+	m_workFinishedCallback();
+}
+
+template <class ChannelType, class NewsCompleter>
+bool AllNewsCompleter<ChannelType, NewsCompleter>::nextNewsToComplete(bool onlyRequested, unsigned int& id, bool& waitingForRetry) const
+{
+	const qint64 now = m_clock.elapsed();
+	waitingForRetry = false;
+
+	// First of all news that have been explicitly requested
+	for (auto requestedId: m_priorities->requestedNews) {
+		if (canStartCompletion(requestedId, now, waitingForRetry)) {
+			id = requestedId;
+
+			return true;
+		}
+	}
+
+	if (onlyRequested) {
+		return false;
+	}
+
+	// Then visible news and news in the prefetch window, nearest to the visible range first
+	const int numNews = m_channel->numNews();
+	if ((m_priorities->firstVisibleNews >= 0) && (m_priorities->firstVisibleNews < numNews)) {
+		const int firstVisible = m_priorities->firstVisibleNews;
+		const int lastVisible = qBound(firstVisible, m_priorities->lastVisibleNews, numNews - 1);
+
+		for (int i = firstVisible; i <= lastVisible; ++i) {
+			if (canStartCompletion(m_channel->news(i).id(), now, waitingForRetry)) {
+				id = m_channel->news(i).id();
+
+				return true;
+			}
+		}
+
+		for (int d = 1; d <= m_priorities->prefetchWindow; ++d) {
+			if (((lastVisible + d) < numNews) && canStartCompletion(m_channel->news(lastVisible + d).id(), now, waitingForRetry)) {
+				id = m_channel->news(lastVisible + d).id();
+
+				return true;
+			}
+			if (((firstVisible - d) >= 0) && canStartCompletion(m_channel->news(firstVisible - d).id(), now, waitingForRetry)) {
+				id = m_channel->news(firstVisible - d).id();
+
+				return true;
+			}
+		}
+	}
+
+	// Finally, if allowed, all other news starting from the newest one
+	if (m_priorities->completeOtherNews) {
+		for (const auto& n: m_incompleteNews) {
+			if (canStartCompletion(n.second, now, waitingForRetry)) {
+				id = n.second;
+
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+template <class ChannelType, class NewsCompleter>
+bool AllNewsCompleter<ChannelType, NewsCompleter>::canStartCompletion(unsigned int id, qint64 now, bool& waitingForRetry) const
+{
+	if (!m_incompleteNewsKeys.contains(id) || m_activeCompletions.contains(id)) {
+		return false;
+	}
+
+	auto it = m_retries.constFind(id);
+	if ((it != m_retries.constEnd()) && (it.value().retryTime > now)) {
+		waitingForRetry = true;
+
+		return false;
+	}
+
+	return true;
+}
+
+template <class ChannelType, class NewsCompleter>
+void AllNewsCompleter<ChannelType, NewsCompleter>::completeNews(unsigned int newsId)
+{
 	// Creating the object that will get and parse the webpage
 	News& news = m_channel->news(m_channel->newsIndexByID(newsId));
+
+	// The news is needed again, evicted files are downloaded by the completer
+	if (news.template getData<NewsRoles::attachmentsEvicted>()) {
+		news.template setData<NewsRoles::attachmentsEvicted>(false);
+	}
+
 	auto callback = [this, newsId]() { this->parsingCompleted(newsId); };
 	NewsCompleter* newsCompleter = new NewsCompleter(m_channel, &news, callback);
 
-	// Storin the news completer to be able to delete it when done
-	m_activeNewsCompleters[newsId] = newsCompleter;
-
-	// Incrementing the number of requests
-	++m_numNewsBeingCompleted;
+	// Storing the news completer to be able to delete it when done
+	m_activeCompletions.insert(newsId, ActiveCompletion{newsCompleter, m_clock.elapsed()});
 
 	// Starting parser
 	newsCompleter->start();
@@ -28,15 +28,32 @@
 #include <QStringList>
 #include <QVariant>
 #include <QJsonObject>
+#include <QCborStreamWriter>
+#include <QCborStreamReader>
 #include <QSet>
 #include <QHash>
 #include <QDynamicPropertyChangeEvent>
 #include <QApplication>
+#include <QThreadPool>
+#include <QMutex>
+#include <atomic>
+#include <functional>
 #include <array>
 #include <memory>
+#include <type_traits>
 #include "include/news.h"
 #include "include/standardroles.h"
 #include "include/utilities.h"
+#include "include/orderstatisticlist.h"
+#include "include/newsurlkey.h"
+#include "include/newssortkey.h"
+#include "include/newsidentityindex.h"
+#include "include/slabpool.h"
+#include "include/channeljournal.h"
+#include "include/columnarsnapshot.h"
+#include "include/filegarbagecollector.h"
+#include "include/filewriter.h"
+#include "include/rolescbor.h"
 
 class RssParser;
 template <class, class>
@@ -74,17 +91,37 @@ public:
 	/**
 	 * \brief Reads the channel from a JSON object
 	 *
+	 * This reads the format used by older versions
 	 * \param obj the JSON object from which we read
 	 * \return false in case of error, true if the news was read correctly
 	 */
 	virtual bool load(const QJsonObject& obj) = 0;
 
 	/**
-	 * \brief Writes the channel as a JSON object
+	 * \brief Starts reading the channel from a binary snapshot
 	 *
-	 * \return the JSON object representing the news
+	 * See columnarsnapshot.h for a description of the format. Roles of the
+	 * channel are read before this function returns, news are decoded in
+	 * the background and added to the channel by the main thread in
+	 * batches, newest first. Data is read directly from memory (e.g. a
+	 * memory-mapped file) and must stay valid until the callback is
+	 * called. The callback is called by the main thread once all news
+	 * have been added, it is not called if the channel is destroyed first
+	 * \param data the data of the snapshot
+	 * \param size the size of data
+	 * \param callback the function called when all news have been added
+	 * \return false if the snapshot is invalid, in which case the
+	 *         callback is never called
+	 */
+	virtual bool loadSnapshot(const uchar* data, qint64 size, std::function<void()> callback) = 0;
+
+	/**
+	 * \brief Writes the channel as a binary snapshot
+	 *
+	 * See columnarsnapshot.h for a description of the format
+	 * \return the data of the snapshot
 	 */
-	virtual QJsonObject save() const = 0;
+	virtual QByteArray saveSnapshot() const = 0;
 
 	/**
 	 * \brief Returns the directory where channel data is stored
@@ -117,6 +154,16 @@ public:
 	 */
 	virtual void addStandardNews(const StandardNewsRoles& roles) = 0;
 
+	/**
+	 * \brief Adds a news moving data from the given roles
+	 *
+	 * This is the same as the other overload, but data is moved into the
+	 * news instead of being copied. Data in roles is left unspecified if
+	 * the news is added, roles must be reset before being used again
+	 * \param roles the object with roles data for the news to add
+	 */
+	virtual void addStandardNews(StandardNewsRoles&& roles) = 0;
+
 	/**
 	 * \brief Returns the number of news
 	 *
@@ -157,6 +204,15 @@ public:
 	 */
 	virtual int newsIndexByID(unsigned int id) const = 0;
 
+	/**
+	 * \brief Returns the ID of the i-th news
+	 *
+	 * See newsIndexByID() for a description of IDs
+	 * \param i the index of the news
+	 * \return the ID of the i-th news
+	 */
+	virtual unsigned int newsIDByIndex(int i) const = 0;
+
 	/**
 	 * \brief Removes all news that are older than the given date
 	 *
@@ -187,11 +243,32 @@ public:
 	/**
 	 * \brief Deletes all files attached to a news
 	 *
-	 * This also clears the list of files attached to the news.
+	 * This also clears the list of files attached to the news. Files are
+	 * removed in the background
 	 * \param i the index of the news whose files to delete
 	 */
 	virtual void deleteAllFilesForNews(int i) = 0;
 
+	/**
+	 * \brief Removes the files attached to a complete news to free space
+	 *
+	 * The news is marked as not complete and its attachmentsEvicted role
+	 * is set, so that files are downloaded again when the news is
+	 * completed. The other roles (e.g. the text) are kept. This does
+	 * nothing if the news is not complete
+	 * \param i the index of the news whose files to remove
+	 */
+	virtual void evictAttachedFiles(int i) = 0;
+
+	/**
+	 * \brief Removes the files downloaded for a news to free space
+	 *
+	 * The list of downloaded files is not changed, files are downloaded
+	 * again when requested. Files are removed in the background
+	 * \param i the index of the news whose files to remove
+	 */
+	virtual void evictDownloadedFiles(int i) = 0;
+
 	/**
 	 * \brief Returns a name for a file of the channel that is guaranteed to
 	 *        be unique
@@ -209,7 +286,8 @@ public:
 	/**
 	 * \brief Deletes all files attached to the channel
 	 *
-	 * This also clears the list of files attached to the channel
+	 * This also clears the list of files attached to the channel. Files
+	 * are removed in the background
 	 */
 	virtual void deleteAllFilesForChannel() = 0;
 
@@ -222,7 +300,9 @@ public:
 	 * \brief Deletes all files in the data directory that do not belog to
 	 *        the channel or any news
 	 *
-	 * This does not remove sub-directories of the data dir
+	 * This only takes the list of known files, the directory is swept in
+	 * the background a little at a time (see FileGarbageCollector). This
+	 * does not remove sub-directories of the data dir
 	 */
 	virtual void deleteUnknownFiles() = 0;
 
@@ -257,6 +337,28 @@ public:
 	 */
 	virtual void cleanTemporaryNewsCache() = 0;
 
+	/**
+	 * \brief Sets the journal where changes are recorded
+	 *
+	 * From now on every change to the channel or its news is appended to
+	 * the journal. Set the journal only after the channel has been
+	 * restored
+	 * \param journal the journal or nullptr to stop recording changes
+	 */
+	virtual void setJournal(ChannelJournal* journal) = 0;
+
+	/**
+	 * \brief Applies a record of the journal
+	 *
+	 * This is used by ChannelJournal::restore() to replay changes. Files
+	 * are never deleted here: files of removed news were deleted when the
+	 * record was written and leftovers are removed by deleteUnknownFiles()
+	 * \param type the type of the record
+	 * \param payload the payload of the record
+	 * \return false if the record could not be applied
+	 */
+	virtual bool applyJournalRecord(ChannelJournal::RecordType type, const QByteArray& payload) = 0;
+
 signals:
 	/**
 	 * \brief The signal emitted when a new news is about to be added
@@ -289,6 +391,24 @@ signals:
 	 */
 	void newsDeleted();
 
+	/**
+	 * \brief The signal emitted when a news is about to be moved
+	 *
+	 * This happens when the publication date or the title of a news change
+	 * and the news has to be moved to keep the list ordered. This is always
+	 * followed by the newsMoved signal
+	 * \param sourceIndex the current index of the news
+	 * \param destinationIndex the index the news will have once moved
+	 */
+	void aboutToMoveNews(int sourceIndex, int destinationIndex);
+
+	/**
+	 * \brief The signal emitted when a news has been moved
+	 *
+	 * This is always preceded by the aboutToMoveNews signal
+	 */
+	void newsMoved();
+
 	/**
 	 * \brief The signal emitted when a news has been changed
 	 *
@@ -327,9 +447,13 @@ signals:
  * createFileForChannel() are unique and their name is simply a number followed
  * by the extension (if you need to create a file in the data directory do not
  * use a simple number as the file name to avoid clashes with files created
- * here). This class has two template parameters: Roles that is the RolesList
- * with the Roles for the channel and NewsType that is the type of news stored
- * here. The requirements for these template parameters are:
+ * here). Files are removed by the FileWriter thread, after the writes already
+ * enqueued, so removing many news doesn't block the user interface and a file
+ * is never recreated by a pending write after its removal. Unknown files are
+ * swept by a FileGarbageCollector in its own thread. This class has two
+ * template parameters: Roles that is the RolesList with the Roles for the
+ * channel and NewsType that is the type of news stored here. The requirements
+ * for these template parameters are:
  *	- Role: this must contain StandardChannelRoles.
  *	- NewsType: this must contain StandardNewsRoles.
  * The channel can also return a temporary news. Temporary news are news that
@@ -382,17 +506,35 @@ public:
 	/**
 	 * \brief Reads the channel from a JSON object
 	 *
+	 * This reads the format used by older versions
 	 * \param obj the JSON object from which we read
 	 * \return false in case of error, true if the news was read correctly
 	 */
 	virtual bool load(const QJsonObject& obj) override;
 
 	/**
-	 * \brief Writes the channel as a JSON object
+	 * \brief Starts reading the channel from a binary snapshot
+	 *
+	 * News are decoded directly from the columns of the snapshot, data
+	 * does not go through QVariants and names of roles are only looked up
+	 * once per column. Rows are split in chunks decoded in parallel by the
+	 * threads of a pool, chunks are added to the list in order as soon as
+	 * they and all the previous ones are ready. Rows are in the order of
+	 * the list, so the first chunk has the most recent news
+	 * \param data the data of the snapshot
+	 * \param size the size of data
+	 * \param callback the function called when all news have been added
+	 * \return false if the snapshot is invalid, in which case the
+	 *         callback is never called
+	 */
+	virtual bool loadSnapshot(const uchar* data, qint64 size, std::function<void()> callback) override;
+
+	/**
+	 * \brief Writes the channel as a binary snapshot
 	 *
-	 * \return the JSON object representing the news
+	 * \return the data of the snapshot
 	 */
-	virtual QJsonObject save() const override;
+	virtual QByteArray saveSnapshot() const override;
 
 	/**
 	 * \brief The function called by the ChannelUpdater when it is starting
@@ -454,6 +596,15 @@ public:
 	 */
 	virtual void addStandardNews(const StandardNewsRoles& roles) override;
 
+	/**
+	 * \brief Adds a news moving data from the given roles
+	 *
+	 * This function is used by the rss parser
+	 * \param roles the object with roles data for the news to add. Data
+	 *              is moved into the news
+	 */
+	virtual void addStandardNews(StandardNewsRoles&& roles) override;
+
 	/**
 	 * \brief Adds a news
 	 *
@@ -466,15 +617,17 @@ public:
 	void addNews(const NewsRoles& roles);
 
 	/**
-	 * \brief Returns the list of news
+	 * \brief Adds a news moving data from the given roles
 	 *
-	 * News are ordered in descending order by date.
-	 * \return a const reference to the list of news
+	 * This is the same as the other overload, but data is moved into the
+	 * news instead of being copied. This is the function to use when data
+	 * for a news is prepared in an object that is then discarded or reset
+	 * (e.g. by parsers)
+	 * \param roles the object with roles data for the news to add. Data
+	 *              is moved into the news
 	 */
-	const QList<NewsType*>& newsList() const
-	{
-		return m_news;
-	}
+	template <class NewsRoles>
+	void addNews(NewsRoles&& roles, typename std::enable_if<!std::is_lvalue_reference<NewsRoles>::value>::type* = nullptr);
 
 	/**
 	 * \brief Returns the number of news
@@ -494,7 +647,7 @@ public:
 	 */
 	virtual StandardNewsRoles& standardNews(int i) override
 	{
-		return *(m_news[i]);
+		return *(m_news.at(i).news);
 	}
 
 	/**
@@ -506,7 +659,7 @@ public:
 	 */
 	virtual const StandardNewsRoles& standardNews(int i) const override
 	{
-		return *(m_news[i]);
+		return *(m_news.at(i).news);
 	}
 
 	/**
@@ -517,7 +670,7 @@ public:
 	 */
 	NewsType& news(int i)
 	{
-		return *(m_news[i]);
+		return *(m_news.at(i).news);
 	}
 
 	/**
@@ -528,7 +681,7 @@ public:
 	 */
 	const NewsType& news(int i) const
 	{
-		return *(m_news[i]);
+		return *(m_news.at(i).news);
 	}
 
 	/**
@@ -547,7 +700,20 @@ public:
 	 */
 	int newsIndexByID(unsigned int id) const override
 	{
-		return m_newsIdToIndex.value(id, -1);
+		const int node = m_newsIdToNode.value(id, -1);
+
+		return (node == -1) ? -1 : m_news.position(node);
+	}
+
+	/**
+	 * \brief Returns the ID of the i-th news
+	 *
+	 * \param i the index of the news
+	 * \return the ID of the i-th news
+	 */
+	unsigned int newsIDByIndex(int i) const override
+	{
+		return m_news.at(i).news->id();
 	}
 
 	/**
@@ -585,6 +751,23 @@ public:
 	 */
 	virtual void deleteAllFilesForNews(int i) override;
 
+	/**
+	 * \brief Removes the files attached to a complete news to free space
+	 *
+	 * The news is marked as not complete and its attachmentsEvicted role
+	 * is set. This does nothing if the news is not complete
+	 * \param i the index of the news whose files to remove
+	 */
+	virtual void evictAttachedFiles(int i) override;
+
+	/**
+	 * \brief Removes the files downloaded for a news to free space
+	 *
+	 * The list of downloaded files is not changed
+	 * \param i the index of the news whose files to remove
+	 */
+	virtual void evictDownloadedFiles(int i) override;
+
 	/**
 	 * \brief Returns a name for a file of the channel that is guaranteed to
 	 *        be unique
@@ -650,26 +833,131 @@ public:
 	 */
 	virtual void cleanTemporaryNewsCache() override;
 
+	/**
+	 * \brief Sets the journal where changes are recorded
+	 *
+	 * \param journal the journal or nullptr to stop recording changes
+	 */
+	virtual void setJournal(ChannelJournal* journal) override
+	{
+		m_journal = journal;
+	}
+
+	/**
+	 * \brief Applies a record of the journal
+	 *
+	 * \param type the type of the record
+	 * \param payload the payload of the record
+	 * \return false if the record could not be applied
+	 */
+	virtual bool applyJournalRecord(ChannelJournal::RecordType type, const QByteArray& payload) override;
+
+protected:
+	/**
+	 * \brief The function called when roles of the channel change
+	 *
+	 * This appends the changed roles to the journal
+	 * \param changedRoles the set of roles that changed
+	 */
+	void rolesChanged(const typename Roles<RolesListType>::ChangedRoles& changedRoles) override;
+
 private:
+	/**
+	 * \brief The handle owning a news
+	 */
+	using NewsHandle = typename SlabPool<NewsType>::Handle;
+
+	/**
+	 * \brief The object observing changes of a news in the list
+	 *
+	 * This forwards notifications to newsDataChanged() along with the id
+	 * of the news
+	 */
+	class NewsObserver : public NewsType::Observer
+	{
+	public:
+		/**
+		 * \brief Constructor
+		 *
+		 * \param channel the channel containing the news
+		 * \param id the id of the news
+		 */
+		NewsObserver(Channel<RolesListType, NewsType>* channel, unsigned int id)
+			: NewsType::Observer()
+			, m_channel(channel)
+			, m_id(id)
+		{
+		}
+
+		/**
+		 * \brief The function called when roles of the news change
+		 *
+		 * \param changedRoles the set of roles that changed
+		 */
+		void rolesChanged(const typename NewsType::ChangedRoles& changedRoles) override
+		{
+			m_channel->newsDataChanged(changedRoles, m_id);
+		}
+
+	private:
+		/**
+		 * \brief The channel containing the news
+		 */
+		Channel<RolesListType, NewsType>* const m_channel;
+
+		/**
+		 * \brief The id of the news
+		 */
+		const unsigned int m_id;
+	};
+
+	/**
+	 * \brief The structure with an element of the list of news
+	 */
+	struct NewsEntry {
+		/**
+		 * \brief The news
+		 */
+		NewsType* news = nullptr;
+
+		/**
+		 * \brief The object observing changes of the news
+		 */
+		NewsObserver* observer = nullptr;
+	};
+
 	/**
 	 * \brief The function called when a news changes
 	 *
-	 * This emits the newsUpdated() signal
-	 * \param roleIndex the index of the role of the news that has changed
-	 * \param id the id of the news whose role has changed
+	 * This emits the newsUpdated() signal once with all the roles that
+	 * changed. If the publication date or the title change, the news is
+	 * moved to its new position (emitting the aboutToMoveNews() and
+	 * newsMoved() signals) or removed if it is now a duplicate of another
+	 * news
+	 * \param changedRoles the set of roles of the news that changed
+	 * \param id the id of the news whose roles have changed
 	 */
-	void newsDataChanged(int roleIndex, unsigned int id);
+	void newsDataChanged(const typename NewsType::ChangedRoles& changedRoles, unsigned int id);
+
+	/**
+	 * \brief Destroys a news that has been taken out of the list
+	 *
+	 * This destroys both the news and its observer
+	 * \param entry the entry with the news to destroy
+	 */
+	void destroyNews(const NewsEntry& entry);
 
 	/**
 	 * \brief Creates a news
 	 *
-	 * The news is returned in an unique_ptr. This function assigns an
-	 * unique ID to the news. The news is not inserted in the list, its ID
-	 * is not insered in the m_newsIdToIndex map and its URL is not inserted
-	 * in the m_newsURLToId map
+	 * The news is allocated from the pool and returned in a handle owning
+	 * it. This function assigns a unique ID to the news. The news is not
+	 * inserted in the list, its ID is not inserted in the m_newsIdToNode
+	 * map and its URL is not inserted in the m_newsUrlIndex and
+	 * m_newsIdentityIndex indexes
 	 * \return a new news
 	 */
-	std::unique_ptr<NewsType> createNews();
+	NewsHandle createNews();
 
 	/**
 	 * \brief Inserts the news in the list
@@ -677,7 +965,136 @@ private:
 	 * This also fills the map with the ID and index of the news
 	 * \param news the news to add. The pointer is
 	 */
-	void insertNews(std::unique_ptr<NewsType>&& news);
+	void insertNews(NewsHandle&& news);
+
+	/**
+	 * \brief Removes news in a range of indexes
+	 *
+	 * This emits the aboutToDeleteNews() and newsDeleted() signals. Changes
+	 * made while removing news are not journaled, the caller must journal
+	 * the removal
+	 * \param first the index of the first news to remove
+	 * \param last the index of the last news to remove
+	 * \param deleteFiles if true files attached to news are deleted
+	 */
+	void removeNews(int first, int last, bool deleteFiles);
+
+	/**
+	 * \brief Removes all news older than the given date
+	 *
+	 * \param dateKey the date part of the key of news (see
+	 *                NewsSortKey::dateKey())
+	 * \param deleteFiles if true files attached to news are deleted
+	 * \return true if some news has been removed
+	 */
+	bool removeNewsBefore(qint64 dateKey, bool deleteFiles);
+
+	/**
+	 * \brief Returns the index of the news with the given key
+	 *
+	 * \param key the key of the news to find
+	 * \return the index of the news or -1 if no news has the given key
+	 */
+	int newsIndexByKey(const NewsSortKey& key) const;
+
+	/**
+	 * \brief Returns true if changes must be appended to the journal
+	 *
+	 * \return true if changes must be appended to the journal
+	 */
+	bool journaling() const
+	{
+		return (m_journal != nullptr) && !m_journalSuspended;
+	}
+
+	/**
+	 * \brief Appends to the journal a record with the changed roles of the
+	 *        channel
+	 *
+	 * \param changedRoles the set of roles to write, possibly empty
+	 */
+	void journalChannelUpdate(const typename Roles<RolesListType>::ChangedRoles& changedRoles);
+
+	/**
+	 * \brief The state of the loading of a snapshot
+	 *
+	 * This is shared by the main thread and the threads decoding news
+	 */
+	struct SnapshotLoad {
+		/**
+		 * \brief The channel being loaded
+		 *
+		 * This must only be used by the main thread and only if the
+		 * loading has not been cancelled
+		 */
+		Channel* channel;
+
+		/**
+		 * \brief The table with news
+		 */
+		ColumnarSnapshotReader::Table newsTable;
+
+		/**
+		 * \brief The column of each role of news in newsTable
+		 */
+		QVector<int> newsColumns;
+
+		/**
+		 * \brief Set to true when the channel is destroyed
+		 *
+		 * Chunks not yet decoded are skipped
+		 */
+		std::atomic<bool> cancelled;
+
+		/**
+		 * \brief The mutex protecting chunks and chunkReady
+		 */
+		QMutex mutex;
+
+		/**
+		 * \brief The news of each chunk, once decoded
+		 *
+		 * News are only used as containers for the data, their id is
+		 * not meaningful
+		 */
+		std::vector<std::vector<NewsType>> chunks;
+
+		/**
+		 * \brief Whether each chunk has been decoded
+		 */
+		std::vector<bool> chunkReady;
+
+		/**
+		 * \brief The index of the next chunk to add to the list
+		 *
+		 * This is only used by the main thread
+		 */
+		int nextChunk;
+
+		/**
+		 * \brief The function to call when all news have been added
+		 */
+		std::function<void()> callback;
+	};
+
+	/**
+	 * \brief Decodes a chunk of the snapshot
+	 *
+	 * This is called by the threads of m_loadingPool. When done, the
+	 * main thread is asked to add decoded chunks to the list
+	 * \param load the state of the loading
+	 * \param chunk the index of the chunk to decode
+	 */
+	static void decodeSnapshotChunk(const std::shared_ptr<SnapshotLoad>& load, int chunk);
+
+	/**
+	 * \brief Adds to the list the chunks of the snapshot decoded so far
+	 *
+	 * Chunks are added in order, stopping at the first one not yet
+	 * decoded. When all chunks have been added the callback of the
+	 * loading is called
+	 */
+	void addSnapshotChunks();
 
 	/**
 	 * \brief The absolute path to the directory with data for the channel
@@ -705,21 +1122,51 @@ private:
 	 */
 	int m_fileCreationIndex;
 
+	/**
+	 * \brief The pool from which news are allocated
+	 *
+	 * This must be declared before any member holding news
+	 */
+	SlabPool<NewsType> m_newsPool;
+
+	/**
+	 * \brief The pool from which observers of news are allocated
+	 *
+	 * There is one observer for each news in the list. This must be
+	 * declared before any member holding news
+	 */
+	SlabPool<NewsObserver> m_newsObserversPool;
+
 	/**
 	 * \brief The list of news
+	 *
+	 * Access by position, insertion and removal are O(log n). The key of
+	 * each element is a copy of the sort key cached in the news, kept in
+	 * the packed array of keys of the list, so that binary searches never
+	 * dereference news. It is updated when the news is moved. News are owned
+	 * by m_newsPool, pointers here are given back to a handle when news are
+	 * removed
 	 */
-#warning QUI USARE LISTA DI unique_ptr A NEWS
-	QList<NewsType*> m_news;
+	OrderStatisticList<NewsSortKey, NewsEntry> m_news;
 
 	/**
-	 * \brief The map from news ids to news index in the m_news list
+	 * \brief The map from news ids to the node of the news in the m_news
+	 *        list
+	 *
+	 * Nodes don't change when other news are added or removed, the index
+	 * of a news is computed from its node in O(log n)
 	 */
-	QHash<unsigned int, int> m_newsIdToIndex;
+	QHash<unsigned int, int> m_newsIdToNode;
 
 	/**
-	 * \brief The map from the url of a news to its id
+	 * \brief The bidirectional index between the url of a news and its id
 	 */
-	QHash<QUrl, unsigned int> m_newsURLToId;
+	NewsUrlIndex m_newsUrlIndex;
+
+	/**
+	 * \brief The index used to find out if a news is already known
+	 */
+	NewsIdentityIndex m_newsIdentityIndex;
 
 	/**
 	 * \brief The current maximum ID of news
@@ -733,6 +1180,21 @@ private:
 	 */
 	bool m_ignoreNewsCallback;
 
+	/**
+	 * \brief The journal where changes are appended
+	 *
+	 * This is nullptr if changes are not recorded (e.g. while restoring the
+	 * channel)
+	 */
+	ChannelJournal* m_journal;
+
+	/**
+	 * \brief If true changes are not appended to the journal
+	 *
+	 * This is set while news are being removed
+	 */
+	bool m_journalSuspended;
+
 	/**
 	 * \brief A structure with a news and its accessor
 	 *
@@ -757,6 +1219,23 @@ private:
 	 * News more recently requested are at the beginning of the list
 	 */
 	QList<NewsAndAccessor> m_temporaryNews;
+
+	/**
+	 * \brief The state of the loading of a snapshot
+	 *
+	 * This is nullptr when no snapshot is being loaded
+	 */
+	std::shared_ptr<SnapshotLoad> m_snapshotLoad;
+
+	/**
+	 * \brief The threads decoding news of snapshots
+	 */
+	QThreadPool m_loadingPool;
+
+	/**
+	 * \brief The object removing unknown files in the background
+	 */
+	FileGarbageCollector m_fileCollector;
 };
 
 // Implementation of template functions of Channel
@@ -771,6 +1250,16 @@ private:
 #include "include/allnewscompleter.h"
 #include "include/rolesqmlaccessor.h"
 
+namespace __internal {
+	/**
+	 * \brief The number of news in each chunk of a snapshot decoded by a
+	 *        thread
+	 *
+	 * The first chunk is enough to fill the first screen
+	 */
+	const int snapshotChunkSize = 64;
+}
+
 template <class RolesListType, class NewsType>
 Channel<RolesListType, NewsType>::Channel(QUrl url, QString dataDir, int temporaryNewsCacheSize, QObject* parent)
 	: AbstractChannel(parent)
@@ -778,12 +1267,20 @@ Channel<RolesListType, NewsType>::Channel(QUrl url, QString dataDir, int tempora
 	, m_dataDir(dataDir)
 	, m_temporaryNewsCacheSize(temporaryNewsCacheSize)
 	, m_fileCreationIndex(0)
+	, m_newsPool()
+	, m_newsObserversPool()
 	, m_news()
-	, m_newsIdToIndex()
-	, m_newsURLToId()
+	, m_newsIdToNode()
+	, m_newsUrlIndex()
+	, m_newsIdentityIndex()
 	, m_maxNewsID(0)
 	, m_ignoreNewsCallback(false)
+	, m_journal(nullptr)
+	, m_journalSuspended(false)
 	, m_temporaryNews()
+	, m_snapshotLoad()
+	, m_loadingPool()
+	, m_fileCollector()
 {
 	// Setting the URL role
 	this->template setData<ChannelRoles::siteUrl>(url);
@@ -802,9 +1299,19 @@ Channel<RolesListType, NewsType>::Channel(QUrl url, QString dataDir, int tempora
 template <class RolesListType, class NewsType>
 Channel<RolesListType, NewsType>::~Channel()
 {
+	// Stopping the loading of the snapshot, if running. Chunks not yet added are discarded
+	if (m_snapshotLoad) {
+		m_snapshotLoad->cancelled = true;
+	}
+	m_loadingPool.waitForDone();
+
+	// Stopping the sweep of unknown files, an unfinished sweep is abandoned
+	m_fileCollector.stop();
+	m_fileCollector.wait();
+
 	// Deleting all news
-	for (auto n: m_news) {
-		delete n;
+	for (const auto& e: m_news) {
+		destroyNews(e);
 	}
 
 	// Deleting all temporary news
@@ -829,7 +1336,7 @@ bool Channel<RolesListType, NewsType>::load(const QJsonObject& obj)
 			continue;
 		}
 
-		const int r = this->getRoleIndexFromName(it.key().toLatin1());
+		const int r = this->getRoleIndexFromName(it.key());
 
 		if (r == -1) {
 			return false;
@@ -851,9 +1358,9 @@ bool Channel<RolesListType, NewsType>::load(const QJsonObject& obj)
 			return false;
 		}
 
-		// Creating a news. We use a unique_ptr so that if we have to exit because
+		// Creating a news. We use a handle so that if we have to exit because
 		// of problems loading the news, memory is automatically released
-		std::unique_ptr<NewsType> n = createNews();
+		NewsHandle n = createNews();
 		if (!n->load((*it).toObject())) {
 			return false;
 		}
@@ -866,36 +1373,100 @@ bool Channel<RolesListType, NewsType>::load(const QJsonObject& obj)
 }
 
 template <class RolesListType, class NewsType>
-QJsonObject Channel<RolesListType, NewsType>::save() const
+bool Channel<RolesListType, NewsType>::loadSnapshot(const uchar* data, qint64 size, std::function<void()> callback)
 {
-	// Building a QVariantMap from the values we have
-	QVariantMap map;
+	ColumnarSnapshotReader reader(data, size);
+	ColumnarSnapshotReader::Table channelTable;
+	auto load = std::make_shared<SnapshotLoad>();
+	if (m_snapshotLoad || !reader.isValid() || !reader.readTable(channelTable) || !reader.readTable(load->newsTable) || (channelTable.numRows() != 1)) {
+		return false;
+	}
+
+	// Reading the roles of the channel. Columns are matched to roles by name once, columns of
+	// roles that don't exist anymore are ignored. Observers are notified once, at the end
+	const QVector<int> channelColumns = channelTable.columnsForRoles<Roles<RolesListType>>();
+	RolesChangeNotifier* const notifier = this;
+	this->beginUpdate();
+	this->visitRoles([&channelTable, &channelColumns, notifier](int index, const char*, auto& value) {
+		const int c = channelColumns[index];
+
+		if ((c != -1) && channelTable.read(c, 0, value)) {
+			notifier->roleChanged(index);
+		}
+	});
+	this->commit();
+
+	// The file creation index is in a column of its own
+	const int fileCreationIndexColumn = channelTable.columnIndex("fileCreationIndex");
+	if (fileCreationIndexColumn != -1) {
+		channelTable.read(fileCreationIndexColumn, 0, m_fileCreationIndex);
+	}
 
-	for (int i = 0; i < Roles<RolesListType>::numRoles(); ++i) {
-		map[this->getRoleNameFromIndex(i)] = this->getVariantData(i);
+	// Now starting to decode news, one per row, in chunks. Chunks are queued in order, so the
+	// most recent news are decoded first
+	const int numChunks = (load->newsTable.numRows() + __internal::snapshotChunkSize - 1) / __internal::snapshotChunkSize;
+	load->channel = this;
+	load->newsColumns = load->newsTable.columnsForRoles<NewsType>();
+	load->cancelled = false;
+	load->chunks.resize(numChunks);
+	load->chunkReady.resize(numChunks, false);
+	load->nextChunk = 0;
+	load->callback = std::move(callback);
+	m_snapshotLoad = load;
+
+	for (int c = 0; c < numChunks; ++c) {
+		m_loadingPool.start(new CommandRunnable([load, c]() { decodeSnapshotChunk(load, c); }));
 	}
 
-	// Adding to the map the file creation index
-	map["fileCreationIndex"] = m_fileCreationIndex;
+	// With no news the loading is completed right away, but the callback is always called later
+	if (numChunks == 0) {
+		QCoreApplication::postEvent(&(CommandEventReceiver::instance()), new CommandEvent([load]() {
+			if (!load->cancelled) {
+				load->channel->addSnapshotChunks();
+			}
+		}));
+	}
 
-	// Creating the JSON object
-	QJsonObject obj = QJsonObject::fromVariantMap(map);
+	return true;
+}
 
-	// Now adding all news
-	QJsonArray news;
-	for (auto it = m_news.constBegin(); it != m_news.constEnd(); ++it) {
-		news.append((*it)->save());
+template <class RolesListType, class NewsType>
+QByteArray Channel<RolesListType, NewsType>::saveSnapshot() const
+{
+	ColumnarSnapshotWriter writer;
+
+	// The table of the channel has a single row. The file creation index is appended as an
+	// additional column
+	writer.beginTable(1);
+	this->visitRoles([&writer](int index, const char* name, const auto& value) {
+		writer.append(index, name, value);
+	});
+	writer.append(Roles<RolesListType>::numRoles(), "fileCreationIndex", m_fileCreationIndex);
+	writer.endTable();
+
+	// The table of news, with one row per news
+	writer.beginTable(m_news.size());
+	for (const auto& e: m_news) {
+		e.news->visitRoles([&writer](int index, const char* name, const auto& value) {
+			writer.append(index, name, value);
+		});
 	}
-	obj.insert("news", news);
+	writer.endTable();
 
-	return obj;
+	return writer.data();
 }
 
 template <class RolesListType, class NewsType>
 void Channel<RolesListType, NewsType>::addStandardNews(const StandardNewsRoles& roles)
 {
+	// If the news is already known there is nothing to do. This is checked here so that
+	// duplicates don't even cause the creation of a news
+	if (m_newsIdentityIndex.contains(roles)) {
+		return;
+	}
+
 	// Creating a news
-	std::unique_ptr<NewsType> n = createNews();
+	NewsHandle n = createNews();
 
 	// Copying data
 	(static_cast<StandardNewsRoles&>(*n)).copyDataFromOtherRolesList(roles);
@@ -908,8 +1479,13 @@ template <class RolesListType, class NewsType>
 template <class NewsRoles>
 void Channel<RolesListType, NewsType>::addNews(const NewsRoles& roles)
 {
+	// If the news is already known there is nothing to do
+	if (m_newsIdentityIndex.contains(roles)) {
+		return;
+	}
+
 	// Creating a news
-	std::unique_ptr<NewsType> n = createNews();
+	NewsHandle n = createNews();
 
 	// Copying data
 	n->copyDataFromOtherRolesList(roles);
@@ -919,48 +1495,54 @@ void Channel<RolesListType, NewsType>::addNews(const NewsRoles& roles)
 }
 
 template <class RolesListType, class NewsType>
-void Channel<RolesListType, NewsType>::deleteNews(const QDateTime& date)
+void Channel<RolesListType, NewsType>::addStandardNews(StandardNewsRoles&& roles)
 {
-	if (m_news.isEmpty()) {
+	// If the news is already known there is nothing to do. Data is not moved in this case
+	if (m_newsIdentityIndex.contains(roles)) {
 		return;
 	}
 
-	// News are ordered by descending date, we can use a binary search to find the first news
-	// before date
-	int startIndex;
-	if (m_news.first()->template getData<NewsRoles::pubDate>() <= date) {
-		startIndex = 0;
-	} else if (m_news.last()->template getData<NewsRoles::pubDate>() > date) {
+	// Creating a news
+	NewsHandle n = createNews();
+
+	// Moving data
+	(static_cast<StandardNewsRoles&>(*n)).moveDataFromOtherRolesList(std::move(roles));
+
+	// Inserting the news
+	insertNews(std::move(n));
+}
+
+template <class RolesListType, class NewsType>
+template <class NewsRoles>
+void Channel<RolesListType, NewsType>::addNews(NewsRoles&& roles, typename std::enable_if<!std::is_lvalue_reference<NewsRoles>::value>::type*)
+{
+	// If the news is already known there is nothing to do. Data is not moved in this case
+	if (m_newsIdentityIndex.contains(roles)) {
 		return;
-	} else {
-		int minIndex = 0;
-		int maxIndex = m_news.size() - 1;
-		while ((maxIndex - minIndex) > 1) {
-			const int index = (minIndex + maxIndex) / 2;
-
-			if (m_news[index]->template getData<NewsRoles::pubDate>() > date) {
-				minIndex = index;
-			} else {
-				maxIndex = index;
-			}
-		}
-		startIndex = maxIndex;
 	}
 
-	// Deleting
-	emit aboutToDeleteNews(startIndex, m_news.size() - 1);
-	while (m_news.size() > startIndex) {
-		// Removing all files for the news
-		deleteAllFilesForNews(m_news.size() - 1);
+	// Creating a news
+	NewsHandle n = createNews();
 
-		// Removing the ID and URL from maps
-		m_newsIdToIndex.remove(m_news.last()->id());
-		m_newsURLToId.remove(m_news.last()->template getData<NewsRoles::link>());
+	// Moving data
+	n->moveDataFromOtherRolesList(std::move(roles));
 
-		// Removing the news
-		delete m_news.takeLast();
+	// Inserting the news
+	insertNews(std::move(n));
+}
+
+template <class RolesListType, class NewsType>
+void Channel<RolesListType, NewsType>::deleteNews(const QDateTime& date)
+{
+	const qint64 dateKey = NewsSortKey::dateKey(date);
+
+	if (removeNewsBefore(dateKey, true) && journaling()) {
+		QByteArray payload;
+		QCborStreamWriter writer(&payload);
+		writer.append(dateKey);
+
+		m_journal->append(ChannelJournal::RecordType::NewsRemovedBefore, payload);
 	}
-	emit newsDeleted();
 }
 
 template <class RolesListType, class NewsType>
@@ -974,18 +1556,26 @@ void Channel<RolesListType, NewsType>::clearAllNews()
 	// Removing all news
 	emit aboutToDeleteNews(0, m_news.size() - 1);
 
-	// First removing all files for all news
+	// First removing all files for all news. Changes made here are not journaled, the list is
+	// cleared anyway
+	m_journalSuspended = true;
 	for (int i = 0; i < m_news.size(); ++i) {
 		deleteAllFilesForNews(i);
 	}
+	m_journalSuspended = false;
 
 	// Now deleting all news and clearing the list
-	for (auto n: m_news) {
-		delete n;
+	for (const auto& e: m_news) {
+		destroyNews(e);
 	}
 	m_news.clear();
-	m_newsIdToIndex.clear();
-	m_newsURLToId.clear();
+	m_newsIdToNode.clear();
+	m_newsUrlIndex.clear();
+	m_newsIdentityIndex.clear();
+
+	if (journaling()) {
+		m_journal->append(ChannelJournal::RecordType::NewsCleared, QByteArray());
+	}
 
 	emit newsDeleted();
 }
@@ -999,10 +1589,12 @@ QString Channel<RolesListType, NewsType>::createFileForNews(int i, QString ext)
 	// Incrementing the index
 	++m_fileCreationIndex;
 
+	journalChannelUpdate(typename Roles<RolesListType>::ChangedRoles());
+
 	// Adding the file to the files for the news
-	auto attachedFiles = m_news[i]->template getData<NewsRoles::attachedFiles>();
+	auto attachedFiles = m_news.at(i).news->template getData<NewsRoles::attachedFiles>();
 	attachedFiles.append(filename);
-	m_news[i]->template setData<NewsRoles::attachedFiles>(attachedFiles);
+	m_news.at(i).news->template setData<NewsRoles::attachedFiles>(attachedFiles);
 
 	return filename;
 }
@@ -1010,16 +1602,34 @@ QString Channel<RolesListType, NewsType>::createFileForNews(int i, QString ext)
 template <class RolesListType, class NewsType>
 void Channel<RolesListType, NewsType>::deleteAllFilesForNews(int i)
 {
-	const auto& filesToDelete = m_news[i]->template getData<NewsRoles::attachedFiles>();
+	FW::instance().removeFiles(m_news.at(i).news->template getData<NewsRoles::attachedFiles>());
 
-	for (auto& f: filesToDelete) {
-		if (!QFile::remove(f)) {
-			qDebug() << "In deleteAllFilesForNews(): cannot remove file" << f;
-		}
+	// Resetting the list of files attached to the news
+	m_news.at(i).news->template setData<NewsRoles::attachedFiles>(QStringList());
+}
+
+template <class RolesListType, class NewsType>
+void Channel<RolesListType, NewsType>::evictAttachedFiles(int i)
+{
+	NewsType* const news = m_news.at(i).news;
+
+	// Files of incomplete news could be being written by a news completer
+	if (!news->template getData<NewsRoles::complete>()) {
+		return;
 	}
 
-	// Resetting the list of files attached to the news
-	m_news[i]->template setData<NewsRoles::attachedFiles>(QStringList());
+	// Changing all roles at once, observers see a single change
+	news->beginUpdate();
+	deleteAllFilesForNews(i);
+	news->template setData<NewsRoles::complete>(false);
+	news->template setData<NewsRoles::attachmentsEvicted>(true);
+	news->commit();
+}
+
+template <class RolesListType, class NewsType>
+void Channel<RolesListType, NewsType>::evictDownloadedFiles(int i)
+{
+	FW::instance().removeFiles(m_news.at(i).news->template getData<NewsRoles::downloadedFiles>());
 }
 
 template <class RolesListType, class NewsType>
@@ -1042,13 +1652,7 @@ QString Channel<RolesListType, NewsType>::createFileForChannel(QString ext)
 template <class RolesListType, class NewsType>
 void Channel<RolesListType, NewsType>::deleteAllFilesForChannel()
 {
-	const QStringList& filesToDelete = this->template getData<ChannelRoles::attachedFiles>();
-
-	for (auto& f: filesToDelete) {
-		if (!QFile::remove(f)) {
-			qDebug() << "In deleteAllFilesForChannel(): cannot remove file" << f;
-		}
-	}
+	FW::instance().removeFiles(this->template getData<ChannelRoles::attachedFiles>());
 
 	// Resetting the list of files attached to the channel
 	this->template setData<ChannelRoles::attachedFiles>(QStringList());
@@ -1073,8 +1677,8 @@ void Channel<RolesListType, NewsType>::deleteUnknownFiles()
 	QSet<QString> filesToKeep;
 
 	// Adding files for all news
-	for (const auto n: m_news) {
-		const QStringList& l = n->template getData<NewsRoles::attachedFiles>();
+	for (const auto& e: m_news) {
+		const QStringList& l = e.news->template getData<NewsRoles::attachedFiles>();
 
 		for (const auto& f: l) {
 			filesToKeep.insert(f);
@@ -1088,29 +1692,19 @@ void Channel<RolesListType, NewsType>::deleteUnknownFiles()
 		filesToKeep.insert(f);
 	}
 
-	// Now listing all files in the directory. We do not take directories into account
-	QDir dataDir = QDir(m_dataDir);
-	const QStringList fileInDir = dataDir.entryList(QDir::Files | QDir::Hidden);
-
-	// Finally removing all files that are not in the set of files to keep
-	for (auto f: fileInDir) {
-		if (!filesToKeep.contains(m_dataDir + "/" + f)) {
-			qDebug() << "Deleting unknown file" << f;
-			dataDir.remove(f);
-		}
-	}
+	// The directory is listed and unknown files are removed in the background. Files created
+	// from now on are not in the set, the current file creation index tells which ones they are
+	m_fileCollector.sweep(m_dataDir, std::move(filesToKeep), m_fileCreationIndex);
 }
 
 template <class RolesListType, class NewsType>
 unsigned int Channel<RolesListType, NewsType>::newsIDForURL(QUrl newsUrl)
 {
-	auto it = m_newsURLToId.find(newsUrl);
-	if (it == m_newsURLToId.end()) {
-		// An invalid ID (the +1 is just to be sure...)
-		return m_maxNewsID + 1;
-	} else {
-		return it.value();
-	}
+	// An invalid ID if the url is not found (the +1 is just to be sure...)
+	unsigned int id = m_maxNewsID + 1;
+	m_newsUrlIndex.id(newsUrl, id);
+
+	return id;
 }
 
 template <class RolesListType, class NewsType>
@@ -1118,15 +1712,16 @@ AbstractRolesQMLAccessor* Channel<RolesListType, NewsType>::getTemporaryNewsFrom
 {
 	// A check just for debug
 #ifndef QT_NO_DEBUG
-	if (m_newsURLToId.contains(newsUrl)) {
+	if (m_newsUrlIndex.contains(newsUrl)) {
 		qDebug() << "Requested a temporay news with the same url of a news in the list. Url:" << newsUrl;
 	}
 #endif
 
 	// The cache should be rather small, we do not use any map-like structure to look for the
 	// news in the cache
+	const NewsUrlKey newsUrlKey(newsUrl);
 	int newsIndex = 0;
-	for (; (newsIndex < m_temporaryNews.size()) && (m_temporaryNews[newsIndex].news->template getData<NewsRoles::link>() != newsUrl); ++newsIndex);
+	for (; (newsIndex < m_temporaryNews.size()) && (NewsUrlKey(m_temporaryNews[newsIndex].news->template getData<NewsRoles::link>()) != newsUrlKey); ++newsIndex);
 
 	if (newsIndex < m_temporaryNews.size()) {
 		// Moving the news on top of the list
@@ -1155,14 +1750,14 @@ void Channel<RolesListType, NewsType>::cleanTemporaryNewsCache()
 }
 
 template <class RolesListType, class NewsType>
-void Channel<RolesListType, NewsType>::newsDataChanged(int roleIndex, unsigned int id)
+void Channel<RolesListType, NewsType>::newsDataChanged(const typename NewsType::ChangedRoles& changedRoles, unsigned int id)
 {
 	if (m_ignoreNewsCallback) {
 		return;
 	}
 
 	// Getting the index of the news
-	const int index = m_newsIdToIndex.value(id, -1);
+	const int index = newsIndexByID(id);
 
 	if (Q_UNLIKELY(index == -1)) {
 		// This should never happend, but just in case...
@@ -1171,127 +1766,413 @@ void Channel<RolesListType, NewsType>::newsDataChanged(int roleIndex, unsigned i
 		return;
 	}
 
-	// If publication date or the title changes, we have to remove the news from the
-	// list and add it again, because its position could have changed. If the link
-	// changed, we have to update the m_newsURLToId map
-	if ((m_news[index]->template getIndex<NewsRoles::pubDate>() == roleIndex) ||
-	    (m_news[index]->template getIndex<NewsRoles::title>() == roleIndex)){
-		// Removing the news from the list. We also need to emit signals to tell the model
-		// what is happening
-		emit aboutToDeleteNews(index, index);
+	// The key of the news before the change, used to identify the news in the journal
+	const NewsSortKey oldKey = m_news.keyAt(index);
 
-		std::unique_ptr<NewsType> n(m_news[index]);
-		m_news.removeAt(index);
+	// The list of roles that changed, sent with the newsUpdated signal
+	QVector<int> roles;
+	for (int i = 0; i < NewsType::numRoles(); ++i) {
+		if (changedRoles.test(i)) {
+			roles.append(i);
+		}
+	}
 
-		emit newsDeleted();
+	// If publication date or the title changes, the position of the news could have changed.
+	// Instead of removing and adding it again we move it, so that the model can keep the row
+	// (and the objects QML has for it) alive. If the link changed, we have to update the
+	// m_newsUrlIndex index. The identity of the news could depend on all these roles and on the
+	// guid and permalink, updating the m_newsIdentityIndex index too
+	const NewsType& changedNews = *(m_news.at(index).news);
+	const bool positionChanged = changedRoles.test(changedNews.template getIndex<NewsRoles::pubDate>()) ||
+	                             changedRoles.test(changedNews.template getIndex<NewsRoles::title>());
+	const bool linkChanged = changedRoles.test(changedNews.template getIndex<NewsRoles::link>());
+	const bool identityChanged = positionChanged || linkChanged ||
+	                             changedRoles.test(changedNews.template getIndex<NewsRoles::permalink>()) ||
+	                             changedRoles.test(changedNews.template getIndex<NewsRoles::guid>());
+
+	// Removes the news because it is now a duplicate of another one. We are called by the news,
+	// but our observer is the last one to be notified, so it is safe to destroy it
+	const auto removeDuplicate = [this, &oldKey, index]() {
+		if (journaling()) {
+			QByteArray payload;
+			QCborStreamWriter writer(&payload);
+			ChannelJournal::writeKey(writer, oldKey);
+
+			m_journal->append(ChannelJournal::RecordType::NewsRemoved, payload);
+		}
 
-		// Adding the news again in its correct position
-		insertNews(std::move(n));
-	} else {
-		// Checking if we have to update the m_newsURLToId map
-		if (m_news[index]->template getIndex<NewsRoles::link>() == roleIndex) {
-			// We have to cycle the map...
-			auto it = m_newsURLToId.begin();
-			for (; (it != m_newsURLToId.end()) && (it.value() != id); ++it);
-
-			// If we could not find the news in the map, there was an error
-			if (Q_UNLIKELY(it == m_newsURLToId.end())) {
-#warning QUI FALLIRE (qFatal) APPENA È STATO SCRITTO ANCHE IL CODICE PER SCARICARE NEWS NON NELLA LISTA DA RSS
-				qDebug() << "The news with id" << id << "could not be found when updating the m_newsURLToId map";
+		removeNews(index, index, true);
+	};
+
+	// If the news now has the identity of another news it is a duplicate. The other news keeps
+	// its identities
+	if (identityChanged && m_newsIdentityIndex.conflicts(id, changedNews)) {
+		removeDuplicate();
+
+		return;
+	}
+
+	if (identityChanged) {
+		m_newsIdentityIndex.insert(id, changedNews);
+	}
+	if (linkChanged) {
+		m_newsUrlIndex.insert(id, changedNews.template getData<NewsRoles::link>());
+	}
+
+	// Appending the change to the journal, unless the news turns out to be a duplicate
+	const auto journalUpdate = [this, &oldKey, &changedNews, &changedRoles]() {
+		if (journaling()) {
+			QByteArray payload;
+			QCborStreamWriter writer(&payload);
+			writer.startArray(2);
+			ChannelJournal::writeKey(writer, oldKey);
+			RolesCbor::write(writer, changedNews, changedRoles);
+			writer.endArray();
+
+			m_journal->append(ChannelJournal::RecordType::NewsUpdated, payload);
+		}
+	};
+
+	if (positionChanged) {
+		// Taking the news out of the list silently to find where it should be. It is put back
+		// before emitting any signal, so that receivers always see a consistent list. The sort
+		// key of the news has already been refreshed when its roles changed
+		NewsEntry entry = m_news.takeAt(index);
+		const NewsSortKey key = entry.news->sortKey();
+		const int destIndex = m_news.countWhile([&key](const NewsSortKey& k) { return k > key; });
+		const bool duplicate = (destIndex < m_news.size()) && (key == m_news.keyAt(destIndex));
+		m_newsIdToNode[id] = m_news.insert(index, key, entry);
+
+		if (duplicate) {
+			// The news now has the same key as another one
+			removeDuplicate();
+		} else {
+			journalUpdate();
+
+			if (destIndex != index) {
+				emit aboutToMoveNews(index, destIndex);
+
+				m_news.takeAt(index);
+				m_newsIdToNode[id] = m_news.insert(destIndex, key, entry);
+
+				emit newsMoved();
 			}
 
-			m_newsURLToId.erase(it);
-			m_newsURLToId[m_news[index]->template getData<NewsRoles::link>()] = id;
+			emit newsUpdated(destIndex, roles);
 		}
+	} else {
+		journalUpdate();
 
-		// Emitting signal
-		emit newsUpdated(index, QVector<int>() << roleIndex);
+		emit newsUpdated(index, roles);
 	}
 }
 
 template <class RolesListType, class NewsType>
-std::unique_ptr<NewsType> Channel<RolesListType, NewsType>::createNews()
+void Channel<RolesListType, NewsType>::destroyNews(const NewsEntry& entry)
+{
+	// The handles returned by adopt() are destroyed immediately. The observer is destroyed first
+	entry.news->removeObserver(entry.observer);
+	m_newsObserversPool.adopt(entry.observer);
+	m_newsPool.adopt(entry.news);
+}
+
+template <class RolesListType, class NewsType>
+typename Channel<RolesListType, NewsType>::NewsHandle Channel<RolesListType, NewsType>::createNews()
 {
 	// The id of the new news
 	const int newsId = m_maxNewsID++;
 
-	// Creating the new news. We don't set the callback because which callback to set and
-	// when depends on where the news is put
-	return std::make_unique<NewsType>(newsId);
+	// Creating the new news. We don't add the observer because whether to observe the news
+	// depends on where the news is put
+	return m_newsPool.create(newsId);
 }
 
 template <class RolesListType, class NewsType>
-void Channel<RolesListType, NewsType>::insertNews(std::unique_ptr<NewsType>&& news)
+void Channel<RolesListType, NewsType>::insertNews(NewsHandle&& news)
 {
-	// The index where we will add the news
-	int destIndex = 0;
-
-	// We have to add the news while keeping the list ordered in descending order
-	if ((m_news.isEmpty()) || (*news > *(m_news.first()))) {
-		destIndex = 0;
-	} else if (*news < *(m_news.last())) {
-		destIndex = m_news.size();
-	} else if ((*news == *(m_news.first())) || (*news == *(m_news.last()))) {
-		// The news is already there, not adding it
+	// If we already have a news with the same identity (guid, permalink, link or date and title),
+	// this is a duplicate
+	if (m_newsIdentityIndex.contains(*news)) {
 		return;
-	} else {
-		// News are ordered by date, so we can use a binary search to find the inserition point
-		int minIndex = 0;
-		int maxIndex = m_news.size() - 1;
-		while ((maxIndex - minIndex) > 1) {
-			const int index = (minIndex + maxIndex) / 2;
-
-			// If we found another news equal to the one to insert, we do nothing
-			if (*news == *(m_news[index])) {
-				return;
-			} else if (*(m_news[index]) > *news) {
-				minIndex = index;
-			} else {
-				maxIndex = index;
-			}
-		}
-
-		destIndex = maxIndex;
 	}
 
-	// Last check if the news is equal to the one at destIndex and if not, adding it
-	if ((destIndex >= m_news.size()) || (*news != *(m_news[destIndex]))) {
-		// Setting the callback for the news to our function
-		news->addCallbackForSetData([this, newsId = news->id()](int roleIndex) { this->newsDataChanged(roleIndex, newsId); });
+	// We have to add the news while keeping the list ordered in descending order. News are
+	// ordered by date, so we can use a binary search to find the inserition point, that is after
+	// all news greater than the one to add
+	// The key is refreshed because data could have been copied into the news without calling
+	// callbacks
+	news->refreshSortKey();
+	const NewsSortKey key = news->sortKey();
+	const int destIndex = m_news.countWhile([&key](const NewsSortKey& k) { return k > key; });
+
+	// Checking if the news is equal to the one at destIndex (i.e. it is already there) and if
+	// not, adding it
+	if ((destIndex >= m_news.size()) || (key != m_news.keyAt(destIndex))) {
+		// Observing changes of the news. Our observer is added before any other (e.g. those of the
+		// model), so it is always the last one to be notified
+		NewsEntry entry;
+		entry.observer = m_newsObserversPool.create(this, news->id()).release();
+		news->addObserver(entry.observer);
 
 		// Emitting signals before and after the news has been added
 		emit aboutToAddNews(destIndex);
 
 		const unsigned int id = news->id();
 		NewsType* const addedNews = news.release();
-		m_news.insert(destIndex, addedNews);
-
-		// Putting the news id and index in the map
-		m_newsIdToIndex[id] = destIndex;
-		// As the index of news after the inserted one have changed, we have to update the values
-		// in the map as well
-		for (auto it = m_newsIdToIndex.begin(); it != m_newsIdToIndex.end(); ++it) {
-			if (it.value() > destIndex) {
-				it.value() += 1;
-			}
-		}
+		entry.news = addedNews;
+
+		// Putting the news id and node in the map. Nodes of other news don't change, so there is
+		// nothing else to update
+		m_newsIdToNode[id] = m_news.insert(destIndex, key, entry);
 
 		// Also saving the association between news link and id
-		m_newsURLToId[addedNews->template getData<NewsRoles::link>()] = id;
+		m_newsUrlIndex.insert(id, addedNews->template getData<NewsRoles::link>());
+		m_newsIdentityIndex.insert(id, *addedNews);
 
-		// We have to modify the complete and qmlItem property so that if they are invalid, we set
-		// them to default values. We do this without triggering the callback
-		m_ignoreNewsCallback = true;
-		if (!addedNews->data(addedNews->template getIndex<NewsRoles::qmlItem>()).isValid()) {
-			addedNews->template setData<NewsRoles::qmlItem>(QUrl("qrc:///qml/NewsDisplay.qml"));
+		// We have to modify the qmlItem property so that if it is not set, we set it to the default
+		// value (complete is false by default). We do this without triggering the callback
+		if (addedNews->template getData<NewsRoles::qmlItem>().isEmpty()) {
+			addedNews->template setData<NewsRoles::qmlItem>(QUrl("qrc:///qml/NewsDisplay.qml"), true);
 		}
-		if (!addedNews->data(addedNews->template getIndex<NewsRoles::complete>()).isValid()) {
-			addedNews->template setData<NewsRoles::complete>(false);
+
+		if (journaling()) {
+			QByteArray payload;
+			QCborStreamWriter writer(&payload);
+			addedNews->save(writer);
+
+			m_journal->append(ChannelJournal::RecordType::NewsAdded, payload);
 		}
-		m_ignoreNewsCallback = false;
 
 		emit newsAdded();
 	}
 }
 
+
+template <class RolesListType, class NewsType>
+bool Channel<RolesListType, NewsType>::applyJournalRecord(ChannelJournal::RecordType type, const QByteArray& payload)
+{
+	QCborStreamReader reader(payload);
+
+	switch (type) {
+		case ChannelJournal::RecordType::NewsAdded:
+			{
+				NewsHandle n = createNews();
+				if (!n->load(reader)) {
+					return false;
+				}
+
+				insertNews(std::move(n));
+			}
+			return true;
+		case ChannelJournal::RecordType::NewsUpdated:
+			{
+				NewsSortKey key;
+				if (!reader.isArray() || !reader.enterContainer() || !ChannelJournal::readKey(reader, key)) {
+					return false;
+				}
+
+				// If the news is not found the change has no effect on the current list (e.g. the
+				// news has been removed by a later record already in the snapshot)
+				const int index = newsIndexByKey(key);
+
+				return (index == -1) || m_news.at(index).news->update(reader);
+			}
+		case ChannelJournal::RecordType::NewsRemoved:
+			{
+				NewsSortKey key;
+				if (!ChannelJournal::readKey(reader, key)) {
+					return false;
+				}
+
+				const int index = newsIndexByKey(key);
+				if (index != -1) {
+					removeNews(index, index, false);
+				}
+			}
+			return true;
+		case ChannelJournal::RecordType::NewsRemovedBefore:
+			{
+				qint64 dateKey;
+				if (!RolesCbor::readValue(reader, dateKey)) {
+					return false;
+				}
+
+				removeNewsBefore(dateKey, false);
+			}
+			return true;
+		case ChannelJournal::RecordType::NewsCleared:
+			if (!m_news.isEmpty()) {
+				removeNews(0, m_news.size() - 1, false);
+			}
+			return true;
+		case ChannelJournal::RecordType::ChannelUpdated:
+			{
+				int fileCreationIndex;
+				if (!reader.isArray() || !reader.enterContainer() || !RolesCbor::readValue(reader, fileCreationIndex)) {
+					return false;
+				}
+				m_fileCreationIndex = fileCreationIndex;
+
+				// Roles are set with callbacks so that observers are notified, but only once
+				return RolesCbor::read(reader, *this, false);
+			}
+	}
+
+	return false;
+}
+
+template <class RolesListType, class NewsType>
+void Channel<RolesListType, NewsType>::rolesChanged(const typename Roles<RolesListType>::ChangedRoles& changedRoles)
+{
+	journalChannelUpdate(changedRoles);
+}
+
+template <class RolesListType, class NewsType>
+void Channel<RolesListType, NewsType>::removeNews(int first, int last, bool deleteFiles)
+{
+	emit aboutToDeleteNews(first, last);
+
+	// Removing from the end, so that indexes of news still to remove don't change
+	const bool journalSuspended = m_journalSuspended;
+	m_journalSuspended = true;
+	for (int i = last; i >= first; --i) {
+		// Removing all files for the news
+		if (deleteFiles) {
+			deleteAllFilesForNews(i);
+		}
+
+		// Removing the ID and URL from maps
+		const unsigned int id = m_news.at(i).news->id();
+		m_newsIdToNode.remove(id);
+		m_newsUrlIndex.remove(id);
+		m_newsIdentityIndex.remove(id);
+
+		// Removing the news
+		destroyNews(m_news.takeAt(i));
+	}
+	m_journalSuspended = journalSuspended;
+
+	emit newsDeleted();
+}
+
+template <class RolesListType, class NewsType>
+bool Channel<RolesListType, NewsType>::removeNewsBefore(qint64 dateKey, bool deleteFiles)
+{
+	// News are ordered by descending date, we can use a binary search to find the first news
+	// before date
+	const int startIndex = m_news.countWhile([dateKey](const NewsSortKey& k) { return k.pubDate() > dateKey; });
+	if (startIndex == m_news.size()) {
+		return false;
+	}
+
+	removeNews(startIndex, m_news.size() - 1, deleteFiles);
+
+	return true;
+}
+
+template <class RolesListType, class NewsType>
+int Channel<RolesListType, NewsType>::newsIndexByKey(const NewsSortKey& key) const
+{
+	const int index = m_news.countWhile([&key](const NewsSortKey& k) { return k > key; });
+
+	return ((index < m_news.size()) && (m_news.keyAt(index) == key)) ? index : -1;
+}
+
+template <class RolesListType, class NewsType>
+void Channel<RolesListType, NewsType>::journalChannelUpdate(const typename Roles<RolesListType>::ChangedRoles& changedRoles)
+{
+	if (journaling()) {
+		QByteArray payload;
+		QCborStreamWriter writer(&payload);
+		writer.startArray(2);
+		writer.append(m_fileCreationIndex);
+		RolesCbor::write(writer, *this, changedRoles);
+		writer.endArray();
+
+		m_journal->append(ChannelJournal::RecordType::ChannelUpdated, payload);
+	}
+}
+
+template <class RolesListType, class NewsType>
+void Channel<RolesListType, NewsType>::decodeSnapshotChunk(const std::shared_ptr<SnapshotLoad>& load, int chunk)
+{
+	if (load->cancelled) {
+		return;
+	}
+
+	const int firstRow = chunk * __internal::snapshotChunkSize;
+	const int endRow = qMin(firstRow + __internal::snapshotChunkSize, load->newsTable.numRows());
+	const ColumnarSnapshotReader::Table& newsTable = load->newsTable;
+	const QVector<int>& newsColumns = load->newsColumns;
+
+	std::vector<NewsType> news;
+	news.reserve(endRow - firstRow);
+	for (int row = firstRow; row < endRow; ++row) {
+		news.emplace_back(0);
+
+		news.back().visitRoles([&newsTable, &newsColumns, row](int index, const char*, auto& value) {
+			const int c = newsColumns[index];
+
+			if (c != -1) {
+				newsTable.read(c, row, value);
+			}
+		});
+	}
+
+	{
+		QMutexLocker locker(&load->mutex);
+
+		load->chunks[chunk] = std::move(news);
+		load->chunkReady[chunk] = true;
+	}
+
+	// The channel can only be used by the main thread
+	QCoreApplication::postEvent(&(CommandEventReceiver::instance()), new CommandEvent([load]() {
+		if (!load->cancelled) {
+			load->channel->addSnapshotChunks();
+		}
+	}));
+}
+
+template <class RolesListType, class NewsType>
+void Channel<RolesListType, NewsType>::addSnapshotChunks()
+{
+	// An event could arrive after the last chunk has been added
+	const std::shared_ptr<SnapshotLoad> load = m_snapshotLoad;
+	if (!load) {
+		return;
+	}
+
+	while (load->nextChunk < int(load->chunks.size())) {
+		std::vector<NewsType> news;
+
+		{
+			QMutexLocker locker(&load->mutex);
+
+			if (!load->chunkReady[load->nextChunk]) {
+				break;
+			}
+
+			news.swap(load->chunks[load->nextChunk]);
+		}
+
+		++load->nextChunk;
+
+		// Moving data to news allocated from the pool. Chunks come in the order of the list, so
+		// each news is added at the end
+		for (auto& n: news) {
+			NewsHandle h = createNews();
+			h->moveDataFromOtherRolesList(std::move(n));
+
+			insertNews(std::move(h));
+		}
+	}
+
+	if (load->nextChunk == int(load->chunks.size())) {
+		m_snapshotLoad.reset();
+
+		load->callback();
+	}
+}
+
 #endif
@@ -0,0 +1,399 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __CHANNEL_JOURNAL_H__
+#define __CHANNEL_JOURNAL_H__
+
+#include <QThread>
+#include <QString>
+#include <QList>
+#include <QFile>
+#include <QByteArray>
+#include <QCborStreamWriter>
+#include <QCborStreamReader>
+#include <QMutex>
+#include <QWaitCondition>
+#include "include/newssortkey.h"
+
+class AbstractChannel;
+
+/**
+ * \brief The class storing the channel on disk as a snapshot plus a journal
+ *        of changes
+ *
+ * The state of the channel on disk is made up of two files: a snapshot with the
+ * whole channel (see AbstractChannel::saveSnapshot()) and a journal. The
+ * channel appends a compact record to the journal for every change (a news is
+ * added, roles of a news or of the channel change, news are removed). Records
+ * are enqueued with append(), which is thread-safe and cheap, and written by
+ * the thread of this class, so neither the user interface nor shutdown have to
+ * wait for the whole channel to be serialized. From time to time the channel
+ * should be compacted (see compact()): the snapshot is rewritten atomically and
+ * the journal is emptied. When the application starts, restore() loads the
+ * snapshot and then replays the journal on the channel. The snapshot file is
+ * memory-mapped and the channel reads news directly from the mapped data in the
+ * background (see AbstractChannel::loadSnapshot()), so restoring is
+ * asynchronous: the restored() signal is emitted when done. The snapshot file
+ * starts with a magic number, the generation, the size of the data and the
+ * CRC-32 of the data (all quint32, little endian), followed by the data of the
+ * channel. The snapshot is written to a temporary file that atomically replaces
+ * the old one (see QSaveFile) and the size and CRC are verified before loading:
+ * a damaged snapshot is discarded together with its journal. The data file
+ * written by versions without the journal (a JSON object in Qt binary JSON
+ * format, see AbstractChannel::load()) is still read, with generation 0.
+ *
+ * The journal starts with a header containing a magic number and a
+ * generation. The generation is also stored in the snapshot and is increased
+ * by each compaction, so that a journal left behind by a compaction that was
+ * interrupted after the new snapshot has been written is discarded. Each
+ * record is made of the size of the payload (quint32), the type of the record
+ * (quint8), the CRC-32 of the payload (quint32) and the payload, a CBOR stream
+ * written directly from the roles (see RolesCbor; all integers in the header
+ * of records are little endian). A record that is incomplete or has a wrong
+ * CRC (e.g. because the application was killed while writing it) ends the
+ * journal: it is discarded with everything following it.
+ *
+ * Records are written in the order in which they are enqueued, compactions
+ * included. Call start() after restored() has been emitted, the thread runs
+ * until stop() is called. Records still in the queue are written before the
+ * thread exits
+ */
+class ChannelJournal : public QThread
+{
+	Q_OBJECT
+
+public:
+	/**
+	 * \brief The type of records in the journal
+	 *
+	 * The CBOR payload of each record is described here. News are
+	 * identified by their sort key before the change (see writeKey())
+	 */
+	enum class RecordType : quint8 {
+		NewsAdded = 1, /// A news has been added. The payload is the map
+		               /// written by News::save()
+		NewsUpdated = 2, /// Roles of a news changed. The payload is an array
+		                 /// with the key of the news and the map of the
+		                 /// changed roles
+		NewsRemoved = 3, /// A news has been removed. The payload is the key
+		                 /// of the news
+		NewsRemovedBefore = 4, /// News older than a date have been removed.
+		                       /// The payload is the date part of the key
+		NewsCleared = 5, /// All news have been removed. The payload is empty
+		ChannelUpdated = 6 /// Roles of the channel changed. The payload is an
+		                   /// array with the index used to create files and
+		                   /// the map of the changed roles (possibly empty)
+	};
+
+	/**
+	 * \brief Writes the key of a news
+	 *
+	 * The key is written as an array with the date part of the key and the
+	 * title
+	 * \param writer the CBOR writer
+	 * \param key the key to write
+	 */
+	static void writeKey(QCborStreamWriter& writer, const NewsSortKey& key);
+
+	/**
+	 * \brief Reads a key written by writeKey()
+	 *
+	 * \param reader the CBOR reader
+	 * \param key the variable where the key is put
+	 * \return false in case of error
+	 */
+	static bool readKey(QCborStreamReader& reader, NewsSortKey& key);
+
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * The directory of the files is created if it doesn't exist
+	 * \param snapshotFile the absolute path of the file with the snapshot
+	 * \param journalFile the absolute path of the file with the journal
+	 */
+	ChannelJournal(QString snapshotFile, QString journalFile);
+
+	/**
+	 * \brief Destructor
+	 *
+	 * You must stop the thread externally before calling this
+	 */
+	virtual ~ChannelJournal();
+
+	/**
+	 * \brief Starts loading the snapshot into the channel and replaying
+	 *        the journal
+	 *
+	 * News in the snapshot are added to the channel while the event loop
+	 * runs, the journal is replayed once they have all been added and then
+	 * the restored() signal is emitted (possibly before this function
+	 * returns). This must be called before the thread is started and the
+	 * journal must be set on the channel only after restored() has been
+	 * emitted (otherwise replayed changes would be journaled again). A
+	 * damaged tail of the journal is removed from the file
+	 * \param channel the channel to restore
+	 */
+	void restore(AbstractChannel* channel);
+
+	/**
+	 * \brief Enqueues a record
+	 *
+	 * The record is written by the thread of this class. This function is
+	 * thread-safe
+	 * \param type the type of the record
+	 * \param payload the payload of the record
+	 */
+	void append(RecordType type, const QByteArray& payload);
+
+	/**
+	 * \brief Enqueues a compaction
+	 *
+	 * The snapshot is replaced with the given one and the journal is
+	 * emptied. The snapshot must contain all the changes enqueued so far.
+	 * This function is thread-safe
+	 * \param snapshot the data of the whole channel (see
+	 *                 AbstractChannel::saveSnapshot())
+	 */
+	void compact(const QByteArray& snapshot);
+
+	/**
+	 * \brief Waits until all enqueued records have been written
+	 *
+	 * If the thread is not running, records are written by the calling
+	 * thread
+	 */
+	void flush();
+
+	/**
+	 * \brief Asks the thread to stop once the queue is empty
+	 */
+	void stop();
+
+	/**
+	 * \brief Returns the size of the journal file
+	 *
+	 * This is the size of what has been written so far, records still in
+	 * the queue are not considered. Use this to decide when to compact.
+	 * This function is thread-safe
+	 * \return the size of the journal file in bytes
+	 */
+	qint64 journalSize() const;
+
+	/**
+	 * \brief Returns the number of records enqueued since the last
+	 *        compaction
+	 *
+	 * Records replayed by restore() count as one. Use this to skip
+	 * compactions when nothing changed. This function is thread-safe
+	 * \return the number of records enqueued since the last compaction
+	 */
+	int changesSinceCompaction() const;
+
+signals:
+	/**
+	 * \brief The signal emitted when the channel has been restored
+	 *
+	 * \param dataFound false if no previous data could be read, true
+	 *                  otherwise
+	 */
+	void restored(bool dataFound);
+
+private:
+	/**
+	 * \brief The structure with a job for the writing thread
+	 */
+	struct Job {
+		/**
+		 * \brief True if this is a compaction, false for a record
+		 */
+		bool compaction;
+
+		/**
+		 * \brief The type of the record
+		 *
+		 * Not used for compactions
+		 */
+		RecordType type;
+
+		/**
+		 * \brief The payload of the record
+		 *
+		 * Not used for compactions
+		 */
+		QByteArray data;
+
+		/**
+		 * \brief The data of the snapshot
+		 *
+		 * Only used for compactions
+		 */
+		QByteArray snapshot;
+	};
+
+	/**
+	 * \brief The function doing the actual work
+	 */
+	virtual void run();
+
+	/**
+	 * \brief Writes the jobs in the queue
+	 *
+	 * The mutex must be locked by the given locker. It is unlocked while
+	 * jobs are written
+	 * \param locker the locker with the mutex
+	 */
+	void writePendingJobs(QMutexLocker& locker);
+
+	/**
+	 * \brief Appends a record to the journal file
+	 *
+	 * \param type the type of the record
+	 * \param payload the payload of the record
+	 */
+	void writeRecord(RecordType type, const QByteArray& payload);
+
+	/**
+	 * \brief Writes a new snapshot and empties the journal
+	 *
+	 * If the snapshot cannot be written, the journal is kept
+	 * \param snapshot the data of the whole channel
+	 */
+	void writeSnapshot(const QByteArray& snapshot);
+
+	/**
+	 * \brief Starts loading the snapshot into the channel
+	 *
+	 * This also sets the generation. When the snapshot has been loaded (or
+	 * could not be read) finishRestore() is called
+	 * \param channel the channel to restore
+	 */
+	void loadSnapshot(AbstractChannel* channel);
+
+	/**
+	 * \brief Checks the size and the checksum of a snapshot
+	 *
+	 * \param data the snapshot, header included
+	 * \param size the size of the snapshot
+	 * \return true if the snapshot is not damaged
+	 */
+	static bool checkSnapshot(const uchar* data, qint64 size);
+
+	/**
+	 * \brief Replays the journal, opens it for writing and emits the
+	 *        restored() signal
+	 *
+	 * \param channel the channel to restore
+	 * \param snapshotLoaded whether the snapshot has been loaded
+	 */
+	void finishRestore(AbstractChannel* channel, bool snapshotLoaded);
+
+	/**
+	 * \brief Replays the records in the journal on the channel
+	 *
+	 * Records are replayed until the end of the file or until a damaged
+	 * record is found
+	 * \param channel the channel on which records are replayed
+	 * \return the size of the part of the journal that has been replayed
+	 *         (header included) or 0 if the journal does not exist, is
+	 *         invalid or does not belong to the current generation
+	 */
+	qint64 replayJournal(AbstractChannel* channel);
+
+	/**
+	 * \brief Empties the journal file and writes the header with the
+	 *        current generation
+	 *
+	 * \return false in case of error
+	 */
+	bool resetJournal();
+
+	/**
+	 * \brief The absolute path of the file with the snapshot
+	 */
+	const QString m_snapshotFile;
+
+	/**
+	 * \brief The file with the snapshot while it is loaded
+	 *
+	 * The file is kept open, and mapped, while the channel reads news
+	 */
+	QFile m_mappedSnapshot;
+
+	/**
+	 * \brief The file with the journal
+	 *
+	 * After restore() this is only used by the writing thread (or by the
+	 * thread calling flush() when the writing thread is not running)
+	 */
+	QFile m_journalFile;
+
+	/**
+	 * \brief The generation of the snapshot and journal
+	 */
+	quint32 m_generation;
+
+	/**
+	 * \brief The size of the journal file
+	 *
+	 * This is protected by m_mutex
+	 */
+	qint64 m_journalSize;
+
+	/**
+	 * \brief The number of records enqueued since the last compaction
+	 *
+	 * This is protected by m_mutex
+	 */
+	int m_changesSinceCompaction;
+
+	/**
+	 * \brief The queue of jobs to write
+	 */
+	QList<Job> m_jobs;
+
+	/**
+	 * \brief True while jobs taken from the queue are being written
+	 */
+	bool m_writing;
+
+	/**
+	 * \brief This is set to true when the thread must stop
+	 */
+	bool m_stop;
+
+	/**
+	 * \brief The mutex protecting access to member across threads
+	 */
+	mutable QMutex m_mutex;
+
+	/**
+	 * \brief The wait condition on which the worker thread waits for jobs
+	 */
+	QWaitCondition m_waitCondition;
+
+	/**
+	 * \brief The wait condition on which flush() waits for the queue to
+	 *        be written
+	 */
+	QWaitCondition m_flushedCondition;
+};
+
+#endif
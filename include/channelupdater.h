@@ -34,17 +34,17 @@
 #include <QSet>
 #include <QString>
 #include <QStringList>
+#include <QTimer>
 #include <QUrl>
 #include <QVariant>
 #include <array>
 #include <memory>
 #include "include/utilities.h"
+#include "include/networkmanager.h"
+#include "include/allnewscompleter.h"
 
 class RssParser;
 
-template <class, class>
-class AllNewsCompleter;
-
 /**
  * \brief The abstract base class for channel updater
  *
@@ -94,6 +94,33 @@ public:
 	 */
 	virtual void clearAllNews() = 0;
 
+	/**
+	 * \brief Sets the range of news that are currently visible
+	 *
+	 * Visible news and news in the prefetch window around them are
+	 * completed before all the others
+	 * \param firstIndex the index of the first visible news
+	 * \param lastIndex the index of the last visible news
+	 */
+	virtual void setVisibleNewsRange(int firstIndex, int lastIndex) = 0;
+
+	/**
+	 * \brief Asks to complete the news with the given index as soon as
+	 *        possible
+	 *
+	 * Use this when the user wants to read the news
+	 * \param index the index of the news to complete
+	 */
+	virtual void requestNewsCompletion(int index) = 0;
+
+	/**
+	 * \brief Sets the number of news before and after the visible ones
+	 *        that are completed together with visible news
+	 *
+	 * \param numNews the size of the prefetch window
+	 */
+	virtual void setPrefetchWindow(int numNews) = 0;
+
 signals:
 	/**
 	 * \brief The signal emitted in case of error while updating the channel
@@ -101,6 +128,22 @@ signals:
 	 * \param reasong a description of the error
 	 */
 	void error(QString reason);
+
+	/**
+	 * \brief The signal emitted when an update of the channel has finished
+	 *
+	 * This is emitted when new news have been added and the channel has
+	 * been completed, before news are completed
+	 */
+	void updateFinished();
+
+	/**
+	 * \brief The signal emitted when the completer of news stops
+	 *
+	 * This is emitted when all news have been completed or the completion
+	 * has been stopped (e.g. for an update)
+	 */
+	void newsCompletionFinished();
 };
 
 /**
@@ -130,7 +173,13 @@ signals:
  *	  is called, the news completer can be destroyed at any time. It must
  *	  also have a start() function that is called to start completing the
  *	  news and that can be called multiple times to complete the news once
- *	  more.
+ *	  more, an abort() function, a succeeded() function and a
+ *	  networkFailure() function (see DefaultNewsCompleter for details).
+ * News are not all completed as soon as they are received: the visible news
+ * (see setVisibleNewsRange()) and those in the prefetch window around them are
+ * completed first, news explicitly requested (see requestNewsCompletion()) jump
+ * in front of everything else. All other news are completed only when the user
+ * has been idle for a while or if the connection is not metered.
  * Note that this class is NOT THREAD SAFE, so the channel and news completers
  * must not call functions of channel or news from a different thread.
  */
@@ -142,9 +191,12 @@ public:
 	 * \brief Constructor
 	 *
 	 * \param channel the channel to update
+	 * \param prefetchWindow the number of news before and after the
+	 *                       visible ones that are completed together with
+	 *                       visible news (see setPrefetchWindow())
 	 * \param parent the parent object
 	 */
-	ChannelUpdater(ChannelType* channel, QObject* parent = nullptr);
+	ChannelUpdater(ChannelType* channel, int prefetchWindow, QObject* parent = nullptr);
 
 	/**
 	 * \brief Destructor
@@ -192,7 +244,50 @@ public:
 	 */
 	virtual void clearAllNews() override;
 
+	/**
+	 * \brief Sets the range of news that are currently visible
+	 *
+	 * Visible news and news in the prefetch window around them are
+	 * completed before all the others
+	 * \param firstIndex the index of the first visible news
+	 * \param lastIndex the index of the last visible news
+	 */
+	virtual void setVisibleNewsRange(int firstIndex, int lastIndex) override;
+
+	/**
+	 * \brief Asks to complete the news with the given index as soon as
+	 *        possible
+	 *
+	 * Use this when the user wants to read the news
+	 * \param index the index of the news to complete
+	 */
+	virtual void requestNewsCompletion(int index) override;
+
+	/**
+	 * \brief Sets the number of news before and after the visible ones
+	 *        that are completed together with visible news
+	 *
+	 * \param numNews the size of the prefetch window
+	 */
+	virtual void setPrefetchWindow(int numNews) override;
+
 private:
+	/**
+	 * \brief Starts completing news or tells the news completer that
+	 *        priorities have changed
+	 *
+	 * News completion is not started if the channel is being updated or
+	 * if an update or removal of all news is pending
+	 */
+	void completeNewsWithPriorities();
+
+	/**
+	 * \brief The function called when the user has been idle for a while
+	 *
+	 * This allows completing news outside the visible range
+	 */
+	void userIdle();
+
 	/**
 	 * \brief The function called when the ChannelCompleter has finished its
 	 *        job
@@ -227,7 +322,10 @@ private:
 	/**
 	 * \brief  The object completing all news
 	 *
-	 * This exists only when completing news
+	 * This is created in the constructor and lives as long as this object,
+	 * so that it can keep track of incomplete news and of statistics about
+	 * completions. Use its isRunning() function to know if news are being
+	 * completed
 	 */
 	std::unique_ptr<AllNewsCompleter<ChannelType, NewsCompleter>> m_allNewsCompleter;
 
@@ -241,14 +339,39 @@ private:
 	 *        finishes
 	 */
 	bool m_clearNewsWhenPossible;
+
+	/**
+	 * \brief The criteria to choose which news to complete
+	 */
+	NewsCompletionPriorities m_completionPriorities;
+
+	/**
+	 * \brief The timer to detect when the user is idle
+	 *
+	 * News outside the visible range are completed after this timer
+	 * expires
+	 */
+	QTimer m_idleTimer;
 };
 
 // Implementation of template functions of ChannelUpdater
 #include "include/rssparser.h"
-#include "include/allnewscompleter.h"
+
+namespace __internal {
+	/**
+	 * \brief The time in milliseconds without user activity after which
+	 *        news outside the visible range are completed
+	 */
+	const int idleCompletionDelay = 30000;
+
+	/**
+	 * \brief The maximum number of requested news we remember
+	 */
+	const int maxRequestedNews = 10;
+}
 
 template <class ChannelType, class ChannelCompleter, class NewsCompleter>
-ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::ChannelUpdater(ChannelType* channel, QObject* parent)
+ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::ChannelUpdater(ChannelType* channel, int prefetchWindow, QObject* parent)
 	: AbstractChannelUpdater(parent)
 	, m_channel(channel)
 	, m_parser()
@@ -256,7 +379,15 @@ ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::ChannelUpdater(Cha
 	, m_allNewsCompleter()
 	, m_updateWhenNewsCompleted(false)
 	, m_clearNewsWhenPossible(false)
+	, m_completionPriorities{-1, -1, prefetchWindow, QList<unsigned int>(), false}
+	, m_idleTimer()
 {
+	m_allNewsCompleter = std::make_unique<AllNewsCompleter<ChannelType, NewsCompleter>>(m_channel, &m_completionPriorities, [this]() { this->allNewsCompleterFinished(); });
+
+	m_idleTimer.setSingleShot(true);
+	m_idleTimer.setInterval(__internal::idleCompletionDelay);
+	connect(&m_idleTimer, &QTimer::timeout, this, [this]() { this->userIdle(); });
+	m_idleTimer.start();
 }
 
 template <class ChannelType, class ChannelCompleter, class NewsCompleter>
@@ -294,10 +425,13 @@ template <class ChannelType, class ChannelCompleter, class NewsCompleter>
 void ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::update()
 {
 	// If there are news to be completed or are already updating, we skip the update now and
-	// schedule it for when all news have been completed
-	if (m_parser || m_channelCompleter || m_allNewsCompleter) {
+	// schedule it for when all news have been completed. News being completed are finished, but
+	// no new news completion is started
+	if (m_parser || m_channelCompleter || m_allNewsCompleter->isRunning()) {
 		m_updateWhenNewsCompleted = true;
 
+		m_allNewsCompleter->stopWhenPossible();
+
 		return;
 	}
 
@@ -317,9 +451,11 @@ void ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::clearAllNews(
 {
 	// If we are fetching news or completing some news, we have to schedule the removal
 	// of all news for later
-	if (m_parser || m_channelCompleter || m_allNewsCompleter) {
+	if (m_parser || m_channelCompleter || m_allNewsCompleter->isRunning()) {
 		m_clearNewsWhenPossible = true;
 
+		m_allNewsCompleter->stopWhenPossible();
+
 		return;
 	}
 
@@ -329,12 +465,80 @@ void ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::clearAllNews(
 	m_channel->clearAllNews();
 }
 
+template <class ChannelType, class ChannelCompleter, class NewsCompleter>
+void ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::setVisibleNewsRange(int firstIndex, int lastIndex)
+{
+	m_completionPriorities.firstVisibleNews = firstIndex;
+	m_completionPriorities.lastVisibleNews = lastIndex;
+
+	// The user is active: news outside the visible range are only completed on unmetered
+	// connections until the user is idle again
+	m_completionPriorities.completeOtherNews = NM::instance().isConnectionUnmetered();
+	m_idleTimer.start();
+
+	completeNewsWithPriorities();
+}
+
+template <class ChannelType, class ChannelCompleter, class NewsCompleter>
+void ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::requestNewsCompletion(int index)
+{
+	if ((index < 0) || (index >= m_channel->numNews())) {
+		return;
+	}
+
+	// Putting the news in front of the list of requested news
+	const unsigned int id = m_channel->news(index).id();
+	m_completionPriorities.requestedNews.removeAll(id);
+	m_completionPriorities.requestedNews.prepend(id);
+	while (m_completionPriorities.requestedNews.size() > __internal::maxRequestedNews) {
+		m_completionPriorities.requestedNews.removeLast();
+	}
+
+	// The user asked for this news, not waiting for the backoff delay if it failed before
+	m_allNewsCompleter->retryNow(id);
+
+	completeNewsWithPriorities();
+}
+
+template <class ChannelType, class ChannelCompleter, class NewsCompleter>
+void ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::setPrefetchWindow(int numNews)
+{
+	m_completionPriorities.prefetchWindow = qMax(0, numNews);
+
+	completeNewsWithPriorities();
+}
+
+template <class ChannelType, class ChannelCompleter, class NewsCompleter>
+void ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::completeNewsWithPriorities()
+{
+	// If we are updating or something is pending, news will be completed later
+	if (m_parser || m_channelCompleter || m_clearNewsWhenPossible || m_updateWhenNewsCompleted) {
+		return;
+	}
+
+	if (m_allNewsCompleter->isRunning()) {
+		m_allNewsCompleter->prioritiesChanged();
+	} else {
+		m_allNewsCompleter->start();
+	}
+}
+
+template <class ChannelType, class ChannelCompleter, class NewsCompleter>
+void ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::userIdle()
+{
+	m_completionPriorities.completeOtherNews = true;
+
+	completeNewsWithPriorities();
+}
+
 template <class ChannelType, class ChannelCompleter, class NewsCompleter>
 void ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::channelCompleterFinished()
 {
 	// Scheduling the removal of the channel completer
 	QCoreApplication::postEvent(&(CommandEventReceiver::instance()), new CommandEvent([ptr = m_channelCompleter.release()]() { delete ptr; }));
 
+	emit updateFinished();
+
 	bool completeNews = true;
 
 	// If the complete removal of all news was scheduled, doing it
@@ -351,18 +555,20 @@ void ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::channelComple
 		completeNews = false;
 	}
 
-	// Completing all news if we have to
+	// Completing news if we have to
 	if (completeNews) {
-		m_allNewsCompleter = std::make_unique<AllNewsCompleter<ChannelType, NewsCompleter>>(m_channel, [this]() { this->allNewsCompleterFinished(); });
-		m_allNewsCompleter->start();
+		if (!m_completionPriorities.completeOtherNews) {
+			m_completionPriorities.completeOtherNews = NM::instance().isConnectionUnmetered();
+		}
+
+		completeNewsWithPriorities();
 	}
 }
 
 template <class ChannelType, class ChannelCompleter, class NewsCompleter>
 void ChannelUpdater<ChannelType, ChannelCompleter, NewsCompleter>::allNewsCompleterFinished()
 {
-	// Scheduling the removal of the all news completer
-	QCoreApplication::postEvent(this, new CommandEvent([ptr = m_allNewsCompleter.release()]() { delete ptr; }));
+	emit newsCompletionFinished();
 
 	// If the complete removal of all news was scheduled, doing it
 	if (m_clearNewsWhenPossible) {
@@ -0,0 +1,520 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __COLUMNAR_SNAPSHOT_H__
+#define __COLUMNAR_SNAPSHOT_H__
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+#include <QDateTime>
+#include <QVector>
+
+/**
+ * \file columnarsnapshot.h
+ *
+ * This file contains the classes to write and read the binary format used to
+ * store snapshots of channels. Data is organized in tables, each table has a
+ * fixed number of rows (e.g. one per news) and one column per role. The kind of
+ * each column is derived from the type of the role (see
+ * ColumnarSnapshotWriter::append()), so the layout of a table follows the
+ * RolesList it comes from and a role of a type that cannot be stored does not
+ * compile. Roles are visited with RolesList::visitRoles(), data is written and
+ * read with its native type, without QVariants and without looking up names
+ * for each value: columns are matched to roles by name once per table.
+ *
+ * The format is the following (integers are in the byte order of the machine,
+ * the magic number at the beginning makes files written with a different byte
+ * order invalid):
+ *	- quint32 magic number and quint32 version;
+ *	- tables, one after the other. Each table has the number of rows
+ *	  (quint32) and the number of columns (quint32), followed by columns.
+ *	  Each column has the kind (quint8, see SnapshotColumnKind), the length
+ *	  of the name (quint8), the name (latin1, not null-terminated), the size
+ *	  of cells (quint32) and cells, the size of the heap (quint32) and the
+ *	  heap.
+ * Cells have a fixed width that depends on the kind: 1 byte for booleans, 4
+ * bytes for integers, 8 bytes for dates (milliseconds since the epoch, the
+ * minimum qint64 for invalid dates) and 8 bytes (quint32 offset and size in
+ * bytes in the heap) for strings, urls and lists of strings. Strings are
+ * stored in the heap as UTF-16 (urls are stored in encoded form), lists of
+ * strings as the number of strings (quint32) followed by the size in bytes
+ * (quint32) and the data of each string. Reading is done directly from memory
+ * (e.g. a memory-mapped file), every offset and size is checked
+ */
+
+/**
+ * \brief The kind of a column of a snapshot
+ */
+enum class SnapshotColumnKind : quint8 {
+	Bool = 1, /// Booleans
+	UInt = 2, /// Unsigned integers
+	Int = 3, /// Signed integers
+	DateTime = 4, /// Dates
+	String = 5, /// Strings
+	Url = 6, /// Urls
+	StringList = 7 /// Lists of strings
+};
+
+/**
+ * \brief The class writing a snapshot
+ *
+ * Call beginTable(), then append() for each column of each row (rows in order,
+ * all columns of a row before the next row) and finally endTable(). Column
+ * indexes are chosen by the caller (e.g. role indexes) and need not be
+ * contiguous. The data of the snapshot is returned by data()
+ */
+class ColumnarSnapshotWriter
+{
+public:
+	/**
+	 * \brief Constructor
+	 */
+	ColumnarSnapshotWriter();
+
+	/**
+	 * \brief Starts a new table
+	 *
+	 * \param numRows the number of rows of the table
+	 */
+	void beginTable(int numRows);
+
+	/**
+	 * \brief Appends a boolean to a column
+	 *
+	 * \param column the index of the column
+	 * \param name the name of the column (at most 255 characters)
+	 * \param value the value to append
+	 */
+	void append(int column, const char* name, bool value);
+
+	/**
+	 * \brief Appends an unsigned integer to a column
+	 *
+	 * \param column the index of the column
+	 * \param name the name of the column (at most 255 characters)
+	 * \param value the value to append
+	 */
+	void append(int column, const char* name, unsigned int value);
+
+	/**
+	 * \brief Appends an integer to a column
+	 *
+	 * \param column the index of the column
+	 * \param name the name of the column (at most 255 characters)
+	 * \param value the value to append
+	 */
+	void append(int column, const char* name, int value);
+
+	/**
+	 * \brief Appends a date to a column
+	 *
+	 * \param column the index of the column
+	 * \param name the name of the column (at most 255 characters)
+	 * \param value the value to append
+	 */
+	void append(int column, const char* name, const QDateTime& value);
+
+	/**
+	 * \brief Appends a string to a column
+	 *
+	 * \param column the index of the column
+	 * \param name the name of the column (at most 255 characters)
+	 * \param value the value to append
+	 */
+	void append(int column, const char* name, const QString& value);
+
+	/**
+	 * \brief Appends an url to a column
+	 *
+	 * \param column the index of the column
+	 * \param name the name of the column (at most 255 characters)
+	 * \param value the value to append
+	 */
+	void append(int column, const char* name, const QUrl& value);
+
+	/**
+	 * \brief Appends a list of strings to a column
+	 *
+	 * \param column the index of the column
+	 * \param name the name of the column (at most 255 characters)
+	 * \param value the value to append
+	 */
+	void append(int column, const char* name, const QStringList& value);
+
+	/**
+	 * \brief Ends the current table
+	 *
+	 * This writes the columns of the table
+	 */
+	void endTable();
+
+	/**
+	 * \brief Returns the data of the snapshot
+	 *
+	 * \return the data of the snapshot
+	 */
+	const QByteArray& data() const
+	{
+		return m_data;
+	}
+
+private:
+	/**
+	 * \brief The structure with a column being written
+	 */
+	struct Column {
+		/**
+		 * \brief The name of the column
+		 */
+		const char* name = nullptr;
+
+		/**
+		 * \brief The kind of the column
+		 *
+		 * 0 if the column is not used in the current table
+		 */
+		quint8 kind = 0;
+
+		/**
+		 * \brief The cells
+		 */
+		QByteArray cells;
+
+		/**
+		 * \brief The heap with variable-size data
+		 */
+		QByteArray heap;
+	};
+
+	/**
+	 * \brief Returns the column with the given index
+	 *
+	 * The column is created if it doesn't exist
+	 * \param column the index of the column
+	 * \param name the name of the column
+	 * \param kind the kind of the column
+	 * \return the column
+	 */
+	Column& column(int column, const char* name, SnapshotColumnKind kind);
+
+	/**
+	 * \brief Appends a string to the heap of a column and its offset and
+	 *        size to cells
+	 *
+	 * \param c the column
+	 * \param value the string to append
+	 */
+	static void appendString(Column& c, const QString& value);
+
+	/**
+	 * \brief The data of the snapshot
+	 */
+	QByteArray m_data;
+
+	/**
+	 * \brief The number of rows of the current table
+	 */
+	int m_numRows;
+
+	/**
+	 * \brief The columns of the current table
+	 */
+	QVector<Column> m_columns;
+};
+
+/**
+ * \brief The class reading a snapshot
+ *
+ * The reader does not copy data, the memory passed to the constructor must be
+ * valid as long as the reader and tables are used. Tables are read in the order
+ * in which they were written, with readTable()
+ */
+class ColumnarSnapshotReader
+{
+public:
+	/**
+	 * \brief A table of the snapshot
+	 */
+	class Table
+	{
+	public:
+		/**
+		 * \brief Constructor
+		 *
+		 * Creates an empty table
+		 */
+		Table();
+
+		/**
+		 * \brief Returns the number of rows
+		 *
+		 * \return the number of rows
+		 */
+		int numRows() const
+		{
+			return m_numRows;
+		}
+
+		/**
+		 * \brief Returns the index of the column with the given name
+		 *
+		 * \param name the name of the column
+		 * \return the index of the column or -1 if no column has the
+		 *         given name
+		 */
+		int columnIndex(const char* name) const;
+
+		/**
+		 * \brief Returns the columns of the given roles
+		 *
+		 * Columns are matched to roles by name, the template parameter
+		 * must have the static function getRoleIndexFromName() (e.g.
+		 * Roles)
+		 * \return a vector with the index of the column of each role
+		 *         (-1 if the table has no column for a role)
+		 */
+		template <class RolesType>
+		QVector<int> columnsForRoles() const
+		{
+			QVector<int> columns(RolesType::numRoles(), -1);
+
+			for (int c = 0; c < m_columns.size(); ++c) {
+				const int r = RolesType::getRoleIndexFromName(m_columns[c].name, m_columns[c].nameLength);
+
+				if (r != -1) {
+					columns[r] = c;
+				}
+			}
+
+			return columns;
+		}
+
+		/**
+		 * \brief Reads a boolean
+		 *
+		 * Values are only modified if they can be read
+		 * \param column the index of the column
+		 * \param row the row
+		 * \param value the variable where the value is put
+		 * \return false if the column has a different kind
+		 */
+		bool read(int column, int row, bool& value) const;
+
+		/**
+		 * \brief Reads an unsigned integer
+		 *
+		 * \param column the index of the column
+		 * \param row the row
+		 * \param value the variable where the value is put
+		 * \return false if the column has a different kind
+		 */
+		bool read(int column, int row, unsigned int& value) const;
+
+		/**
+		 * \brief Reads an integer
+		 *
+		 * \param column the index of the column
+		 * \param row the row
+		 * \param value the variable where the value is put
+		 * \return false if the column has a different kind
+		 */
+		bool read(int column, int row, int& value) const;
+
+		/**
+		 * \brief Reads a date
+		 *
+		 * \param column the index of the column
+		 * \param row the row
+		 * \param value the variable where the value is put
+		 * \return false if the column has a different kind
+		 */
+		bool read(int column, int row, QDateTime& value) const;
+
+		/**
+		 * \brief Reads a string
+		 *
+		 * \param column the index of the column
+		 * \param row the row
+		 * \param value the variable where the value is put
+		 * \return false if the column has a different kind or data
+		 *         is invalid
+		 */
+		bool read(int column, int row, QString& value) const;
+
+		/**
+		 * \brief Reads an url
+		 *
+		 * \param column the index of the column
+		 * \param row the row
+		 * \param value the variable where the value is put
+		 * \return false if the column has a different kind or data
+		 *         is invalid
+		 */
+		bool read(int column, int row, QUrl& value) const;
+
+		/**
+		 * \brief Reads a list of strings
+		 *
+		 * \param column the index of the column
+		 * \param row the row
+		 * \param value the variable where the value is put
+		 * \return false if the column has a different kind or data
+		 *         is invalid
+		 */
+		bool read(int column, int row, QStringList& value) const;
+
+	private:
+		/**
+		 * \brief The structure with a column
+		 */
+		struct Column {
+			/**
+			 * \brief The name of the column (not null-terminated)
+			 */
+			const char* name;
+
+			/**
+			 * \brief The length of the name
+			 */
+			int nameLength;
+
+			/**
+			 * \brief The kind of the column
+			 */
+			SnapshotColumnKind kind;
+
+			/**
+			 * \brief The cells
+			 */
+			const uchar* cells;
+
+			/**
+			 * \brief The heap
+			 */
+			const uchar* heap;
+
+			/**
+			 * \brief The size of the heap
+			 */
+			quint32 heapSize;
+		};
+
+		/**
+		 * \brief Returns the cell of a column with the given kind
+		 *
+		 * \param column the index of the column
+		 * \param row the row
+		 * \param kind the expected kind of the column
+		 * \return the cell or nullptr if the column has a different
+		 *         kind
+		 */
+		const uchar* cell(int column, int row, SnapshotColumnKind kind) const;
+
+		/**
+		 * \brief Reads a string from the heap of a column
+		 *
+		 * \param c the column
+		 * \param offset the offset of the string in the heap
+		 * \param size the size of the string in bytes
+		 * \param value the variable where the string is put
+		 * \return false if the string is outside the heap
+		 */
+		static bool readString(const Column& c, quint32 offset, quint32 size, QString& value);
+
+		/**
+		 * \brief The number of rows
+		 */
+		int m_numRows;
+
+		/**
+		 * \brief The columns
+		 */
+		QVector<Column> m_columns;
+
+		/**
+		 * \brief The reader is friend to fill tables
+		 */
+		friend class ColumnarSnapshotReader;
+	};
+
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * \param data the data of the snapshot
+	 * \param size the size of data
+	 */
+	ColumnarSnapshotReader(const uchar* data, qint64 size);
+
+	/**
+	 * \brief Returns true if data starts with a valid header
+	 *
+	 * \return true if data starts with a valid header
+	 */
+	bool isValid() const
+	{
+		return m_valid;
+	}
+
+	/**
+	 * \brief Reads the next table
+	 *
+	 * \param table the table that is filled
+	 * \return false if the table is missing or invalid
+	 */
+	bool readTable(Table& table);
+
+private:
+	/**
+	 * \brief Returns true if there are at least the given number of bytes
+	 *        left
+	 *
+	 * \param size the number of bytes
+	 * \return true if there are at least size bytes left
+	 */
+	bool available(qint64 size) const
+	{
+		return (m_size - m_pos) >= size;
+	}
+
+	/**
+	 * \brief The data of the snapshot
+	 */
+	const uchar* const m_data;
+
+	/**
+	 * \brief The size of data
+	 */
+	const qint64 m_size;
+
+	/**
+	 * \brief The current position in data
+	 */
+	qint64 m_pos;
+
+	/**
+	 * \brief True if data starts with a valid header
+	 */
+	bool m_valid;
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include <QObject>
 #include <QSettings>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QJSValue>
 #include <QMap>
 #include <QStandardPaths>
@@ -36,11 +37,16 @@
 #include <QScreen>
 #include <memory>
 #include "include/channel.h"
+#include "include/channeljournal.h"
 #include "include/channelupdater.h"
 #include "include/newslistmodel.h"
 #include "include/iconsgenerator.h"
 #include "include/utilities.h"
 #include "include/networkmanager.h"
+#include "include/finiarchiveresolver.h"
+#include "include/squarespacejsoncache.h"
+#include "include/filewriter.h"
+#include "include/storagequota.h"
 #include "include/rolesqmlaccessor.h"
 
 /**
@@ -56,11 +62,43 @@
  * 	- keepNewsForDays: the number of days old news are kept. If 0 news are
  * 	                   not stored
  *	- fontSize: the size of fonts used in the application
+ *	- completionPrefetchWindow: the number of news before and after the
+ *	                            visible ones that are completed together
+ *	                            with visible news
+ *	- checkpointInterval: the number of minutes between checkpoints, i.e.
+ *	                      rewrites of the stored news (only done if
+ *	                      something changed)
+ *	- attachedFilesQuota: the maximum size in megabytes of files attached
+ *	                      to news (e.g. images). If 0 there is no limit
+ *	- downloadedFilesQuota: the maximum size in megabytes of files
+ *	                        downloaded on request of the user (e.g. audio
+ *	                        resources). If 0 there is no limit
  *
- * News are stored in binary JSON format (Qt format) in a file called "storage"
- * in the writable QStandardPaths::DataLocation. This class is also responsible
- * for generating all the icons at the correct resolution from the svg files
- * stored as resources once the application starts
+ * News are stored in the writable QStandardPaths::AppDataLocation as a binary
+ * columnar snapshot (see columnarsnapshot.h) in a file called "storednews.dat"
+ * plus a journal of the changes made after the snapshot in "storednews.journal"
+ * (see ChannelJournal). Changes are journaled while the application runs and
+ * the snapshot is rewritten in the thread of the journal (a checkpoint) every
+ * checkpointInterval minutes, if something changed. Updates of the channel and
+ * batches of completed news only cause a checkpoint if the journal has grown
+ * too much, because the channel is serialized in the main thread. On exit only
+ * the last records have to be written, so quitting doesn't wait for the channel
+ * to be serialized. Stored news are loaded in the background while the user
+ * interface is created: they appear in the model in batches, most recent first,
+ * and the fullyLoaded property becomes true when the whole channel has been
+ * restored. Until the first batch arrives the model shows the first news as
+ * they were saved in "firstscreen.cbor" (see NewsListModel), which is written
+ * together with checkpoints. Updates from the net, removal of old news,
+ * checkpoints and completion of news only start after that. Files in the data
+ * directory that don't belong to the channel are removed in the background
+ * after the first checkpoint. After each checkpoint the size of files belonging
+ * to news is checked against the quotas (see StorageQuota): files of the news
+ * that were accessed least recently (read or played, see newsAccessed()) are
+ * removed until the quotas are respected. The text of news is kept, evicted
+ * attached files are downloaded again when the news is completed, which happens
+ * when it is visible or opened. This class is also responsible for generating
+ * all the icons at the correct resolution from the svg files stored as
+ * resources once the application starts
  */
 class Controller : public QObject
 {
@@ -69,12 +107,19 @@ class Controller : public QObject
 	Q_PROPERTY(AbstractNewsListModel* newsModel READ newsModel NOTIFY newsModelChanged)
 	Q_PROPERTY(int ttl READ ttl WRITE setTtl NOTIFY ttlChanged)
 	Q_PROPERTY(unsigned int keepNewsForDays READ keepNewsForDays WRITE setKeepNewsForDays NOTIFY keepNewsForDaysChanged)
+	Q_PROPERTY(int completionPrefetchWindow READ completionPrefetchWindow WRITE setCompletionPrefetchWindow NOTIFY completionPrefetchWindowChanged)
+	Q_PROPERTY(int checkpointInterval READ checkpointInterval WRITE setCheckpointInterval NOTIFY checkpointIntervalChanged)
+	Q_PROPERTY(int attachedFilesQuota READ attachedFilesQuota WRITE setAttachedFilesQuota NOTIFY attachedFilesQuotaChanged)
+	Q_PROPERTY(int downloadedFilesQuota READ downloadedFilesQuota WRITE setDownloadedFilesQuota NOTIFY downloadedFilesQuotaChanged)
+	Q_PROPERTY(qreal attachedFilesSize READ attachedFilesSize NOTIFY storageUsageChanged)
+	Q_PROPERTY(qreal downloadedFilesSize READ downloadedFilesSize NOTIFY storageUsageChanged)
 	Q_PROPERTY(bool networkRequestsRunning READ networkRequestsRunning NOTIFY networkRequestsRunningChanged)
 	Q_PROPERTY(bool canIncreaseFontSize READ canIncreaseFontSize NOTIFY canIncreaseFontSizeChanged)
 	Q_PROPERTY(bool canDecreaseFontSize READ canDecreaseFontSize NOTIFY canDecreaseFontSizeChanged)
 	Q_PROPERTY(qreal fontSize READ fontSize NOTIFY fontSizeChanged)
 	Q_PROPERTY(QString aboutText READ aboutText NOTIFY aboutTextChanged)
 	Q_PROPERTY(qreal mm READ mm NOTIFY mmChanged)
+	Q_PROPERTY(bool fullyLoaded READ fullyLoaded NOTIFY fullyLoadedChanged)
 
 public:
 	/**
@@ -101,11 +146,15 @@ public:
 	      , m_aboutTextFilename(aboutTextFilename)
 	      , m_settings()
 	      , m_channel(std::make_unique<ChannelType>(channelURL, QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/" + channelName))
-	      , m_channelUpdater(std::make_unique<ChannelUpdaterType>(static_cast<ChannelType*>(m_channel.get()), this)) // The cast here won't fail for sure
+	      , m_channelUpdater(std::make_unique<ChannelUpdaterType>(static_cast<ChannelType*>(m_channel.get()), completionPrefetchWindow(), this)) // The cast here won't fail for sure
 	      , m_channelRolesQMLAccessor(std::make_unique<RolesQMLAccessor<ChannelType>>(static_cast<ChannelType*>(m_channel.get()), nullptr)) // The cast here won't fail for sure
-	      , m_newsModel(std::make_unique<NewsListModel<ChannelType>>(static_cast<ChannelType*>(m_channel.get()))) // The cast here won't fail for sure
+	      , m_newsModel(std::make_unique<NewsListModel<ChannelType>>(static_cast<ChannelType*>(m_channel.get()), QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/firstscreen.cbor")) // The cast here won't fail for sure
 	      , m_iconsGenerator(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/icons")
+	      , m_journal(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/storednews.dat", QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/storednews.journal")
 	      , m_updateTimer()
+	      , m_checkpointTimer()
+	      , m_lastCheckpoint()
+	      , m_storageQuota()
 	      , m_networkRequestsRunning(false)
 	      , m_lastPNGGenerationIndex(0)
 	      , m_PNGGenerationMap()
@@ -113,33 +162,25 @@ public:
 	      , m_canDecreaseFontSize(false)
 	      , m_initialFontSize(-1.0)
 	      , m_mm(qApp->primaryScreen()->physicalDotsPerInch() / 25.4)
+	      , m_fullyLoaded(false)
+	      , m_firstVisibleNews(-1)
+	      , m_lastVisibleNews(-1)
+	      , m_pendingCompletionRequests()
+	      , m_clearNewsWhenLoaded(false)
+	      , m_unknownFilesDeleted(false)
 	{
 		Q_UNUSED(dummy)
 		Q_UNUSED(dummy2)
 
-		// Reloading data from disk if the storage file exists
-		const QString dataFile = QStandardPaths::locate(QStandardPaths::AppDataLocation, "storednews.dat", QStandardPaths::LocateFile);
-		if (!dataFile.isEmpty()) {
-			QFile file(dataFile);
-			if (file.open(QIODevice::ReadOnly)) {
-				QJsonDocument document = QJsonDocument::fromBinaryData(file.readAll());
-				if (document.isObject()) {
-					if (!m_channel->load(document.object())) {
-						qDebug() << "Error reloading data from" << dataFile << "(Channel::load returned false)";
-					}
-				} else {
-					qDebug() << "Error reloading data from" << dataFile << "(JSon document is not an object)";
-				}
-			} else {
-				qDebug() << "Error reloading data from" << dataFile << "(cannot open file with JSon data)";
-			}
-		} else {
-			qDebug() << "No previous data found";
-		}
-
 		// Connecting signals
 		connect(m_channelUpdater.get(), &ChannelUpdaterType::error, this, &Controller::error);
+		connect(m_newsModel.get(), &AbstractNewsListModel::visibleRangeChanged, this, &Controller::setVisibleNewsRange);
+		connect(m_newsModel.get(), &AbstractNewsListModel::newsCompletionRequested, this, &Controller::requestNewsCompletion);
+		connect(&m_journal, &ChannelJournal::restored, this, &Controller::channelRestored);
 		connect(&m_updateTimer, &QTimer::timeout, this, &Controller::updateNews);
+		connect(m_channelUpdater.get(), &ChannelUpdaterType::updateFinished, this, &Controller::checkpoint);
+		connect(m_channelUpdater.get(), &ChannelUpdaterType::newsCompletionFinished, this, &Controller::checkpoint);
+		connect(&m_checkpointTimer, &QTimer::timeout, this, &Controller::checkpoint);
 		connect(&(NM::instance()), &NetworkManager::networkRequestsStarted, this, &Controller::setNetworkRequestsRunning);
 		connect(&(NM::instance()), &NetworkManager::networkRequestsEnded, this, &Controller::unsetNetworkRequestsRunning);
 		connect(&(NM::instance()), &NetworkManager::networkError, this, &Controller::networkError);
@@ -148,17 +189,14 @@ public:
 		// Starting the thread of the icon generator
 		m_iconsGenerator.start();
 
-		// Now updating news from the net...
-		updateNews();
-
-		// ... and then starting the timer for the news updates
-		setTimerInterval();
-		m_updateTimer.start();
-
 		emit channelChanged();
 		emit newsModelChanged();
 		emit aboutTextChanged();
 		emit mmChanged();
+
+		// Reloading data from disk (the snapshot and the changes in the journal). News are added
+		// in the background, channelRestored() is called when done
+		m_journal.restore(m_channel.get());
 	}
 
 	/**
@@ -221,6 +259,88 @@ public:
 	 */
 	void setKeepNewsForDays(unsigned int keepNewsForDays);
 
+	/**
+	 * \brief Returns the number of news before and after the visible ones
+	 *        that are completed together with visible news
+	 *
+	 * \return the size of the prefetch window for news completion
+	 */
+	int completionPrefetchWindow() const;
+
+	/**
+	 * \brief Sets the number of news before and after the visible ones
+	 *        that are completed together with visible news
+	 *
+	 * \param w the size of the prefetch window for news completion
+	 */
+	void setCompletionPrefetchWindow(int w);
+
+	/**
+	 * \brief Returns the number of minutes between checkpoints
+	 *
+	 * \return the number of minutes between checkpoints
+	 */
+	int checkpointInterval() const;
+
+	/**
+	 * \brief Sets the number of minutes between checkpoints
+	 *
+	 * \param i the number of minutes between checkpoints. Values less than
+	 *          1 are replaced by 1
+	 */
+	void setCheckpointInterval(int i);
+
+	/**
+	 * \brief Returns the maximum size in megabytes of files attached to news
+	 *
+	 * \return the maximum size in megabytes of files attached to news. If 0
+	 *         there is no limit
+	 */
+	int attachedFilesQuota() const;
+
+	/**
+	 * \brief Sets the maximum size in megabytes of files attached to news
+	 *
+	 * \param q the maximum size in megabytes of files attached to news. If
+	 *          0 there is no limit
+	 */
+	void setAttachedFilesQuota(int q);
+
+	/**
+	 * \brief Returns the maximum size in megabytes of files downloaded on
+	 *        request of the user
+	 *
+	 * \return the maximum size in megabytes of downloaded files. If 0 there
+	 *         is no limit
+	 */
+	int downloadedFilesQuota() const;
+
+	/**
+	 * \brief Sets the maximum size in megabytes of files downloaded on
+	 *        request of the user
+	 *
+	 * \param q the maximum size in megabytes of downloaded files. If 0
+	 *          there is no limit
+	 */
+	void setDownloadedFilesQuota(int q);
+
+	/**
+	 * \brief Returns the size in megabytes of files attached to news
+	 *
+	 * This is the value computed by the last check of quotas
+	 * \return the size in megabytes of files attached to news
+	 */
+	qreal attachedFilesSize() const;
+
+	/**
+	 * \brief Returns the size in megabytes of files downloaded on request
+	 *        of the user
+	 *
+	 * This is the value computed by the last check of quotas
+	 * \return the size in megabytes of downloaded files
+	 */
+	qreal downloadedFilesSize() const;
+
 	/**
 	 * \brief Returns true if there are network requests running
 	 *
@@ -320,6 +440,16 @@ public:
 		return m_mm;
 	}
 
+	/**
+	 * \brief Returns true if all stored news have been loaded
+	 *
+	 * \return true if all stored news have been loaded
+	 */
+	bool fullyLoaded() const
+	{
+		return m_fullyLoaded;
+	}
+
 signals:
 	/**
 	 * \brief The signal emitted when there is a network error
@@ -348,6 +478,32 @@ signals:
 	 */
 	void keepNewsForDaysChanged();
 
+	/**
+	 * \brief The signal emitted when completionPrefetchWindow changes
+	 */
+	void completionPrefetchWindowChanged();
+
+	/**
+	 * \brief The signal emitted when checkpointInterval changes
+	 */
+	void checkpointIntervalChanged();
+
+	/**
+	 * \brief The signal emitted when attachedFilesQuota changes
+	 */
+	void attachedFilesQuotaChanged();
+
+	/**
+	 * \brief The signal emitted when downloadedFilesQuota changes
+	 */
+	void downloadedFilesQuotaChanged();
+
+	/**
+	 * \brief The signal emitted when the size of files of news has been
+	 *        computed again
+	 */
+	void storageUsageChanged();
+
 	/**
 	 * \brief The signal emitted when the networkRequestsRunning property
 	 *        changes
@@ -379,6 +535,11 @@ signals:
 	 */
 	void mmChanged();
 
+	/**
+	 * \brief The signal emitted when all stored news have been loaded
+	 */
+	void fullyLoadedChanged();
+
 public slots:
 	/**
 	 * \brief Updates news from the net
@@ -452,6 +613,17 @@ public slots:
 	 */
 	QObject* getNewsForURL(QString newsUrl);
 
+	/**
+	 * \brief Records that the user accessed a news
+	 *
+	 * This should be called from QML when a news is opened or its media is
+	 * played. The files of news accessed least recently are the first to
+	 * be removed when quotas are exceeded. Accesses before all stored news
+	 * have been loaded are ignored
+	 * \param newsUrl the url of the news
+	 */
+	void newsAccessed(QString newsUrl);
+
 	/**
 	 * \brief The function to call when the user comes back to the list of
 	 *        news
@@ -487,12 +659,91 @@ private slots:
 	 */
 	void iconGenerated(unsigned int index, QString filename);
 
+	/**
+	 * \brief Writes a checkpoint if the channel changed since the last one
+	 *
+	 * The channel is serialized here and the snapshot is rewritten, and
+	 * the journal emptied, in the thread of the journal. This only happens
+	 * if checkpointInterval minutes have elapsed since the last checkpoint
+	 * or if the journal is too large, so that the main thread doesn't
+	 * serialize the channel after every update or batch of completed news.
+	 * The first screen of the model is also saved here if it changed
+	 */
+	void checkpoint();
+
+	/**
+	 * \brief Starts checking the size of files of news against quotas
+	 *
+	 * This does nothing if a check is already running. Files are removed
+	 * when the check finishes (see evictFiles())
+	 */
+	void enforceStorageQuotas();
+
+	/**
+	 * \brief The slot called when the channel has been restored from disk
+	 *
+	 * This starts journaling changes, updates from the net and the
+	 * completion of news
+	 * \param dataFound whether stored data was found
+	 */
+	void channelRestored(bool dataFound);
+
+	/**
+	 * \brief The slot called when the range of visible news changes
+	 *
+	 * The range is forwarded to the channel updater once the channel has
+	 * been restored
+	 * \param firstIndex the index of the first visible news
+	 * \param lastIndex the index of the last visible news
+	 */
+	void setVisibleNewsRange(int firstIndex, int lastIndex);
+
+	/**
+	 * \brief The slot called when the completion of a news is requested
+	 *
+	 * Requests are forwarded to the channel updater once the channel has
+	 * been restored
+	 * \param index the index of the news
+	 */
+	void requestNewsCompletion(int index);
+
 private:
 	/**
 	 * \brief Sets the interval of the timer to the value of ttl
 	 */
 	void setTimerInterval();
 
+	/**
+	 * \brief Returns true if files of the news can be removed to respect
+	 *        quotas
+	 *
+	 * Files of news that are visible (or near the visible ones) or that
+	 * have been accessed recently are never removed
+	 * \param index the index of the news
+	 * \param now the current time in milliseconds since the epoch
+	 * \return true if files of the news can be removed
+	 */
+	bool canEvictFiles(int index, qint64 now) const;
+
+	/**
+	 * \brief Returns the time the news was last accessed
+	 *
+	 * If the news has never been accessed, its publication date is used
+	 * \param index the index of the news
+	 * \return the time the news was last accessed in milliseconds since the
+	 *         epoch
+	 */
+	qint64 lastAccess(int index) const;
+
+	/**
+	 * \brief Removes the files chosen by a check of quotas
+	 *
+	 * News that have been accessed or became visible in the meantime are
+	 * skipped
+	 * \param evictions the files to remove
+	 */
+	void evictFiles(const QList<StorageQuota::Eviction>& evictions);
+
 	/**
 	 * \brief The path of the file with text for the about page
 	 */
@@ -541,11 +792,35 @@ private:
 	 */
 	IconsGenerator m_iconsGenerator;
 
+	/**
+	 * \brief The object storing the channel on disk
+	 *
+	 * Changes to the channel are written in a separate thread
+	 */
+	ChannelJournal m_journal;
+
 	/**
 	 * \brief The timer for the automatic update
 	 */
 	QTimer m_updateTimer;
 
+	/**
+	 * \brief The timer for periodic checkpoints
+	 */
+	QTimer m_checkpointTimer;
+
+	/**
+	 * \brief The timer measuring the time since the last checkpoint
+	 *
+	 * This is invalid until the first checkpoint
+	 */
+	QElapsedTimer m_lastCheckpoint;
+
+	/**
+	 * \brief The object choosing files to remove to respect quotas
+	 */
+	StorageQuota m_storageQuota;
+
 	/**
 	 * \brief This is true if any network request is running
 	 */
@@ -592,6 +867,44 @@ private:
 	 * absolute lengths of items
 	 */
 	const qreal m_mm;
+
+	/**
+	 * \brief True when all stored news have been loaded
+	 */
+	bool m_fullyLoaded;
+
+	/**
+	 * \brief The index of the first visible news
+	 *
+	 * This is -1 if the range of visible news is unknown
+	 */
+	int m_firstVisibleNews;
+
+	/**
+	 * \brief The index of the last visible news
+	 *
+	 * This is -1 if the range of visible news is unknown
+	 */
+	int m_lastVisibleNews;
+
+	/**
+	 * \brief The ids of news whose completion was requested while loading
+	 *
+	 * Ids are used because indexes change while news are added
+	 */
+	QList<unsigned int> m_pendingCompletionRequests;
+
+	/**
+	 * \brief If true all news are removed as soon as the channel has been
+	 *        restored
+	 */
+	bool m_clearNewsWhenLoaded;
+
+	/**
+	 * \brief True if unknown files have already been removed in this
+	 *        execution
+	 */
+	bool m_unknownFilesDeleted;
 };
 
 #endif
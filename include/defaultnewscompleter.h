@@ -82,6 +82,35 @@ public:
 		m_workFinishedCallback();
 	}
 
+	/**
+	 * \brief Aborts completion
+	 *
+	 * Completion is synchronous, so there is nothing to do here
+	 */
+	void abort()
+	{
+	}
+
+	/**
+	 * \brief Returns true if the news was completed successfully
+	 *
+	 * \return always true
+	 */
+	bool succeeded() const
+	{
+		return true;
+	}
+
+	/**
+	 * \brief Returns true if completion failed because of a network error
+	 *
+	 * \return always false
+	 */
+	bool networkFailure() const
+	{
+		return false;
+	}
+
 private:
 	/**
 	 * \brief The news to complete
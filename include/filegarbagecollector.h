@@ -0,0 +1,166 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __FILE_GARBAGE_COLLECTOR_H__
+#define __FILE_GARBAGE_COLLECTOR_H__
+
+#include <QThread>
+#include <QString>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QDirIterator>
+#include <memory>
+
+/**
+ * \brief The class removing unknown files of the channel in a separate thread
+ *
+ * This class removes the files in a directory that are not known (e.g. files
+ * left behind when the application was killed), see sweep(). Known files are
+ * removed by the FileWriter, so that their removal is ordered with pending
+ * writes. The sweep is done in slices: each slice lasts a few milliseconds and
+ * then the thread pauses, so that the sweep only uses the disk when nothing
+ * else does. Files whose name starts with a number not less than the file
+ * creation index given to sweep() are never removed: they have been created
+ * after the list of known files was taken. Files ending with ".part" are kept
+ * if the file without the suffix is known (they are being downloaded). The
+ * thread is started the first time a sweep is requested, stop() and wait()
+ * should be called before the object is destroyed: an unfinished sweep is
+ * abandoned
+ */
+class FileGarbageCollector : public QThread
+{
+	Q_OBJECT
+
+public:
+	/**
+	 * \brief Constructor
+	 */
+	FileGarbageCollector();
+
+	/**
+	 * \brief Destructor
+	 */
+	virtual ~FileGarbageCollector();
+
+	/**
+	 * \brief Starts removing unknown files in a directory
+	 *
+	 * Sub-directories are not taken into account. If a sweep is already
+	 * running it is restarted with the new data
+	 * \param dir the directory to sweep
+	 * \param filesToKeep the absolute paths of the known files
+	 * \param fileCreationIndex the number used for the next file that will
+	 *                          be created in the directory. Files from this
+	 *                          number on are kept
+	 */
+	void sweep(QString dir, QSet<QString> filesToKeep, int fileCreationIndex);
+
+	/**
+	 * \brief Asks the thread to stop
+	 */
+	void stop();
+
+private:
+	/**
+	 * \brief The structure with data of a sweep
+	 */
+	struct Sweep {
+		/**
+		 * \brief The directory to sweep
+		 */
+		QString dir;
+
+		/**
+		 * \brief The files to keep
+		 */
+		QSet<QString> filesToKeep;
+
+		/**
+		 * \brief The file creation index when the sweep was requested
+		 */
+		int fileCreationIndex;
+	};
+
+	/**
+	 * \brief The function doing the actual work
+	 */
+	virtual void run();
+
+	/**
+	 * \brief Starts the thread if it is not running
+	 *
+	 * The mutex must be locked
+	 */
+	void startIfNeeded();
+
+	/**
+	 * \brief Checks the next entries of the directory being swept
+	 *
+	 * \return true if the sweep has finished
+	 */
+	bool sweepSlice();
+
+	/**
+	 * \brief Returns true if the file has to be kept
+	 *
+	 * \param fileName the name of the file (without the directory)
+	 * \return true if the file has to be kept
+	 */
+	bool keepFile(const QString& fileName) const;
+
+	/**
+	 * \brief The sweep requested and not started yet
+	 *
+	 * This is protected by m_mutex
+	 */
+	std::unique_ptr<Sweep> m_requestedSweep;
+
+	/**
+	 * \brief The sweep in progress
+	 *
+	 * This is only used by the thread of this class
+	 */
+	std::unique_ptr<Sweep> m_sweep;
+
+	/**
+	 * \brief The iterator on the directory being swept
+	 *
+	 * This is only used by the thread of this class
+	 */
+	std::unique_ptr<QDirIterator> m_sweepIterator;
+
+	/**
+	 * \brief This is set to true when the thread must stop
+	 */
+	bool m_stop;
+
+	/**
+	 * \brief The mutex protecting access to member across threads
+	 */
+	QMutex m_mutex;
+
+	/**
+	 * \brief The wait condition on which the worker thread waits for work
+	 */
+	QWaitCondition m_waitCondition;
+};
+
+#endif
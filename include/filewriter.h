@@ -0,0 +1,241 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __FILE_WRITER_H__
+#define __FILE_WRITER_H__
+
+#include <QThread>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <functional>
+#include <map>
+#include <memory>
+#include "include/utilities.h"
+
+/**
+ * \brief The class writing files in a separate thread
+ *
+ * All operations are enqueued and executed in order by the thread of this
+ * class, so that slow storage never blocks the user interface. Whole files are
+ * written with writeFile(), which replaces the file atomically. Files whose
+ * data arrives a piece at a time (e.g. downloads) are written as streams:
+ * openStream() creates the file, appendToStream() enqueues data (consecutive
+ * pieces for the same stream are merged in a single write) and closeStream()
+ * closes it, optionally syncing it to disk and renaming it. Callbacks are
+ * always called in the main thread (using a CommandEvent) after the operation
+ * has been executed. The thread is started the first time something is
+ * enqueued. When the object is destroyed everything in the queue is executed
+ * and streams still open are closed. Use the FW singleton to access the
+ * instance shared by the application
+ */
+class FileWriter : public QThread
+{
+	Q_OBJECT
+
+public:
+	/**
+	 * \brief Constructor
+	 */
+	FileWriter();
+
+	/**
+	 * \brief Destructor
+	 *
+	 * This waits for the queue to be executed
+	 */
+	virtual ~FileWriter();
+
+	/**
+	 * \brief Enqueues the writing of a whole file
+	 *
+	 * The file is replaced only when all data has been written (see
+	 * QSaveFile)
+	 * \param path the path of the file
+	 * \param data the content of the file
+	 * \param callback the function to call when done. The parameter is
+	 *                 false in case of error
+	 */
+	void writeFile(QString path, QByteArray data, std::function<void(bool)> callback = std::function<void(bool)>());
+
+	/**
+	 * \brief Enqueues the removal of a file
+	 *
+	 * \param path the path of the file
+	 */
+	void removeFile(QString path);
+
+	/**
+	 * \brief Enqueues the removal of a list of files
+	 *
+	 * \param paths the paths of the files
+	 */
+	void removeFiles(const QStringList& paths);
+
+	/**
+	 * \brief Enqueues the creation of a stream
+	 *
+	 * The file is created or truncated
+	 * \param path the path of the file
+	 * \param callback the function to call when the file has been opened.
+	 *                 The parameter is false in case of error (in that
+	 *                 case data appended to the stream is discarded)
+	 * \return the id of the stream
+	 */
+	int openStream(QString path, std::function<void(bool)> callback = std::function<void(bool)>());
+
+	/**
+	 * \brief Enqueues data to append to a stream
+	 *
+	 * \param stream the id of the stream
+	 * \param data the data to append
+	 */
+	void appendToStream(int stream, const QByteArray& data);
+
+	/**
+	 * \brief Enqueues the closing of a stream
+	 *
+	 * \param stream the id of the stream
+	 * \param renameTo if not empty, the file is synced to disk and renamed
+	 *                 to this path (replacing the file if it exists)
+	 * \param callback the function to call when done. The parameter is
+	 *                 false in case of error
+	 */
+	void closeStream(int stream, QString renameTo = QString(), std::function<void(bool)> callback = std::function<void(bool)>());
+
+	/**
+	 * \brief Calls a function when everything enqueued so far has been
+	 *        executed
+	 *
+	 * \param callback the function to call
+	 */
+	void whenWritten(std::function<void()> callback);
+
+private:
+	/**
+	 * \brief The type of jobs
+	 */
+	enum class JobType {
+		WriteFile,
+		RemoveFile,
+		OpenStream,
+		AppendToStream,
+		CloseStream,
+		Barrier
+	};
+
+	/**
+	 * \brief The structure with a job for the writing thread
+	 */
+	struct Job {
+		/**
+		 * \brief The type of job
+		 */
+		JobType type;
+
+		/**
+		 * \brief The id of the stream
+		 *
+		 * Only used for jobs on streams
+		 */
+		int stream;
+
+		/**
+		 * \brief The path of the file
+		 *
+		 * For CloseStream this is the path to rename the file to
+		 */
+		QString path;
+
+		/**
+		 * \brief The data to write
+		 */
+		QByteArray data;
+
+		/**
+		 * \brief The function to call when done
+		 */
+		std::function<void(bool)> callback;
+	};
+
+	/**
+	 * \brief The function doing the actual work
+	 */
+	virtual void run();
+
+	/**
+	 * \brief Enqueues a job
+	 *
+	 * The mutex must be locked. This also starts the thread, if needed
+	 * \param job the job to enqueue
+	 */
+	void enqueue(Job&& job);
+
+	/**
+	 * \brief Executes a job
+	 *
+	 * \param job the job to execute
+	 * \return false in case of error
+	 */
+	bool execute(const Job& job);
+
+	/**
+	 * \brief The queue of jobs
+	 */
+	QList<Job> m_jobs;
+
+	/**
+	 * \brief The open streams
+	 *
+	 * This is only used by the thread of this class
+	 */
+	std::map<int, std::unique_ptr<QFile>> m_streams;
+
+	/**
+	 * \brief The id of the next stream
+	 */
+	int m_nextStream;
+
+	/**
+	 * \brief This is set to true when the thread must stop
+	 */
+	bool m_stop;
+
+	/**
+	 * \brief The mutex protecting access to member across threads
+	 */
+	QMutex m_mutex;
+
+	/**
+	 * \brief The wait condition on which the worker thread waits for jobs
+	 */
+	QWaitCondition m_waitCondition;
+};
+
+/**
+ * \brief The singleton to access the FileWriter
+ */
+using FW = Singleton<FileWriter>;
+
+#endif
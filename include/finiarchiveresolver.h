@@ -0,0 +1,213 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __FINI_ARCHIVE_RESOLVER_H__
+#define __FINI_ARCHIVE_RESOLVER_H__
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QUrl>
+#include <QRegularExpression>
+#include <functional>
+#include "include/dataavailablenotifee.h"
+#include "include/utilities.h"
+
+/**
+ * \brief The class resolving the page of the archive with the full editorial
+ *        of Massimo Fini
+ *
+ * Editorials of Massimo Fini are not in the page linked by the rss, which only
+ * contains a link to the page of the archive with the full text. This class
+ * avoids downloading the page linked by the rss just to find that link. It
+ * keeps a persistent map (stored with QSettings) from the url of the article to
+ * the url of the archive page. Moreover it can download the index of the
+ * archive, which lists many editorials, and use it to resolve articles by
+ * title. The index is downloaded at most once per refresh: call
+ * invalidateArchiveIndex() when news are refreshed, it is downloaded again the
+ * first time it is needed. Use the FiniResolver alias to access the unique
+ * instance of this class
+ * \warning This class is not thread-safe nor reentrant
+ */
+class FiniArchiveResolver : private AllDataArrivedNotifee
+{
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * This reads the stored map from article urls to archive urls
+	 */
+	FiniArchiveResolver();
+
+	/**
+	 * \brief Destructor
+	 */
+	virtual ~FiniArchiveResolver();
+
+	/**
+	 * \brief Returns the url of the archive page for the article with the
+	 *        given url
+	 *
+	 * \param articleUrl the url of the article (i.e. the link in the rss)
+	 * \return the url of the archive page or an invalid url if not known
+	 */
+	QUrl archiveUrlForArticle(const QUrl& articleUrl) const;
+
+	/**
+	 * \brief Stores the url of the archive page for the article with the
+	 *        given url
+	 *
+	 * \param articleUrl the url of the article (i.e. the link in the rss)
+	 * \param archiveUrl the url of the archive page. If invalid, the
+	 *                   association is removed
+	 */
+	void setArchiveUrlForArticle(const QUrl& articleUrl, const QUrl& archiveUrl);
+
+	/**
+	 * \brief Resolves the url of the archive page using the archive index
+	 *
+	 * If the index has already been downloaded, the callback is called
+	 * immediately, otherwise it is called when the index has been
+	 * downloaded. The callback is called with an invalid url if the
+	 * article could not be found. Call cancel() with the same id if the
+	 * callback must not be called anymore
+	 * \param id the id of the request (e.g. the news id). Only one request
+	 *           for each id can be pending
+	 * \param title the title of the article
+	 * \param articleUrl the url of the article (i.e. the link in the rss)
+	 * \param callback the function to call with the url of the archive page
+	 */
+	void resolve(unsigned int id, const QString& title, const QUrl& articleUrl, const std::function<void(QUrl)>& callback);
+
+	/**
+	 * \brief Cancels a pending request
+	 *
+	 * Does nothing if there is no pending request with the given id
+	 * \param id the id of the request
+	 */
+	void cancel(unsigned int id);
+
+	/**
+	 * \brief Marks the archive index as outdated
+	 *
+	 * The index is downloaded again the next time it is needed
+	 */
+	void invalidateArchiveIndex();
+
+private:
+	/**
+	 * \brief The function called when all data has been received
+	 *
+	 * \param id the request ID
+	 * \param data the data that has just arrived
+	 */
+	virtual void allDataArrived(int id, const QByteArray& data) override;
+
+	/**
+	 * \brief The function called after the request is completed
+	 *
+	 * Here we call the callbacks of pending requests, both in case of
+	 * success and in case of network errors
+	 * \param id the ID of the request that has finished
+	 */
+	virtual void requestCompleted(int id) override;
+
+	/**
+	 * \brief Returns the key used to match titles
+	 *
+	 * \param title the title (can contain html entities)
+	 * \return a lowercase version of the title with only letters and digits
+	 */
+	static QString titleKey(const QString& title);
+
+	/**
+	 * \brief Stores the map from article urls to archive urls
+	 */
+	void save() const;
+
+	/**
+	 * \brief The map from article urls to archive urls
+	 */
+	QHash<QUrl, QUrl> m_archiveUrls;
+
+	/**
+	 * \brief The possible states of the archive index
+	 */
+	enum class IndexStatus {
+		NotDownloaded, /// The index has to be downloaded
+		Downloading, /// We are downloading the index
+		Downloaded /// The index has been downloaded (possibly with
+			   /// errors)
+	};
+
+	/**
+	 * \brief The current state of the archive index
+	 */
+	IndexStatus m_indexStatus;
+
+	/**
+	 * \brief The archive index, the map from the title key to the url of
+	 *        the archive page
+	 */
+	QHash<QString, QUrl> m_archiveIndex;
+
+	/**
+	 * \brief The structure with a request waiting for the archive index
+	 */
+	struct PendingRequest {
+		/**
+		 * \brief The id of the request
+		 */
+		unsigned int id;
+
+		/**
+		 * \brief The title key of the article
+		 */
+		QString titleKey;
+
+		/**
+		 * \brief The url of the article
+		 */
+		QUrl articleUrl;
+
+		/**
+		 * \brief The callback to call with the result
+		 */
+		std::function<void(QUrl)> callback;
+	};
+
+	/**
+	 * \brief The requests waiting for the archive index
+	 */
+	QList<PendingRequest> m_pendingRequests;
+
+	/**
+	 * \brief The regular expression to find links to the archive in the
+	 *        archive index
+	 */
+	static const QRegularExpression m_archiveLinkRE;
+};
+
+/**
+ * \brief A simple alias to access the unique FiniArchiveResolver instance
+ */
+using FiniResolver = Singleton<FiniArchiveResolver>;
+
+#endif
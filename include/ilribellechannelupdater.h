@@ -30,4 +30,12 @@
  */
 using IlRibelleChannelUpdater = ChannelUpdater<IlRibelleChannel, DefaultChannelCompleter, IlRibelleNewsCompleter>;
 
+/**
+ * \brief The channel updater for www.ilribelle.com using the JSON
+ *        representation of Squarespace pages
+ *
+ * This falls back to scraping html pages when JSON is not available
+ */
+using IlRibelleJsonChannelUpdater = ChannelUpdater<IlRibelleChannel, DefaultChannelCompleter, IlRibelleJsonNewsCompleter>;
+
 #endif
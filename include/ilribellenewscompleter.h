@@ -24,6 +24,8 @@
 #include "include/dataavailablenotifee.h"
 #include "include/ilribellechannel.h"
 #include <QRegularExpression>
+#include <QJsonObject>
+#include <memory>
 
 /**
  * \brief The class completing a news from www.ilribelle.com
@@ -32,7 +34,13 @@
  * the url stored in a news, gets the webpage and completes the news. This
  * respects all the requisites of a news completer (see the description of the
  * DefaultNewsCompleter class for the list of requisites). This class downloads
- * only one file at a time
+ * only one file at a time. If the page of the news cannot be downloaded the
+ * completion fails and the news is not set as complete (errors downloading
+ * images or the raz24 page are not considered failures). For editorials of
+ * Massimo Fini the page in the archive with the full text is downloaded
+ * directly when its url can be found using FiniArchiveResolver. Images are
+ * written by the FileWriter thread, the news is set as complete once they are
+ * on disk
  * \warning This class is not thread-safe nor reentrant
  */
 class IlRibelleNewsCompleter : private AllDataArrivedNotifee
@@ -61,6 +69,48 @@ public:
 	 */
 	void start();
 
+	/**
+	 * \brief Aborts completion
+	 *
+	 * The current request is interrupted and the callback is not called
+	 * anymore
+	 */
+	void abort();
+
+	/**
+	 * \brief Returns true if the news was completed successfully
+	 *
+	 * \return true if the news was completed successfully
+	 */
+	bool succeeded() const
+	{
+		return !m_failed;
+	}
+
+	/**
+	 * \brief Returns true if completion failed because of a network error
+	 *
+	 * \return true if completion failed because of a network error
+	 */
+	bool networkFailure() const
+	{
+		return m_networkFailure;
+	}
+
+protected:
+	/**
+	 * \brief Constructor
+	 *
+	 * \param channel the channel containing the news to complete
+	 * \param news the news to complete
+	 * \param workFinishedCallback the functor called when this has finished
+	 *                             its work
+	 * \param useJson if true the JSON representation of pages is used
+	 *                instead of scraping html pages (see
+	 *                IlRibelleJsonNewsCompleter)
+	 */
+	IlRibelleNewsCompleter(IlRibelleChannel* channel, IlRibelleNews* news, const std::function<void()>& workFinishedCallback, bool useJson);
+
 private:
 	/**
 	 * \brief The function called when all data has been received
@@ -90,11 +140,56 @@ private:
 	/**
 	 * \brief Call this function when the news is complete
 	 *
-	 * This sets the news to the completed status and commits suicide
-	 * calling deleteLater()
+	 * This waits for images to be written, then sets the news to the
+	 * completed status and calls the callback
 	 */
 	void newsCompleted();
 
+	/**
+	 * \brief Call this function when the news could not be completed
+	 *
+	 * This calls the callback without setting the news as complete
+	 */
+	void newsFailed();
+
+	/**
+	 * \brief The function called when the url of the page in the archive
+	 *        of Massimo Fini is known
+	 *
+	 * \param url the url of the page in the archive or an invalid url if
+	 *            it could not be found
+	 */
+	void finiPageResolved(QUrl url);
+
+	/**
+	 * \brief Starts downloading the page of the news
+	 *
+	 * If we use JSON, the item is first looked for in the collection of
+	 * the news, otherwise the html page linked by the rss is downloaded
+	 */
+	void downloadNewsPage();
+
+	/**
+	 * \brief The function called when the item of the news has been looked
+	 *        for in its collection
+	 *
+	 * \param item the JSON item of the news or an empty object if it could
+	 *             not be found
+	 */
+	void jsonItemFound(QJsonObject item);
+
+	/**
+	 * \brief Processes the body of the news
+	 *
+	 * If the news is from Massimo Fini and we are processing the page
+	 * linked by the rss, a request for the page with the full news is
+	 * prepared. Otherwise the news description is set and the download of
+	 * images and the raz24 page is prepared
+	 * \param newsBody the html of the body of the news
+	 * \return true if there is another request to do, false otherwise
+	 */
+	bool processNewsBody(const QString& newsBody);
+
 	/**
 	 * \brief Parses the data received for the news
 	 *
@@ -175,12 +270,24 @@ private:
 	 */
 	std::function<void()> m_workFinishedCallback;
 
+	/**
+	 * \brief If true we use the JSON representation of pages
+	 */
+	const bool m_useJson;
+
 	/**
 	 * brief The enum with the possible states of news to complete
 	 */
 	enum class NewsStatus {
 		NotStarted, /// The process of completing the news hasn't
 			    /// started yet
+		ResolveFiniPage, /// This could be a news from Massimo Fini,
+				 /// we are looking for the page in the
+				 /// archive with the actual news
+		LookupJsonCollection, /// We are looking for the item of the
+				      /// news in its Squarespace collection
+		DownloadJsonItem, /// We are downloading the JSON of the news
+				  /// page
 		DownloadMainPage, /// The page of the news has to be downloaded
 		DownloadFiniPage, /// This is a news from Massimo Fini, we have
 				  /// to download the page with the actual news
@@ -194,6 +301,14 @@ private:
 	 */
 	NewsStatus m_newsState;
 
+	/**
+	 * \brief Changes state and downloads a page
+	 *
+	 * \param state the new state
+	 * \param url the url of the page to download
+	 */
+	void downloadPage(NewsStatus state, const QUrl& url);
+
 	/**
 	 * \brief the next request to do for the news
 	 */
@@ -220,6 +335,34 @@ private:
 	 */
 	QUrl m_raz24Page;
 
+	/**
+	 * \brief True after the callback has been called
+	 */
+	bool m_finished;
+
+	/**
+	 * \brief True if completion failed
+	 */
+	bool m_failed;
+
+	/**
+	 * \brief True if completion failed because of a network error
+	 */
+	bool m_networkFailure;
+
+	/**
+	 * \brief True if abort() has been called
+	 */
+	bool m_aborted;
+
+	/**
+	 * \brief Set to false when this object is destroyed
+	 *
+	 * Functions called by the FileWriter check this before using the
+	 * object
+	 */
+	std::shared_ptr<bool> m_alive;
+
 	/**
 	 * \brief The regular expression to check if a page contains a partial
 	 *        article from Massimo Fini
@@ -291,4 +434,35 @@ private:
 	static const QRegularExpression m_iframeUrlRE;
 };
 
+/**
+ * \brief The class completing a news from www.ilribelle.com using the JSON
+ *        representation of Squarespace pages
+ *
+ * www.ilribelle.com and raz24 are Squarespace sites, which return a JSON
+ * representation of pages when "format=json" is added to the url. This news
+ * completer takes the body of the news from the JSON of its collection, which
+ * is downloaded once for many news (see SquarespaceJsonCache). If the news is
+ * not in the collection, the JSON of the news page is downloaded. If that also
+ * fails, the html page is scraped as IlRibelleNewsCompleter does. The raz24
+ * page is also downloaded as JSON and audio information is taken from the body
+ * of the item. Select this class or IlRibelleNewsCompleter as the NewsCompleter
+ * of the ChannelUpdater (see ilribellechannelupdater.h)
+ */
+class IlRibelleJsonNewsCompleter : public IlRibelleNewsCompleter
+{
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * \param channel the channel containing the news to complete
+	 * \param news the news to complete
+	 * \param workFinishedCallback the functor called when this has finished
+	 *                             its work
+	 */
+	IlRibelleJsonNewsCompleter(IlRibelleChannel* channel, IlRibelleNews* news, const std::function<void()>& workFinishedCallback)
+		: IlRibelleNewsCompleter(channel, news, workFinishedCallback, true)
+	{
+	}
+};
+
 #endif
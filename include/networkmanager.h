@@ -207,6 +207,17 @@ public:
 	 */
 	bool getFile(QUrl url, DataAvailableNotifee* notifee, int id);
 
+	/**
+	 * \brief Returns true if the active connection is not metered
+	 *
+	 * On Android the system is asked (this needs the
+	 * ACCESS_NETWORK_STATE permission), on desktop connections are always
+	 * considered unmetered. This is used to decide whether downloading data
+	 * the user has not requested yet is acceptable
+	 * \return true if the active connection is not metered
+	 */
+	bool isConnectionUnmetered() const;
+
 signals:
 	/**
 	 * \brief The sigal emitted when there are network errors
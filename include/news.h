@@ -34,6 +34,8 @@
 #include <type_traits>
 #include "include/utilities.h"
 #include "include/standardroles.h"
+#include "include/newssortkey.h"
+#include "include/rolescbor.h"
 
 /**
  * \brief The class modelling a single news
@@ -49,15 +51,20 @@
  * disk. This class also stores the URL of the QML Item that is used to show the
  * news and a flag signalling if the news is complete (i.e. all data relative to
  * the news has been downloaded and the news is ready to be read) or not. Data
- * is stored using a list of QVariant, instead of having separated fields of the
- * native type. This is so because the model we use to communicate with the GUI
- * uses roles (i.e. indexes in a list of QVariants) to request data. This class
- * also has functions to serialize data as a JSON object (which is easy to store
- * and fast to encode/decode). Finally, each news has an unsigned integer id
- * that is set in the constructor and cannot be changed. It should be unique,
- * meaning that during program execution no two news should have the same id (it
- * is not stored, though, so the same news can have different ids in different
- * executions)
+ * of each role is stored with its native type. The model we use to communicate
+ * with the GUI uses roles (i.e. indexes) to request data as QVariants, which
+ * are only built when requested. This class also has functions to serialize
+ * data as a CBOR map, written and read directly from the roles (see RolesCbor),
+ * and to read the JSON objects used by older versions. Finally, each news has
+ * an unsigned integer id that is set in the constructor and cannot be changed.
+ * It should be unique, meaning that during program execution no two news should
+ * have the same id (it is not stored, though, so the same news can have
+ * different ids in different executions). News are ordered by publication date
+ * and title: the key used for comparisons (see NewsSortKey) is cached and
+ * refreshed when the pubDate or title roles are set (before observers are
+ * notified). Changes made without calling callbacks (e.g. with
+ * copyDataFromOtherRolesList() or ignoring callbacks) require an explicit call
+ * to refreshSortKey()
  */
 template <class RolesListType>
 class News : public Roles<RolesListType>
@@ -74,6 +81,7 @@ public:
 	News(unsigned int id)
 		: Roles<RolesListType>()
 		, m_id(id)
+		, m_sortKey()
 	{
 	}
 
@@ -84,6 +92,7 @@ public:
 	 */
 	News(const News<RolesListType>& other)
 		: Roles<RolesListType>(other)
+		, m_sortKey(other.m_sortKey)
 	{
 	}
 
@@ -94,6 +103,7 @@ public:
 	 */
 	News(News<RolesListType>&& other)
 		: Roles<RolesListType>(std::move(other))
+		, m_sortKey(std::move(other.m_sortKey))
 	{
 	}
 
@@ -114,11 +124,7 @@ public:
 	 */
 	bool operator==(const News<RolesListType>& other) const
 	{
-		const auto& thisPubDate = this->template getData<NewsRoles::pubDate>();
-		const auto& otherPubDate = other.template getData<NewsRoles::pubDate>();
-		const auto& thisTitle = this->template getData<NewsRoles::title>();
-		const auto& otherTitle = other.template getData<NewsRoles::title>();
-		return (thisPubDate == otherPubDate) && (thisTitle == otherTitle);
+		return m_sortKey == other.m_sortKey;
 	}
 
 	/**
@@ -142,12 +148,7 @@ public:
 	 */
 	bool operator<(const News<RolesListType>& other) const
 	{
-		const auto& thisPubDate = this->template getData<NewsRoles::pubDate>();
-		const auto& otherPubDate = other.template getData<NewsRoles::pubDate>();
-		const auto& thisTitle = this->template getData<NewsRoles::title>();
-		const auto& otherTitle = other.template getData<NewsRoles::title>();
-		return (thisPubDate < otherPubDate) ||
-		       ((thisPubDate == otherPubDate) && (thisTitle < otherTitle));
+		return m_sortKey < other.m_sortKey;
 	}
 
 	/**
@@ -155,16 +156,32 @@ public:
 	 *
 	 * First the publication dates are compared, then, if they are the same,
 	 * the titles are compared
-	 * \return true if this news is greater than tnewshe other
+	 * \return true if this news is greater than the other
 	 */
 	bool operator>(const News<RolesListType>& other) const
 	{
-		const auto& thisPubDate = this->template getData<NewsRoles::pubDate>();
-		const auto& otherPubDate = other.template getData<NewsRoles::pubDate>();
-		const auto& thisTitle = this->template getData<NewsRoles::title>();
-		const auto& otherTitle = other.template getData<NewsRoles::title>();
-		return (thisPubDate > otherPubDate) ||
-		       ((thisPubDate == otherPubDate) && (thisTitle > otherTitle));
+		return m_sortKey > other.m_sortKey;
+	}
+
+	/**
+	 * \brief Returns the key used to order news
+	 *
+	 * \return the key used to order news
+	 */
+	const NewsSortKey& sortKey() const
+	{
+		return m_sortKey;
+	}
+
+	/**
+	 * \brief Computes again the key used to order news
+	 *
+	 * This is called automatically when the pubDate or title roles are set
+	 * (unless callbacks are ignored) and when the news is reset or loaded
+	 */
+	void refreshSortKey()
+	{
+		m_sortKey = NewsSortKey(this->template getData<NewsRoles::pubDate>(), this->template getData<NewsRoles::title>());
 	}
 
 	/**
@@ -172,7 +189,7 @@ public:
 	 *
 	 * \return the news id
 	 */
-	unsigned int id()
+	unsigned int id() const
 	{
 		return m_id;
 	}
@@ -185,12 +202,15 @@ public:
 	void reset()
 	{
 		this->Roles<RolesListType>::reset(true);
+
+		refreshSortKey();
 	}
 
 	/**
 	 * \brief Reads the news from a JSON object
 	 *
-	 * This resets the news before reading
+	 * This reads the format used by older versions and resets the news
+	 * before reading
 	 * \param obj the JSON object from which we read
 	 * \return false in case of error, true if the news was read correctly
 	 */
@@ -200,34 +220,65 @@ public:
 
 		// Iterating the JSON object and converting key to a Role. If conversion fails, returning false
 		for (auto it = obj.constBegin(); it != obj.constEnd(); ++it) {
-			const int r = this->getRoleIndexFromName(it.key().toLatin1());
+			const int r = this->getRoleIndexFromName(it.key());
 
 			if (r == -1) {
 				return false;
 			}
 
-			this->setVariantData(r, it.value().toVariant());
+			this->setVariantData(r, it.value().toVariant(), true);
 		}
 
+		refreshSortKey();
+
 		return true;
 	}
 
 	/**
-	 * \brief Writes the news as a JSON object
+	 * \brief Reads the news from a CBOR map
 	 *
-	 * \return the JSON object representing the news
+	 * This resets the news before reading. No callback is called
+	 * \param reader the CBOR reader, positioned on the map written by
+	 *               save()
+	 * \return false in case of error, true if the news was read correctly
 	 */
-	QJsonObject save() const
+	bool load(QCborStreamReader& reader)
 	{
-		// Building a QVariantMap from the values we have
-		QVariantMap map;
+		reset();
 
-		for (int i = 0; i < Roles<RolesListType>::numRoles(); ++i) {
-			map[this->getRoleNameFromIndex(i)] = this->getVariantData(i);
-		}
+		const bool ok = RolesCbor::read(reader, *this, true);
+
+		refreshSortKey();
+
+		return ok;
+	}
 
-		// Now building a JSON object from the variant map
-		return QJsonObject::fromVariantMap(map);
+	/**
+	 * \brief Sets the roles in a CBOR map
+	 *
+	 * Unlike load(), this doesn't reset the news: roles not in the map are
+	 * left untouched. Observers are notified once with all the roles that
+	 * have been set
+	 * \param reader the CBOR reader, positioned on the map with the roles
+	 *               to set
+	 * \return false if the map contains an unknown role or a value of the
+	 *         wrong type, true otherwise
+	 */
+	bool update(QCborStreamReader& reader)
+	{
+		return RolesCbor::read(reader, *this, false);
+	}
+
+	/**
+	 * \brief Writes the news as a CBOR map
+	 *
+	 * Values are written directly from the roles, nothing is allocated
+	 * besides the output of the writer
+	 * \param writer the CBOR writer
+	 */
+	void save(QCborStreamWriter& writer) const
+	{
+		RolesCbor::write(writer, *this);
 	}
 
 	/**
@@ -241,11 +292,29 @@ public:
 		return (i < this->numRoles()) ? this->getVariantData(i) : QVariant();
 	}
 
+protected:
+	/**
+	 * \brief The function called when roles change, before observers
+	 *
+	 * \param changedRoles the set of roles that changed
+	 */
+	void rolesChanged(const typename Roles<RolesListType>::ChangedRoles& changedRoles) override
+	{
+		if (changedRoles.test(this->template getIndex<NewsRoles::pubDate>()) || changedRoles.test(this->template getIndex<NewsRoles::title>())) {
+			refreshSortKey();
+		}
+	}
+
 private:
 	/**
 	 * \brief The news ID
 	 */
 	unsigned int m_id;
+
+	/**
+	 * \brief The cached key used to order news
+	 */
+	NewsSortKey m_sortKey;
 };
 
 #endif
@@ -0,0 +1,356 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+#ifndef __NEWS_IDENTITY_INDEX_H__
+#define __NEWS_IDENTITY_INDEX_H__
+
+#include <QHash>
+#include <QMultiHash>
+#include <QString>
+#include <QUrl>
+#include <QtGlobal>
+#include <array>
+#include "include/standardroles.h"
+#include "include/newsurlkey.h"
+#include "include/newssortkey.h"
+
+/**
+ * \brief The index used to tell whether a news is already known
+ *
+ * Each news has one or more identities: its guid, its permalink and its link
+ * (urls are normalized, see NewsUrlKey). Only if a news has none of these,
+ * its publication date and title are used. A news is known if any of its
+ * identities is in the index, so checking for duplicates costs a few hash
+ * lookups and doesn't depend on the position of the news in the list (e.g. a
+ * news whose date changed is still found). The index is keyed on 64-bit
+ * values made of the kind of the identity and its precomputed hash, strings
+ * are only compared when the key is found. Identities are associated with the
+ * id of a single news: inserting a news with an identity that belongs to
+ * another one moves the identity to the new news. The functions taking news
+ * are templates, they work with any roles list containing the standard roles
+ */
+class NewsIdentityIndex
+{
+public:
+	/**
+	 * \brief The possible kinds of identities
+	 *
+	 * Permalink and link share the kind, the permalink of a news could be
+	 * the link of another version of the same news
+	 */
+	enum class IdentityKind : quint64 {
+		Guid = 1,
+		Url = 2,
+		DateAndTitle = 3
+	};
+
+	/**
+	 * \brief An identity of a news
+	 */
+	struct Identity {
+		/**
+		 * \brief The key in the index
+		 *
+		 * The kind is in the upper 32 bits, the hash of the identity in
+		 * the lower 32 bits
+		 */
+		quint64 key = 0;
+
+		/**
+		 * \brief The publication date (see NewsSortKey::dateKey())
+		 *
+		 * This is only used for the DateAndTitle kind, otherwise it is 0
+		 */
+		qint64 date = 0;
+
+		/**
+		 * \brief The guid, the normalized url or the title
+		 *
+		 * This is implicitly shared with the data of the news or with the
+		 * NewsUrlKey, so it doesn't cost an allocation
+		 */
+		QString value;
+
+		/**
+		 * \brief Equality operator
+		 *
+		 * \param other the identity to compare with
+		 * \return true if the two identities are equal
+		 */
+		bool operator==(const Identity& other) const
+		{
+			return (key == other.key) && (date == other.date) && (value == other.value);
+		}
+	};
+
+	/**
+	 * \brief The identities of a news
+	 *
+	 * A news has at most three identities, they are stored in place
+	 */
+	struct Identities {
+		/**
+		 * \brief The identities, only the first size are valid
+		 */
+		std::array<Identity, 3> items;
+
+		/**
+		 * \brief The number of identities
+		 */
+		int size = 0;
+
+		/**
+		 * \brief Returns the first identity
+		 *
+		 * \return the first identity
+		 */
+		const Identity* begin() const
+		{
+			return items.data();
+		}
+
+		/**
+		 * \brief Returns the identity past the last one
+		 *
+		 * \return the identity past the last one
+		 */
+		const Identity* end() const
+		{
+			return items.data() + size;
+		}
+
+		/**
+		 * \brief Appends an identity
+		 *
+		 * \param kind the kind of the identity
+		 * \param hash the hash of the identity
+		 * \param value the guid, the normalized url or the title
+		 * \param date the publication date, only for the DateAndTitle kind
+		 */
+		void append(IdentityKind kind, uint hash, const QString& value, qint64 date = 0)
+		{
+			Identity& i = items[size++];
+			i.key = (quint64(kind) << 32) | quint64(hash);
+			i.date = date;
+			i.value = value;
+		}
+
+		/**
+		 * \brief Appends an identity
+		 *
+		 * \param identity the identity to append
+		 */
+		void append(const Identity& identity)
+		{
+			items[size++] = identity;
+		}
+
+		/**
+		 * \brief Returns true if the identity is in the list
+		 *
+		 * \param identity the identity to look for
+		 * \return true if the identity is in the list
+		 */
+		bool contains(const Identity& identity) const
+		{
+			for (const auto& i: *this) {
+				if (i == identity) {
+					return true;
+				}
+			}
+
+			return false;
+		}
+	};
+
+	/**
+	 * \brief Returns the identities of a news
+	 *
+	 * \param news the news
+	 * \return the identities of the news. The kind is part of the key, so
+	 *         that different kinds never clash
+	 */
+	template <class RolesType>
+	static Identities identities(const RolesType& news)
+	{
+		Identities ret;
+
+		const QString& guid = news.template getData<NewsRoles::guid>();
+		if (!guid.isEmpty()) {
+			ret.append(IdentityKind::Guid, qHash(guid), guid);
+		}
+
+		const NewsUrlKey permalink(news.template getData<NewsRoles::permalink>());
+		if (!permalink.isEmpty()) {
+			ret.append(IdentityKind::Url, permalink.hash(), permalink.key());
+		}
+		const NewsUrlKey link(news.template getData<NewsRoles::link>());
+		if (!link.isEmpty() && (link != permalink)) {
+			ret.append(IdentityKind::Url, link.hash(), link.key());
+		}
+
+		if (ret.size == 0) {
+			const qint64 date = NewsSortKey::dateKey(news.template getData<NewsRoles::pubDate>());
+			const QString& title = news.template getData<NewsRoles::title>();
+			ret.append(IdentityKind::DateAndTitle, qHash(title) ^ qHash(date), title, date);
+		}
+
+		return ret;
+	}
+
+public:
+	/**
+	 * \brief Constructor
+	 */
+	NewsIdentityIndex()
+		: m_identityToId()
+		, m_idToIdentities()
+	{
+	}
+
+	/**
+	 * \brief Returns true if the news is known
+	 *
+	 * \param news the news
+	 * \return true if any of the identities of the news is in the index
+	 */
+	template <class RolesType>
+	bool contains(const RolesType& news) const
+	{
+		unsigned int id;
+		for (const auto& i: identities(news)) {
+			if (findId(i, id)) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * \brief Returns true if the news shares an identity with another news
+	 *
+	 * Use this before updating the index with insert() when a news changes
+	 * \param id the id of the news
+	 * \param news the news
+	 * \return true if any of the identities of the news belongs to a news
+	 *         with a different id
+	 */
+	template <class RolesType>
+	bool conflicts(unsigned int id, const RolesType& news) const
+	{
+		unsigned int otherId;
+		for (const auto& i: identities(news)) {
+			if (findId(i, otherId) && (otherId != id)) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * \brief Adds a news to the index
+	 *
+	 * Previous identities of the news are removed, so this can also be used
+	 * to update the index when the news changes. Identities that already
+	 * belong to another news are left to that news (check with contains()
+	 * or conflicts() first)
+	 * \param id the id of the news
+	 * \param news the news
+	 */
+	template <class RolesType>
+	void insert(unsigned int id, const RolesType& news)
+	{
+		remove(id);
+
+		Identities newsIdentities;
+		for (const auto& i: identities(news)) {
+			unsigned int otherId;
+			if (!findId(i, otherId)) {
+				newsIdentities.append(i);
+				m_identityToId.insert(i.key, id);
+			}
+		}
+		m_idToIdentities.insert(id, newsIdentities);
+	}
+
+	/**
+	 * \brief Removes the news with the given id from the index
+	 *
+	 * \param id the id of the news
+	 */
+	void remove(unsigned int id)
+	{
+		auto it = m_idToIdentities.find(id);
+		if (it != m_idToIdentities.end()) {
+			for (const auto& i: it.value()) {
+				m_identityToId.remove(i.key, id);
+			}
+			m_idToIdentities.erase(it);
+		}
+	}
+
+	/**
+	 * \brief Removes all news from the index
+	 */
+	void clear()
+	{
+		m_identityToId.clear();
+		m_idToIdentities.clear();
+	}
+
+private:
+	/**
+	 * \brief Looks for the news having the given identity
+	 *
+	 * Strings are only compared for news whose identities have the same key
+	 * \param identity the identity to look for
+	 * \param id filled with the id of the news having the identity
+	 * \return true if a news has the identity
+	 */
+	bool findId(const Identity& identity, unsigned int& id) const
+	{
+		for (auto it = m_identityToId.constFind(identity.key); (it != m_identityToId.constEnd()) && (it.key() == identity.key); ++it) {
+			auto identitiesIt = m_idToIdentities.constFind(it.value());
+			if ((identitiesIt != m_idToIdentities.constEnd()) && identitiesIt.value().contains(identity)) {
+				id = it.value();
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * \brief The map from keys of identities to news ids
+	 *
+	 * Different identities could have the same key, so more than one news
+	 * can be associated with a key
+	 */
+	QMultiHash<quint64, unsigned int> m_identityToId;
+
+	/**
+	 * \brief The map from news ids to their identities
+	 */
+	QHash<unsigned int, Identities> m_idToIdentities;
+};
+
+#endif
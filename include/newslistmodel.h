@@ -24,8 +24,50 @@
 #include <QAbstractListModel>
 #include <QModelIndex>
 #include <QList>
+#include <QString>
+#include <QFile>
+#include <QCborStreamReader>
+#include <QCborStreamWriter>
+#include <QHash>
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <vector>
 #include "include/channel.h"
 #include "include/rolesqmlaccessor.h"
+#include "include/rolescbor.h"
+#include "include/filewriter.h"
+
+namespace __internal {
+	/**
+	 * \brief The number of news stored in the first screen file
+	 */
+	const int firstScreenSize = 20;
+
+	/**
+	 * \brief The roles stored in the first screen file
+	 *
+	 * These are the roles needed to draw the list of news. Roles not in the
+	 * type of news are skipped
+	 */
+	const char* const firstScreenRoles[] = {"title", "pubDate", "creator", "link", "qmlItem", "complete", "mainImageFile"};
+
+	/**
+	 * \brief The maximum number of qml accessors kept by the model
+	 *
+	 * More accessors are only created if all of them are in use
+	 */
+	const int maxQmlAccessors = 100;
+
+	/**
+	 * \brief The number of rows before and after the visible ones whose
+	 *        accessors are never recycled
+	 *
+	 * Views keep delegates near the visible area, which still use their
+	 * accessors
+	 */
+	const int qmlAccessorsGuardRows = 20;
+}
 
 /**
  * \brief This is needed because moc does not support template classes
@@ -44,6 +86,9 @@ public:
 	 */
 	AbstractNewsListModel(QObject* parent)
 		: QAbstractListModel(parent)
+		, m_firstScreenCompletionRequests()
+		, m_firstVisibleRow(-1)
+		, m_lastVisibleRow(-1)
 	{
 	}
 
@@ -65,6 +110,123 @@ public:
 	 */
 	virtual AbstractRolesQMLAccessor* getAccessorForNewsUrl(QUrl newsUrl) = 0;
 
+	/**
+	 * \brief Returns true if the model is showing the first screen stored
+	 *        by the previous execution instead of news in the channel
+	 *
+	 * \return true if the model is showing the stored first screen
+	 */
+	virtual bool showingFirstScreen() const = 0;
+
+	/**
+	 * \brief Stops showing the stored first screen and shows news in the
+	 *        channel
+	 *
+	 * Call this when the channel has been completely loaded. Does nothing
+	 * if the first screen is not being shown
+	 */
+	virtual void endFirstScreen() = 0;
+
+	/**
+	 * \brief Writes the first news of the channel to the first screen file
+	 *
+	 * The file is only written if the first news changed since the last
+	 * time it was saved. The file is written by the FileWriter thread
+	 */
+	virtual void saveFirstScreen() = 0;
+
+	/**
+	 * \brief Tells which news are currently visible in the view
+	 *
+	 * Views should call this whenever the visible area changes. The range
+	 * is stored (accessors of visible news are never recycled) and the
+	 * visibleRangeChanged signal is emitted
+	 * \param firstIndex the index of the first visible news
+	 * \param lastIndex the index of the last visible news
+	 */
+	Q_INVOKABLE void setVisibleRange(int firstIndex, int lastIndex)
+	{
+		m_firstVisibleRow = firstIndex;
+		m_lastVisibleRow = lastIndex;
+
+		emit visibleRangeChanged(firstIndex, lastIndex);
+	}
+
+	/**
+	 * \brief Prevents the qml accessor from being recycled
+	 *
+	 * Views showing a news outside the list (e.g. the page of an article)
+	 * should call this when they start using the accessor and
+	 * unpinAccessor() when they are done. Calls can be nested. Objects
+	 * that are not accessors of this model are ignored
+	 * \param accessor the accessor to pin
+	 */
+	Q_INVOKABLE virtual void pinAccessor(QObject* accessor) = 0;
+
+	/**
+	 * \brief Allows the qml accessor to be recycled again
+	 *
+	 * See pinAccessor()
+	 * \param accessor the accessor to unpin
+	 */
+	Q_INVOKABLE virtual void unpinAccessor(QObject* accessor) = 0;
+
+	/**
+	 * \brief Asks to complete the news at the given index as soon as
+	 *        possible
+	 *
+	 * Views should call this when the user selects a news that is not
+	 * complete yet. This emits the newsCompletionRequested signal. While
+	 * the stored first screen is shown, rows are not news in the channel:
+	 * the request is stored and the signal is emitted when the channel
+	 * takes over
+	 * \param index the index of the news
+	 */
+	Q_INVOKABLE void requestNewsCompletion(int index)
+	{
+		if (showingFirstScreen()) {
+			m_firstScreenCompletionRequests.removeAll(index);
+			m_firstScreenCompletionRequests.append(index);
+
+			return;
+		}
+
+		emit newsCompletionRequested(index);
+	}
+
+signals:
+	/**
+	 * \brief The signal emitted when the visible range of news changes
+	 *
+	 * \param firstIndex the index of the first visible news
+	 * \param lastIndex the index of the last visible news
+	 */
+	void visibleRangeChanged(int firstIndex, int lastIndex);
+
+	/**
+	 * \brief The signal emitted when the completion of a news is requested
+	 *
+	 * \param index the index of the news
+	 */
+	void newsCompletionRequested(int index);
+
+protected:
+	/**
+	 * \brief The rows of the first screen whose completion was requested,
+	 *        from the oldest request
+	 */
+	QList<int> m_firstScreenCompletionRequests;
+
+	/**
+	 * \brief The first visible row or -1 if unknown
+	 */
+	int m_firstVisibleRow;
+
+	/**
+	 * \brief The last visible row or -1 if unknown
+	 */
+	int m_lastVisibleRow;
+
 private slots:
 	/**
 	 * \brief The slot called when a new news is about to be added
@@ -99,6 +261,23 @@ private slots:
 	 */
 	virtual void newsDeleted() = 0;
 
+	/**
+	 * \brief The slot called when a news is about to be moved
+	 *
+	 * This calls beginMoveRows() to inform views that data is about to
+	 * change
+	 * \param sourceIndex the current index of the news
+	 * \param destinationIndex the index the news will have once moved
+	 */
+	virtual void aboutToMoveNews(int sourceIndex, int destinationIndex) = 0;
+
+	/**
+	 * \brief The slot called when a news has been moved
+	 *
+	 * This calls endMoveRows() to inform views that data has been changed
+	 */
+	virtual void newsMoved() = 0;
+
 	/**
 	 * \brief The slot called when a news has been changed
 	 *
@@ -114,7 +293,29 @@ private slots:
  * This is the model we use to display the list of news. The template parameter
  * ChannelType is the type of the channel. This provides a special role named
  * "roles" (whose id is Qt::UserRole) that can be used to get the roles qml
- * accessor object for the news
+ * accessor object for the news.
+ *
+ * Accessors are only created when requested and are kept in a pool of at most
+ * __internal::maxQmlAccessors objects, ordered from the most recently used.
+ * When the pool is full, the least recently used accessor is recycled: it
+ * stops observing its news and is bound to the requested one. Accessors pinned
+ * by views (see pinAccessor()) are never recycled, nor are accessors of rows
+ * near the visible range once it is known (see setVisibleRange()). Accessors
+ * of removed news are deleted.
+ *
+ * To have something to show while stored news are loaded, the model can write
+ * the first news of the channel (only the roles needed by the list, see
+ * __internal::firstScreenRoles) to a small file, a CBOR array of maps written
+ * with RolesCbor. If the channel is empty when the model is created, the news
+ * in that file are shown until the channel has at least as many news or
+ * endFirstScreen() is called. Then rows that refer to the same news (same
+ * publication date and title) are kept together with their qml accessors,
+ * which are moved to the news in the channel, the others are replaced (pinned
+ * accessors of replaced rows stay valid until they are unpinned). While the
+ * first screen is shown, changes in the channel are not forwarded to views.
+ * News of the first screen only have a few roles, so they are always reported
+ * as not complete: views treat a click as a completion request (see
+ * requestNewsCompletion()), which is forwarded when the channel takes over
  */
 template <class ChannelType>
 class NewsListModel : public AbstractNewsListModel
@@ -131,8 +332,10 @@ public:
 	 *
 	 * \param channel the channel whose news we show. This is also the
 	 *                parent object
+	 * \param firstScreenFile the file where the first news are stored to
+	 *                        be shown at the next startup
 	 */
-	NewsListModel(ChannelType* channel);
+	NewsListModel(ChannelType* channel, QString firstScreenFile);
 
 	/**
 	 * \brief Destructor
@@ -150,6 +353,44 @@ public:
 	 */
 	virtual AbstractRolesQMLAccessor* getAccessorForNewsUrl(QUrl newsUrl);
 
+	/**
+	 * \brief Prevents the qml accessor from being recycled
+	 *
+	 * \param accessor the accessor to pin
+	 */
+	virtual void pinAccessor(QObject* accessor) override;
+
+	/**
+	 * \brief Allows the qml accessor to be recycled again
+	 *
+	 * \param accessor the accessor to unpin
+	 */
+	virtual void unpinAccessor(QObject* accessor) override;
+
+	/**
+	 * \brief Returns true if the model is showing the first screen stored
+	 *        by the previous execution instead of news in the channel
+	 *
+	 * \return true if the model is showing the stored first screen
+	 */
+	virtual bool showingFirstScreen() const override;
+
+	/**
+	 * \brief Stops showing the stored first screen and shows news in the
+	 *        channel
+	 *
+	 * Does nothing if the first screen is not being shown
+	 */
+	virtual void endFirstScreen() override;
+
+	/**
+	 * \brief Writes the first news of the channel to the first screen file
+	 *
+	 * The file is only written if the first news changed since the last
+	 * time it was saved
+	 */
+	virtual void saveFirstScreen() override;
+
 	/**
 	 * \brief Returns the number of rows in the model
 	 *
@@ -188,6 +429,31 @@ public:
 	virtual QHash<int, QByteArray> roleNames() const override;
 
 private:
+	/**
+	 * \brief An accessor in the pool
+	 */
+	struct PooledAccessor {
+		/**
+		 * \brief The accessor
+		 */
+		RolesQMLAccessor<NewsType>* accessor;
+
+		/**
+		 * \brief The news the accessor is bound to
+		 */
+		NewsType* news;
+
+		/**
+		 * \brief How many times the accessor has been pinned
+		 */
+		int pins;
+	};
+
+	/**
+	 * \brief The type of the pool of accessors
+	 */
+	using AccessorsPool = std::list<PooledAccessor>;
+
 	/**
 	 * \brief The slot called when a new news is about to be added
 	 *
@@ -221,6 +487,23 @@ private:
 	 */
 	void newsDeleted() override;
 
+	/**
+	 * \brief The slot called when a news is about to be moved
+	 *
+	 * This calls beginMoveRows() to inform views that data is about to
+	 * change. The qml accessor of the news is moved, not recreated
+	 * \param sourceIndex the current index of the news
+	 * \param destinationIndex the index the news will have once moved
+	 */
+	void aboutToMoveNews(int sourceIndex, int destinationIndex) override;
+
+	/**
+	 * \brief The slot called when a news has been moved
+	 *
+	 * This calls endMoveRows() to inform views that data has been changed
+	 */
+	void newsMoved() override;
+
 	/**
 	 * \brief The slot called when a news has been changed
 	 *
@@ -229,57 +512,177 @@ private:
 	 */
 	void newsUpdated(int index, const QVector<int>& roles) override;
 
+	/**
+	 * \brief Reads the news in the first screen file
+	 */
+	void loadFirstScreen();
+
+	/**
+	 * \brief Replaces the news of the first screen with news in the
+	 *        channel
+	 */
+	void switchToChannel();
+
+	/**
+	 * \brief Marks the first screen as changed if the given index is in it
+	 *
+	 * \param index the index of a news in the channel
+	 */
+	void checkFirstScreenChanged(int index);
+
+	/**
+	 * \brief Returns the news shown at the given row
+	 *
+	 * \param row the row
+	 * \return the news shown at the given row
+	 */
+	NewsType& newsAtRow(int row) const;
+
+	/**
+	 * \brief Returns the qml accessor for the news at the given row
+	 *
+	 * The accessor is created or recycled if the news has none
+	 * \param row the row
+	 * \return the accessor for the news at the given row
+	 */
+	RolesQMLAccessor<NewsType>* accessorForRow(int row) const;
+
+	/**
+	 * \brief Returns true if the accessor in the pool can be recycled
+	 *
+	 * Pinned accessors are never recycled. If the visible range is not
+	 * known or the first screen is shown, any other accessor can be
+	 * recycled
+	 * \param accessor the entry of the pool
+	 * \return true if the accessor can be recycled
+	 */
+	bool canRecycle(const PooledAccessor& accessor) const;
+
+	/**
+	 * \brief Deletes the accessor of the news, if it has one
+	 *
+	 * \param news the news
+	 */
+	void deleteAccessor(const NewsType* news);
+
+	/**
+	 * \brief Deletes all accessors
+	 */
+	void deleteAllAccessors();
+
+	/**
+	 * \brief Releases a news of the first screen that is not shown anymore
+	 *
+	 * If the accessor of the news is pinned, the news is kept in
+	 * m_detachedNews until the accessor is unpinned, otherwise the accessor
+	 * is deleted together with the news
+	 * \param news the news to release
+	 */
+	void releaseFirstScreenNews(std::unique_ptr<NewsType>&& news);
+
 	/**
 	 * \brief The channel to model
 	 */
 	ChannelType* const m_channel;
 
 	/**
-	 * \brief The list of qml accessors for news in the channel
+	 * \brief The file with the first news of the channel
+	 */
+	const QString m_firstScreenFile;
+
+	/**
+	 * \brief The news of the first screen being shown
+	 *
+	 * This is empty when news of the channel are shown
+	 */
+	std::vector<std::unique_ptr<NewsType>> m_firstScreenNews;
+
+	/**
+	 * \brief The news of the first screen that are not shown anymore but
+	 *        whose accessors are still pinned
+	 */
+	std::vector<std::unique_ptr<NewsType>> m_detachedNews;
+
+	/**
+	 * \brief True if the first news of the channel changed since the
+	 *        first screen file was written
+	 *
+	 * This is reset when the file is enqueued to the FileWriter and set
+	 * again if writing fails
+	 */
+	bool m_firstScreenChanged;
+
+	/**
+	 * \brief Set to false when this object is destroyed
+	 *
+	 * Callbacks of the FileWriter check this before using this object
+	 */
+	std::shared_ptr<bool> m_alive;
+
+	/**
+	 * \brief The pool of qml accessors, from the most recently used
 	 */
-	QList<RolesQMLAccessor<NewsType>*> m_qmlAccessors;
+	mutable AccessorsPool m_accessorsPool;
 
 	/**
-	 * \brief The index of the accessor to add
+	 * \brief The entries of the pool, by news
 	 */
-	int m_accessorToAddIndex;
+	mutable QHash<const NewsType*, typename AccessorsPool::iterator> m_accessorsByNews;
+
+	/**
+	 * \brief The entries of the pool, by accessor
+	 */
+	mutable QHash<const QObject*, typename AccessorsPool::iterator> m_accessorsByObject;
 };
 
 // Implementation of template functions
 #include <QDebug>
 
 template <class ChannelType>
-NewsListModel<ChannelType>::NewsListModel(ChannelType* channel)
+NewsListModel<ChannelType>::NewsListModel(ChannelType* channel, QString firstScreenFile)
 	: AbstractNewsListModel(channel)
 	, m_channel(channel)
-	, m_qmlAccessors()
-	, m_accessorToAddIndex(0)
+	, m_firstScreenFile(firstScreenFile)
+	, m_firstScreenNews()
+	, m_detachedNews()
+	, m_firstScreenChanged(false)
+	, m_alive(std::make_shared<bool>(true))
+	, m_accessorsPool()
+	, m_accessorsByNews()
+	, m_accessorsByObject()
 {
 	// Connecting signals from channel
 	connect(m_channel, &ChannelType::aboutToAddNews, this, &NewsListModel::aboutToAddNews);
 	connect(m_channel, &ChannelType::newsAdded, this, &NewsListModel::newsAdded);
 	connect(m_channel, &ChannelType::aboutToDeleteNews, this, &NewsListModel::aboutToDeleteNews);
 	connect(m_channel, &ChannelType::newsDeleted, this, &NewsListModel::newsDeleted);
+	connect(m_channel, &ChannelType::aboutToMoveNews, this, &NewsListModel::aboutToMoveNews);
+	connect(m_channel, &ChannelType::newsMoved, this, &NewsListModel::newsMoved);
 	connect(m_channel, &ChannelType::newsUpdated, this, &NewsListModel::newsUpdated);
 
-	// Creating roles qml accessors for existing news
-	for (int i = 0; i < m_channel->numNews(); ++i) {
-		m_qmlAccessors.append(new RolesQMLAccessor<NewsType>(&(m_channel->news(i)), this));
+	// If there are no news (stored news have not been loaded yet) we show the first screen
+	// stored by the previous execution. Roles qml accessors are created when requested
+	if (m_channel->numNews() == 0) {
+		loadFirstScreen();
 	}
 }
 
 template <class ChannelType>
 NewsListModel<ChannelType>::~NewsListModel()
 {
-	// Deleting all qml news accessors
-	for (auto accessor: m_qmlAccessors) {
-		delete accessor;
-	}
+	*m_alive = false;
+
+	deleteAllAccessors();
 }
 
 template <class ChannelType>
 AbstractRolesQMLAccessor* NewsListModel<ChannelType>::getAccessorForNewsUrl(QUrl newsUrl)
 {
+	// Accessors of the first screen do not refer to news in the channel
+	if (showingFirstScreen()) {
+		return nullptr;
+	}
+
 	const auto id = m_channel->newsIDForURL(newsUrl);
 
 	// Trying to get the index. If invalid, returning nullptr, otherwise the roles qml accessor
@@ -288,14 +691,108 @@ AbstractRolesQMLAccessor* NewsListModel<ChannelType>::getAccessorForNewsUrl(QUrl
 	if (index == -1) {
 		return nullptr;
 	} else {
-		return m_qmlAccessors[index];
+		return accessorForRow(index);
+	}
+}
+
+template <class ChannelType>
+void NewsListModel<ChannelType>::pinAccessor(QObject* accessor)
+{
+	auto it = m_accessorsByObject.find(accessor);
+
+	if (it != m_accessorsByObject.end()) {
+		++(it.value()->pins);
+	}
+}
+
+template <class ChannelType>
+void NewsListModel<ChannelType>::unpinAccessor(QObject* accessor)
+{
+	auto it = m_accessorsByObject.find(accessor);
+
+	if ((it == m_accessorsByObject.end()) || (it.value()->pins == 0)) {
+		return;
+	}
+
+	auto poolIt = it.value();
+	if (--(poolIt->pins) > 0) {
+		return;
+	}
+
+	// If the accessor belongs to a news of the first screen that is not shown anymore, it is
+	// not needed anymore. The view could still be using it, so it is deleted later and the news
+	// is deleted when the accessor is destroyed
+	auto newsIt = std::find_if(m_detachedNews.begin(), m_detachedNews.end(), [poolIt](const std::unique_ptr<NewsType>& n) { return n.get() == poolIt->news; });
+	if (newsIt != m_detachedNews.end()) {
+		RolesQMLAccessor<NewsType>* const detachedAccessor = poolIt->accessor;
+		NewsType* const news = newsIt->release();
+		m_detachedNews.erase(newsIt);
+
+		m_accessorsByNews.remove(poolIt->news);
+		m_accessorsByObject.erase(it);
+		m_accessorsPool.erase(poolIt);
+
+		connect(detachedAccessor, &QObject::destroyed, [news]() { delete news; });
+		detachedAccessor->deleteLater();
 	}
 }
 
+template <class ChannelType>
+bool NewsListModel<ChannelType>::showingFirstScreen() const
+{
+	return !m_firstScreenNews.empty();
+}
+
+template <class ChannelType>
+void NewsListModel<ChannelType>::endFirstScreen()
+{
+	if (showingFirstScreen()) {
+		switchToChannel();
+	}
+}
+
+template <class ChannelType>
+void NewsListModel<ChannelType>::saveFirstScreen()
+{
+	// While the first screen is shown the channel could be incomplete
+	if (!m_firstScreenChanged || showingFirstScreen()) {
+		return;
+	}
+
+	typename NewsType::ChangedRoles roles;
+	for (auto name: __internal::firstScreenRoles) {
+		const int r = NewsType::getRoleIndexFromName(name);
+
+		if (r != -1) {
+			roles.set(r);
+		}
+	}
+
+	const int numNews = qMin(__internal::firstScreenSize, m_channel->numNews());
+	QByteArray data;
+	QCborStreamWriter writer(&data);
+	writer.startArray(numNews);
+	for (int i = 0; i < numNews; ++i) {
+		RolesCbor::write(writer, m_channel->news(i), roles);
+	}
+	writer.endArray();
+
+	// The file is replaced atomically by the FileWriter thread, a partially written first screen
+	// is never read. If writing fails, we try again at the next call
+	m_firstScreenChanged = false;
+	FW::instance().writeFile(m_firstScreenFile, data, [this, alive = m_alive](bool success) {
+		if (!success && *alive) {
+			qDebug() << "Cannot write the first screen to" << m_firstScreenFile;
+
+			m_firstScreenChanged = true;
+		}
+	});
+}
+
 template <class ChannelType>
 int NewsListModel<ChannelType>::rowCount(const QModelIndex&) const
 {
-	return m_channel->numNews();
+	return showingFirstScreen() ? int(m_firstScreenNews.size()) : m_channel->numNews();
 }
 
 template <class ChannelType>
@@ -307,7 +804,7 @@ QVariant NewsListModel<ChannelType>::data(const QModelIndex& index, int role) co
 	}
 
 	// Now also checking the index is valid
-	if ((!index.isValid()) || (index.row() >= m_channel->numNews())) {
+	if ((!index.isValid()) || (index.row() >= rowCount())) {
 		return QVariant();
 	}
 
@@ -319,7 +816,7 @@ QVariant NewsListModel<ChannelType>::data(const QModelIndex& index, int role) co
 		// supported by QVariant directly. QMetaObject has special code to handle
 		// QObject, so we just need to static_cast the qml accessor to QObject
 		QVariant v;
-		v.setValue(static_cast<QObject*>(m_qmlAccessors[index.row()]));
+		v.setValue(static_cast<QObject*>(accessorForRow(index.row())));
 		return v;
 	} else {
 		// More checks that the role is valid
@@ -328,7 +825,7 @@ QVariant NewsListModel<ChannelType>::data(const QModelIndex& index, int role) co
 			return QVariant();
 		}
 
-		return m_channel->news(index.row()).data(myIntRole);
+		return newsAtRow(index.row()).data(myIntRole);
 	}
 }
 
@@ -372,49 +869,98 @@ QHash<int, QByteArray> NewsListModel<ChannelType>::roleNames() const
 template <class ChannelType>
 void NewsListModel<ChannelType>::aboutToAddNews(int index)
 {
+	// Views don't see news in the channel while the first screen is shown
+	if (showingFirstScreen()) {
+		return;
+	}
+
+	checkFirstScreenChanged(index);
+
 	// Signalling we are starting to insert rows (i.e. one news)
 	beginInsertRows(QModelIndex(), index, index);
-
-	// Storing the index of the accessor to add
-	m_accessorToAddIndex = index;
 }
 
 template <class ChannelType>
 void NewsListModel<ChannelType>::newsAdded()
 {
-	// Signalling rows have been added
-	endInsertRows();
+	// Once the channel has enough news to fill the first screen, we show them
+	if (showingFirstScreen()) {
+		if (m_channel->numNews() >= int(m_firstScreenNews.size())) {
+			switchToChannel();
+		}
 
-	// Adding the new accessor
-	m_qmlAccessors.insert(m_accessorToAddIndex, new RolesQMLAccessor<NewsType>(&(m_channel->news(m_accessorToAddIndex)), this));
+		return;
+	}
+
+	// Signalling rows have been added. The accessor is created when requested
+	endInsertRows();
 }
 
 template <class ChannelType>
 void NewsListModel<ChannelType>::aboutToDeleteNews(int startIndex, int endIndex)
 {
+	if (showingFirstScreen()) {
+		return;
+	}
+
+	checkFirstScreenChanged(startIndex);
+
 	// Signalling we are starting to remove
 	beginRemoveRows(QModelIndex(), startIndex, endIndex);
 
 	// Removing accessors (we do this here instead of newsDeleted() because there
 	// news have already been deleted
 	for (int i = startIndex; i <= endIndex; ++i) {
-		// We always use startIndex because as we remove one accessor all the subsequent
-		// ones have their index decreased by one
-		delete m_qmlAccessors[startIndex];
-		m_qmlAccessors.removeAt(startIndex);
+		deleteAccessor(&(m_channel->news(i)));
 	}
 }
 
 template <class ChannelType>
 void NewsListModel<ChannelType>::newsDeleted()
 {
+	if (showingFirstScreen()) {
+		return;
+	}
+
 	// Signalling rows have been deleted
 	endRemoveRows();
 }
 
+template <class ChannelType>
+void NewsListModel<ChannelType>::aboutToMoveNews(int sourceIndex, int destinationIndex)
+{
+	if (showingFirstScreen()) {
+		return;
+	}
+
+	checkFirstScreenChanged(qMin(sourceIndex, destinationIndex));
+
+	// The channel gives the final index of the news, while beginMoveRows() wants the index
+	// before which the row is put in the list as it is before the move
+	// The accessor, if any, still refers to the same news
+	beginMoveRows(QModelIndex(), sourceIndex, sourceIndex, QModelIndex(), (destinationIndex > sourceIndex) ? (destinationIndex + 1) : destinationIndex);
+}
+
+template <class ChannelType>
+void NewsListModel<ChannelType>::newsMoved()
+{
+	if (showingFirstScreen()) {
+		return;
+	}
+
+	// Signalling rows have been moved
+	endMoveRows();
+}
+
 template <class ChannelType>
 void NewsListModel<ChannelType>::newsUpdated(int newsIndex, const QVector<int>& roles)
 {
+	if (showingFirstScreen()) {
+		return;
+	}
+
+	checkFirstScreenChanged(newsIndex);
+
 	// We have to fix the index of roles
 	QVector<int> fixedRoles(roles.size());
 	for (int i = 0; i < fixedRoles.size(); ++i) {
@@ -425,5 +971,215 @@ void NewsListModel<ChannelType>::newsUpdated(int newsIndex, const QVector<int>&
 	emit dataChanged(index(newsIndex), index(newsIndex), fixedRoles);
 }
 
+template <class ChannelType>
+void NewsListModel<ChannelType>::loadFirstScreen()
+{
+	QFile file(m_firstScreenFile);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return;
+	}
+
+	const QByteArray data = file.readAll();
+	QCborStreamReader reader(data);
+	if (!reader.isArray() || !reader.enterContainer()) {
+		return;
+	}
+
+	while (reader.hasNext() && (int(m_firstScreenNews.size()) < __internal::firstScreenSize)) {
+		auto news = std::make_unique<NewsType>(0);
+
+		// Unknown roles (e.g. written by a different version) are skipped, we only stop if the
+		// file is damaged
+		if (!news->load(reader) && (reader.lastError() != QCborError::NoError)) {
+			break;
+		}
+
+		// Only the roles needed by the list are stored, the news cannot be shown from here
+		news->template setData<NewsRoles::complete>(false, true);
+
+		m_firstScreenNews.push_back(std::move(news));
+	}
+}
+
+template <class ChannelType>
+void NewsListModel<ChannelType>::switchToChannel()
+{
+	const int firstScreenRows = int(m_firstScreenNews.size());
+	const int channelRows = m_channel->numNews();
+
+	// Rows showing the same news keep their accessors, so that QML objects bound to them are
+	// still valid
+	int commonRows = 0;
+	while ((commonRows < firstScreenRows) && (commonRows < channelRows) && (m_firstScreenNews[commonRows]->sortKey() == m_channel->news(commonRows).sortKey())) {
+		++commonRows;
+	}
+
+	if (commonRows == 0) {
+		// Nothing to keep
+		beginResetModel();
+		for (auto& news: m_firstScreenNews) {
+			releaseFirstScreenNews(std::move(news));
+		}
+		m_firstScreenNews.clear();
+		endResetModel();
+	} else {
+		// Removing rows of the first screen that are not in the channel
+		if (commonRows < firstScreenRows) {
+			beginRemoveRows(QModelIndex(), commonRows, firstScreenRows - 1);
+			for (int i = commonRows; i < firstScreenRows; ++i) {
+				releaseFirstScreenNews(std::move(m_firstScreenNews[i]));
+			}
+			m_firstScreenNews.resize(commonRows);
+			endRemoveRows();
+		}
+
+		// Moving accessors to news in the channel and adding the other news
+		for (int i = 0; i < commonRows; ++i) {
+			auto it = m_accessorsByNews.find(m_firstScreenNews[i].get());
+
+			if (it != m_accessorsByNews.end()) {
+				auto poolIt = it.value();
+				m_accessorsByNews.erase(it);
+
+				poolIt->news = &(m_channel->news(i));
+				poolIt->accessor->rebind(poolIt->news);
+				m_accessorsByNews.insert(poolIt->news, poolIt);
+			}
+		}
+		if (commonRows < channelRows) {
+			beginInsertRows(QModelIndex(), commonRows, channelRows - 1);
+		}
+		m_firstScreenNews.clear();
+		if (commonRows < channelRows) {
+			endInsertRows();
+		}
+
+		// Kept rows can have different values for the roles not used to compare news
+		emit dataChanged(index(0), index(commonRows - 1));
+	}
+
+	// Forwarding completion requests for rows that are still there
+	for (int row: m_firstScreenCompletionRequests) {
+		if (row < commonRows) {
+			emit newsCompletionRequested(row);
+		}
+	}
+	m_firstScreenCompletionRequests.clear();
+}
+
+template <class ChannelType>
+void NewsListModel<ChannelType>::checkFirstScreenChanged(int index)
+{
+	if (index < __internal::firstScreenSize) {
+		m_firstScreenChanged = true;
+	}
+}
+
+template <class ChannelType>
+typename NewsListModel<ChannelType>::NewsType& NewsListModel<ChannelType>::newsAtRow(int row) const
+{
+	return showingFirstScreen() ? *(m_firstScreenNews[row]) : m_channel->news(row);
+}
+
+template <class ChannelType>
+RolesQMLAccessor<typename NewsListModel<ChannelType>::NewsType>* NewsListModel<ChannelType>::accessorForRow(int row) const
+{
+	NewsType* const news = &(newsAtRow(row));
+
+	// If the news already has an accessor, it becomes the most recently used one
+	auto it = m_accessorsByNews.constFind(news);
+	if (it != m_accessorsByNews.constEnd()) {
+		m_accessorsPool.splice(m_accessorsPool.begin(), m_accessorsPool, it.value());
+
+		return it.value()->accessor;
+	}
+
+	// Looking for an accessor to recycle, starting from the least recently used one
+	if (int(m_accessorsPool.size()) >= __internal::maxQmlAccessors) {
+		for (auto poolIt = m_accessorsPool.end(); poolIt != m_accessorsPool.begin(); ) {
+			--poolIt;
+
+			if (canRecycle(*poolIt)) {
+				m_accessorsByNews.remove(poolIt->news);
+
+				poolIt->news = news;
+				poolIt->accessor->rebind(news);
+				m_accessorsByNews.insert(news, poolIt);
+				m_accessorsPool.splice(m_accessorsPool.begin(), m_accessorsPool, poolIt);
+
+				return poolIt->accessor;
+			}
+		}
+	}
+
+	// Creating a new accessor. The const_cast is needed because the model is the parent
+	auto accessor = new RolesQMLAccessor<NewsType>(news, const_cast<NewsListModel<ChannelType>*>(this));
+	m_accessorsPool.push_front(PooledAccessor{accessor, news, 0});
+	m_accessorsByNews.insert(news, m_accessorsPool.begin());
+	m_accessorsByObject.insert(accessor, m_accessorsPool.begin());
+
+	return accessor;
+}
+
+template <class ChannelType>
+bool NewsListModel<ChannelType>::canRecycle(const PooledAccessor& accessor) const
+{
+	if (accessor.pins > 0) {
+		return false;
+	}
+
+	// If the visible range is unknown, or rows cannot be found in the channel because the first
+	// screen is shown, falling back to the least recently used order: the pool must not grow
+	// over its size
+	if ((m_firstVisibleRow == -1) || showingFirstScreen()) {
+		return true;
+	}
+
+	const int row = m_channel->newsIndexByID(accessor.news->id());
+
+	return (row < (m_firstVisibleRow - __internal::qmlAccessorsGuardRows)) || (row > (m_lastVisibleRow + __internal::qmlAccessorsGuardRows));
+}
+
+template <class ChannelType>
+void NewsListModel<ChannelType>::deleteAccessor(const NewsType* news)
+{
+	auto it = m_accessorsByNews.find(news);
+	if (it == m_accessorsByNews.end()) {
+		return;
+	}
+
+	auto poolIt = it.value();
+	m_accessorsByNews.erase(it);
+	m_accessorsByObject.remove(poolIt->accessor);
+
+	delete poolIt->accessor;
+	m_accessorsPool.erase(poolIt);
+}
+
+template <class ChannelType>
+void NewsListModel<ChannelType>::deleteAllAccessors()
+{
+	for (const auto& a: m_accessorsPool) {
+		delete a.accessor;
+	}
+
+	m_accessorsPool.clear();
+	m_accessorsByNews.clear();
+	m_accessorsByObject.clear();
+}
+
+template <class ChannelType>
+void NewsListModel<ChannelType>::releaseFirstScreenNews(std::unique_ptr<NewsType>&& news)
+{
+	auto it = m_accessorsByNews.find(news.get());
+
+	if ((it != m_accessorsByNews.end()) && (it.value()->pins > 0)) {
+		m_detachedNews.push_back(std::move(news));
+	} else {
+		deleteAccessor(news.get());
+		news.reset();
+	}
+}
+
 
 #endif
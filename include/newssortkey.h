@@ -0,0 +1,167 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __NEWS_SORT_KEY_H__
+#define __NEWS_SORT_KEY_H__
+
+#include <QDateTime>
+#include <QString>
+#include <QtGlobal>
+#include <limits>
+
+/**
+ * \brief The key used to order news
+ *
+ * News are ordered by publication date and, if dates are the same, by title.
+ * The date is stored as milliseconds since the epoch (in UTC), so that most
+ * comparisons are a single integer comparison, without converting QVariants
+ * or normalizing time zones. The title is only compared when dates are
+ * equal. Invalid dates come before all valid ones, as for QDateTime
+ */
+class NewsSortKey
+{
+public:
+	/**
+	 * \brief Returns the date part of the key for the given date
+	 *
+	 * \param date the date
+	 * \return the date part of the key
+	 */
+	static qint64 dateKey(const QDateTime& date)
+	{
+		return date.isValid() ? date.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+	}
+
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * Creates the key for a news with invalid date and empty title
+	 */
+	NewsSortKey()
+		: m_pubDate(std::numeric_limits<qint64>::min())
+		, m_title()
+	{
+	}
+
+	/**
+	 * \brief Constructor
+	 *
+	 * \param pubDate the publication date of the news
+	 * \param title the title of the news
+	 */
+	NewsSortKey(const QDateTime& pubDate, const QString& title)
+		: m_pubDate(dateKey(pubDate))
+		, m_title(title)
+	{
+	}
+
+	/**
+	 * \brief Constructor
+	 *
+	 * \param pubDate the date part of the key (see dateKey())
+	 * \param title the title of the news
+	 */
+	NewsSortKey(qint64 pubDate, const QString& title)
+		: m_pubDate(pubDate)
+		, m_title(title)
+	{
+	}
+
+	/**
+	 * \brief Returns the date part of the key
+	 *
+	 * \return the date part of the key
+	 */
+	qint64 pubDate() const
+	{
+		return m_pubDate;
+	}
+
+	/**
+	 * \brief Returns the title
+	 *
+	 * \return the title
+	 */
+	const QString& title() const
+	{
+		return m_title;
+	}
+
+	/**
+	 * \brief Equality operator
+	 *
+	 * \param other the key to compare with
+	 * \return true if the two keys are equal
+	 */
+	bool operator==(const NewsSortKey& other) const
+	{
+		return (m_pubDate == other.m_pubDate) && (m_title == other.m_title);
+	}
+
+	/**
+	 * \brief Disequality operator
+	 *
+	 * \param other the key to compare with
+	 * \return true if the two keys are different
+	 */
+	bool operator!=(const NewsSortKey& other) const
+	{
+		return !operator==(other);
+	}
+
+	/**
+	 * \brief Less-than operator
+	 *
+	 * \param other the key to compare with
+	 * \return true if this key is less than the other
+	 */
+	bool operator<(const NewsSortKey& other) const
+	{
+		return (m_pubDate < other.m_pubDate) ||
+		       ((m_pubDate == other.m_pubDate) && (m_title < other.m_title));
+	}
+
+	/**
+	 * \brief Greater-than operator
+	 *
+	 * \param other the key to compare with
+	 * \return true if this key is greater than the other
+	 */
+	bool operator>(const NewsSortKey& other) const
+	{
+		return other.operator<(*this);
+	}
+
+private:
+	/**
+	 * \brief The publication date in milliseconds since the epoch
+	 */
+	qint64 m_pubDate;
+
+	/**
+	 * \brief The title
+	 *
+	 * This is implicitly shared with the title stored in the news
+	 */
+	QString m_title;
+};
+
+#endif
@@ -0,0 +1,286 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __NEWS_URL_KEY_H__
+#define __NEWS_URL_KEY_H__
+
+#include <QHash>
+#include <QString>
+#include <QUrl>
+
+/**
+ * \brief The key used to look for news by url
+ *
+ * The same news can be linked with slightly different urls (e.g. with http or
+ * https, with or without a trailing slash or with a fragment). This class
+ * stores a normalized version of the url (without the scheme, fragment,
+ * default port and trailing slash and with the host in lowercase) together
+ * with its hash, which is computed only once. Comparisons first check the
+ * hash, so looking for a key in a QHash costs one string comparison at most
+ */
+class NewsUrlKey
+{
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * Creates an empty key
+	 */
+	NewsUrlKey()
+		: m_key()
+		, m_hash(0)
+	{
+	}
+
+	/**
+	 * \brief Constructor
+	 *
+	 * \param url the url from which the key is generated
+	 */
+	explicit NewsUrlKey(const QUrl& url)
+		: m_key(normalize(url))
+		, m_hash(qHash(m_key))
+	{
+	}
+
+	/**
+	 * \brief Returns true if the key is empty
+	 *
+	 * This happens for empty or invalid urls
+	 * \return true if the key is empty
+	 */
+	bool isEmpty() const
+	{
+		return m_key.isEmpty();
+	}
+
+	/**
+	 * \brief Returns the normalized url
+	 *
+	 * \return the normalized url
+	 */
+	const QString& key() const
+	{
+		return m_key;
+	}
+
+	/**
+	 * \brief Returns the precomputed hash
+	 *
+	 * \return the hash of the key
+	 */
+	uint hash() const
+	{
+		return m_hash;
+	}
+
+	/**
+	 * \brief Equality operator
+	 *
+	 * \param other the key to compare with
+	 * \return true if the two keys are equal
+	 */
+	bool operator==(const NewsUrlKey& other) const
+	{
+		return (m_hash == other.m_hash) && (m_key == other.m_key);
+	}
+
+	/**
+	 * \brief Disequality operator
+	 *
+	 * \param other the key to compare with
+	 * \return true if the two keys are different
+	 */
+	bool operator!=(const NewsUrlKey& other) const
+	{
+		return !operator==(other);
+	}
+
+private:
+	/**
+	 * \brief Returns the normalized version of an url
+	 *
+	 * \param url the url to normalize
+	 * \return the normalized url or an empty string if the url is empty or
+	 *         invalid
+	 */
+	static QString normalize(const QUrl& url)
+	{
+		if (url.isEmpty() || !url.isValid()) {
+			return QString();
+		}
+
+		QString path = url.path(QUrl::FullyEncoded);
+		while (path.endsWith('/')) {
+			path.chop(1);
+		}
+
+		QString ret = url.host(QUrl::FullyEncoded).toLower();
+		const int port = url.port();
+		if ((port != -1) && (port != 80) && (port != 443)) {
+			ret += ":" + QString::number(port);
+		}
+		ret += path;
+		if (url.hasQuery()) {
+			ret += "?" + url.query(QUrl::FullyEncoded);
+		}
+
+		return ret;
+	}
+
+	/**
+	 * \brief The normalized url
+	 */
+	QString m_key;
+
+	/**
+	 * \brief The hash of m_key
+	 */
+	uint m_hash;
+};
+
+/**
+ * \brief The hash function for NewsUrlKey
+ *
+ * \param key the key
+ * \param seed the seed
+ * \return the hash of the key
+ */
+inline uint qHash(const NewsUrlKey& key, uint seed = 0)
+{
+	return key.hash() ^ seed;
+}
+
+/**
+ * \brief A bidirectional index between news ids and news urls
+ *
+ * Both directions are O(1): the id of a news with a given url is needed to
+ * find news and to avoid duplicates, the url of a news with a given id is
+ * needed to update the index when the url of a news changes or a news is
+ * removed. Only one news can be associated with an url, empty urls are not
+ * stored
+ */
+class NewsUrlIndex
+{
+public:
+	/**
+	 * \brief Constructor
+	 */
+	NewsUrlIndex()
+		: m_urlToId()
+		, m_idToUrl()
+	{
+	}
+
+	/**
+	 * \brief Associates a news with an url
+	 *
+	 * Any previous url of the news is removed. If the url was associated
+	 * with another news, the association is moved to this one
+	 * \param id the id of the news
+	 * \param url the url of the news
+	 */
+	void insert(unsigned int id, const QUrl& url)
+	{
+		remove(id);
+
+		const NewsUrlKey key(url);
+		if (key.isEmpty()) {
+			return;
+		}
+
+		// Removing the association of the url with another news
+		auto it = m_urlToId.find(key);
+		if (it != m_urlToId.end()) {
+			m_idToUrl.remove(it.value());
+			it.value() = id;
+		} else {
+			m_urlToId.insert(key, id);
+		}
+		m_idToUrl.insert(id, key);
+	}
+
+	/**
+	 * \brief Removes the news with the given id from the index
+	 *
+	 * \param id the id of the news
+	 */
+	void remove(unsigned int id)
+	{
+		auto it = m_idToUrl.find(id);
+		if (it != m_idToUrl.end()) {
+			m_urlToId.remove(it.value());
+			m_idToUrl.erase(it);
+		}
+	}
+
+	/**
+	 * \brief Returns true if the index contains the url
+	 *
+	 * \param url the url
+	 * \return true if a news is associated with the url
+	 */
+	bool contains(const QUrl& url) const
+	{
+		return m_urlToId.contains(NewsUrlKey(url));
+	}
+
+	/**
+	 * \brief Returns the id of the news with the given url
+	 *
+	 * \param url the url
+	 * \param id filled with the id of the news, unchanged if no news is
+	 *           associated with the url
+	 * \return true if a news is associated with the url
+	 */
+	bool id(const QUrl& url, unsigned int& id) const
+	{
+		auto it = m_urlToId.constFind(NewsUrlKey(url));
+		if (it == m_urlToId.constEnd()) {
+			return false;
+		}
+
+		id = it.value();
+
+		return true;
+	}
+
+	/**
+	 * \brief Removes everything
+	 */
+	void clear()
+	{
+		m_urlToId.clear();
+		m_idToUrl.clear();
+	}
+
+private:
+	/**
+	 * \brief The map from url keys to news ids
+	 */
+	QHash<NewsUrlKey, unsigned int> m_urlToId;
+
+	/**
+	 * \brief The map from news ids to url keys
+	 */
+	QHash<unsigned int, NewsUrlKey> m_idToUrl;
+};
+
+#endif
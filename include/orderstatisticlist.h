@@ -0,0 +1,617 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __ORDER_STATISTIC_LIST_H__
+#define __ORDER_STATISTIC_LIST_H__
+
+#include <QVector>
+#include <QtGlobal>
+#include <iterator>
+
+/**
+ * \brief A list with O(log n) access by position, insertion and removal
+ *
+ * This is an implicit treap (a randomized balanced binary tree where the key of
+ * each node is its position in the list). Each element lives in a node which
+ * is identified by a handle (an integer) that doesn't change while the element
+ * is in the list, even if elements are inserted or removed before it. Given a
+ * handle, the position of the element can be computed in O(log n), so that a
+ * map from a key to the handle gives the position of an element without
+ * renumbering elements when the list changes. The list is not kept ordered by
+ * itself, but if elements are inserted in the right position, the
+ * countWhile() function can be used to perform a binary search in O(log n).
+ * Each element has a key, used by countWhile(), and a value. Nodes, keys and
+ * values are stored in three parallel vectors indexed by the handle of the
+ * node, so that a binary search only reads the (small) nodes and the keys,
+ * never the values. Removed nodes are reused, so there is no allocation per
+ * element. Key and T must be default-constructible and copyable (they are
+ * meant to store pointers or other small values)
+ */
+template <class Key, class T>
+class OrderStatisticList
+{
+private:
+	/**
+	 * \brief The structure with a node of the tree
+	 *
+	 * The key and the value of the node are in m_keys and m_values
+	 */
+	struct Node {
+		/**
+		 * \brief The priority of the node in the heap
+		 */
+		quint32 priority;
+
+		/**
+		 * \brief The size of the subtree rooted here
+		 */
+		int size;
+
+		/**
+		 * \brief The left child or -1
+		 */
+		int left;
+
+		/**
+		 * \brief The right child or -1
+		 */
+		int right;
+
+		/**
+		 * \brief The parent or -1 for the root
+		 */
+		int parent;
+	};
+
+public:
+	/**
+	 * \brief The iterator to visit elements in order
+	 *
+	 * Iterators are invalidated when the list is modified
+	 */
+	class const_iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = int;
+		using pointer = const T*;
+		using reference = const T&;
+
+		/**
+		 * \brief Constructor
+		 *
+		 * \param list the list
+		 * \param node the current node or -1 for the end iterator
+		 */
+		const_iterator(const OrderStatisticList<Key, T>* list, int node)
+			: m_list(list)
+			, m_node(node)
+		{
+		}
+
+		/**
+		 * \brief Dereference operator
+		 *
+		 * \return the current element
+		 */
+		const T& operator*() const
+		{
+			return m_list->m_values[m_node];
+		}
+
+		/**
+		 * \brief Pre-increment operator
+		 *
+		 * This is O(1) amortized
+		 * \return a reference to this
+		 */
+		const_iterator& operator++()
+		{
+			m_node = m_list->successor(m_node);
+
+			return *this;
+		}
+
+		/**
+		 * \brief Equality operator
+		 *
+		 * \param other the iterator to compare with
+		 * \return true if the two iterators point to the same node
+		 */
+		bool operator==(const const_iterator& other) const
+		{
+			return m_node == other.m_node;
+		}
+
+		/**
+		 * \brief Disequality operator
+		 *
+		 * \param other the iterator to compare with
+		 * \return true if the two iterators point to different nodes
+		 */
+		bool operator!=(const const_iterator& other) const
+		{
+			return m_node != other.m_node;
+		}
+
+	private:
+		/**
+		 * \brief The list
+		 */
+		const OrderStatisticList<Key, T>* m_list;
+
+		/**
+		 * \brief The current node
+		 */
+		int m_node;
+	};
+
+	/**
+	 * \brief Constructor
+	 */
+	OrderStatisticList()
+		: m_nodes()
+		, m_keys()
+		, m_values()
+		, m_freeNodes()
+		, m_root(-1)
+		, m_randomState(0x9E3779B9u)
+	{
+	}
+
+	/**
+	 * \brief Returns the number of elements
+	 *
+	 * \return the number of elements
+	 */
+	int size() const
+	{
+		return nodeSize(m_root);
+	}
+
+	/**
+	 * \brief Returns true if the list is empty
+	 *
+	 * \return true if the list is empty
+	 */
+	bool isEmpty() const
+	{
+		return m_root == -1;
+	}
+
+	/**
+	 * \brief Returns the element at the given position
+	 *
+	 * \param position the position of the element. It must be valid
+	 * \return the element at the given position
+	 */
+	const T& at(int position) const
+	{
+		return m_values[nodeAt(position)];
+	}
+
+	/**
+	 * \brief Returns the key of the element at the given position
+	 *
+	 * \param position the position of the element. It must be valid
+	 * \return the key of the element at the given position
+	 */
+	const Key& keyAt(int position) const
+	{
+		return m_keys[nodeAt(position)];
+	}
+
+	/**
+	 * \brief Returns the first element
+	 *
+	 * The list must not be empty
+	 * \return the first element
+	 */
+	const T& first() const
+	{
+		return at(0);
+	}
+
+	/**
+	 * \brief Returns the last element
+	 *
+	 * The list must not be empty
+	 * \return the last element
+	 */
+	const T& last() const
+	{
+		return at(size() - 1);
+	}
+
+	/**
+	 * \brief Returns the element of the node with the given handle
+	 *
+	 * \param node the handle of the node. It must be valid
+	 * \return the element of the node
+	 */
+	const T& value(int node) const
+	{
+		return m_values[node];
+	}
+
+	/**
+	 * \brief Returns the handle of the node at the given position
+	 *
+	 * \param position the position of the element. It must be valid
+	 * \return the handle of the node
+	 */
+	int nodeAt(int position) const
+	{
+		int n = m_root;
+
+		while (n != -1) {
+			const int leftSize = nodeSize(m_nodes[n].left);
+
+			if (position < leftSize) {
+				n = m_nodes[n].left;
+			} else if (position == leftSize) {
+				return n;
+			} else {
+				position -= leftSize + 1;
+				n = m_nodes[n].right;
+			}
+		}
+
+		qFatal("OrderStatisticList: position out of range");
+		return -1;
+	}
+
+	/**
+	 * \brief Returns the position of the node with the given handle
+	 *
+	 * \param node the handle of the node. It must be valid
+	 * \return the position of the node in the list
+	 */
+	int position(int node) const
+	{
+		int pos = nodeSize(m_nodes[node].left);
+
+		// Going up to the root, every time we come from a right child we add the left subtree
+		// and the parent
+		while (m_nodes[node].parent != -1) {
+			const int parent = m_nodes[node].parent;
+
+			if (m_nodes[parent].right == node) {
+				pos += nodeSize(m_nodes[parent].left) + 1;
+			}
+
+			node = parent;
+		}
+
+		return pos;
+	}
+
+	/**
+	 * \brief Returns the number of leading elements whose key satisfies
+	 *        the given predicate
+	 *
+	 * The predicate must be true for all keys up to a position and false
+	 * for all subsequent keys (e.g. "the key comes before x" in an ordered
+	 * list). This is a binary search in O(log n) that doesn't read values
+	 * \param pred the predicate, taking a const reference to a key
+	 * \return the number of leading elements for which pred is true
+	 */
+	template <class Predicate>
+	int countWhile(Predicate pred) const
+	{
+		int count = 0;
+		int n = m_root;
+
+		while (n != -1) {
+			if (pred(m_keys[n])) {
+				count += nodeSize(m_nodes[n].left) + 1;
+				n = m_nodes[n].right;
+			} else {
+				n = m_nodes[n].left;
+			}
+		}
+
+		return count;
+	}
+
+	/**
+	 * \brief Inserts an element at the given position
+	 *
+	 * \param position the position of the new element, between 0 and
+	 *                 size() (included)
+	 * \param key the key of the element to insert
+	 * \param value the element to insert
+	 * \return the handle of the node with the new element
+	 */
+	int insert(int position, const Key& key, const T& value)
+	{
+		// Getting a free node
+		int n;
+		if (m_freeNodes.isEmpty()) {
+			n = m_nodes.size();
+			m_nodes.append(Node());
+			m_keys.append(key);
+			m_values.append(value);
+		} else {
+			n = m_freeNodes.takeLast();
+			m_keys[n] = key;
+			m_values[n] = value;
+		}
+
+		Node& node = m_nodes[n];
+		node.priority = nextPriority();
+		node.size = 1;
+		node.left = -1;
+		node.right = -1;
+		node.parent = -1;
+
+		int left;
+		int right;
+		split(m_root, position, left, right);
+		m_root = merge(merge(left, n), right);
+		m_nodes[m_root].parent = -1;
+
+		return n;
+	}
+
+	/**
+	 * \brief Removes the element at the given position
+	 *
+	 * The handle of the node becomes invalid
+	 * \param position the position of the element to remove. It must be
+	 *                 valid
+	 * \return the removed element
+	 */
+	T takeAt(int position)
+	{
+		int left;
+		int middle;
+		int right;
+		split(m_root, position, left, middle);
+		split(middle, 1, middle, right);
+		m_root = merge(left, right);
+		if (m_root != -1) {
+			m_nodes[m_root].parent = -1;
+		}
+
+		// Releasing the node
+		const T ret = m_values[middle];
+		m_keys[middle] = Key();
+		m_values[middle] = T();
+		m_freeNodes.append(middle);
+
+		return ret;
+	}
+
+	/**
+	 * \brief Removes all elements
+	 */
+	void clear()
+	{
+		m_nodes.clear();
+		m_keys.clear();
+		m_values.clear();
+		m_freeNodes.clear();
+		m_root = -1;
+	}
+
+	/**
+	 * \brief Returns the iterator to the first element
+	 *
+	 * \return the iterator to the first element
+	 */
+	const_iterator begin() const
+	{
+		int n = m_root;
+
+		if (n != -1) {
+			while (m_nodes[n].left != -1) {
+				n = m_nodes[n].left;
+			}
+		}
+
+		return const_iterator(this, n);
+	}
+
+	/**
+	 * \brief Returns the iterator past the last element
+	 *
+	 * \return the iterator past the last element
+	 */
+	const_iterator end() const
+	{
+		return const_iterator(this, -1);
+	}
+
+private:
+	/**
+	 * \brief Returns the size of the subtree rooted at the given node
+	 *
+	 * \param n the node or -1
+	 * \return the size of the subtree
+	 */
+	int nodeSize(int n) const
+	{
+		return (n == -1) ? 0 : m_nodes[n].size;
+	}
+
+	/**
+	 * \brief Recomputes the size of a node and sets it as the parent of its
+	 *        children
+	 *
+	 * \param n the node
+	 */
+	void update(int n)
+	{
+		Node& node = m_nodes[n];
+
+		node.size = nodeSize(node.left) + nodeSize(node.right) + 1;
+		if (node.left != -1) {
+			m_nodes[node.left].parent = n;
+		}
+		if (node.right != -1) {
+			m_nodes[node.right].parent = n;
+		}
+	}
+
+	/**
+	 * \brief Splits a subtree in two subtrees, the first with the first k
+	 *        elements, the second with the others
+	 *
+	 * \param n the root of the subtree to split or -1
+	 * \param k the number of elements in the left subtree
+	 * \param left filled with the root of the left subtree or -1
+	 * \param right filled with the root of the right subtree or -1
+	 */
+	void split(int n, int k, int& left, int& right)
+	{
+		if (n == -1) {
+			left = -1;
+			right = -1;
+
+			return;
+		}
+
+		const int leftSize = nodeSize(m_nodes[n].left);
+		if (k <= leftSize) {
+			int l;
+			split(m_nodes[n].left, k, left, l);
+			m_nodes[n].left = l;
+			right = n;
+		} else {
+			int r;
+			split(m_nodes[n].right, k - leftSize - 1, r, right);
+			m_nodes[n].right = r;
+			left = n;
+		}
+
+		update(n);
+		if (left != -1) {
+			m_nodes[left].parent = -1;
+		}
+		if (right != -1) {
+			m_nodes[right].parent = -1;
+		}
+	}
+
+	/**
+	 * \brief Merges two subtrees, all elements of the left one come before
+	 *        those of the right one
+	 *
+	 * \param left the root of the left subtree or -1
+	 * \param right the root of the right subtree or -1
+	 * \return the root of the merged subtree
+	 */
+	int merge(int left, int right)
+	{
+		if (left == -1) {
+			return right;
+		} else if (right == -1) {
+			return left;
+		}
+
+		if (m_nodes[left].priority > m_nodes[right].priority) {
+			m_nodes[left].right = merge(m_nodes[left].right, right);
+			update(left);
+
+			return left;
+		} else {
+			m_nodes[right].left = merge(left, m_nodes[right].left);
+			update(right);
+
+			return right;
+		}
+	}
+
+	/**
+	 * \brief Returns the node following the given one in the list
+	 *
+	 * \param n the node
+	 * \return the next node or -1 if n is the last one
+	 */
+	int successor(int n) const
+	{
+		if (m_nodes[n].right != -1) {
+			n = m_nodes[n].right;
+			while (m_nodes[n].left != -1) {
+				n = m_nodes[n].left;
+			}
+
+			return n;
+		}
+
+		// Going up until we come from a left child
+		int parent = m_nodes[n].parent;
+		while ((parent != -1) && (m_nodes[parent].right == n)) {
+			n = parent;
+			parent = m_nodes[n].parent;
+		}
+
+		return parent;
+	}
+
+	/**
+	 * \brief Returns a new pseudo-random priority
+	 *
+	 * \return a new priority
+	 */
+	quint32 nextPriority()
+	{
+		// A xorshift generator, it is enough to keep the tree balanced
+		m_randomState ^= m_randomState << 13;
+		m_randomState ^= m_randomState >> 17;
+		m_randomState ^= m_randomState << 5;
+
+		return m_randomState;
+	}
+
+	/**
+	 * \brief The nodes of the tree
+	 */
+	QVector<Node> m_nodes;
+
+	/**
+	 * \brief The keys of the elements, indexed by the handle of the node
+	 */
+	QVector<Key> m_keys;
+
+	/**
+	 * \brief The elements, indexed by the handle of the node
+	 */
+	QVector<T> m_values;
+
+	/**
+	 * \brief The nodes that have been removed and can be reused
+	 */
+	QVector<int> m_freeNodes;
+
+	/**
+	 * \brief The root of the tree or -1 if the list is empty
+	 */
+	int m_root;
+
+	/**
+	 * \brief The state of the pseudo-random number generator
+	 */
+	quint32 m_randomState;
+};
+
+#endif
@@ -25,7 +25,7 @@
 #include <QUrl>
 #include <QString>
 #include <QFileSystemWatcher>
-#include <QFile>
+#include <QElapsedTimer>
 #include <QSet>
 #include "include/dataavailablenotifee.h"
 
@@ -38,7 +38,11 @@
  * probably be added later). While downloading, data is stored in a file that
  * has the same path of the destination file with the .part suffix added. This
  * class should be registered with the QML engine so that it can be used from
- * QML. When this class is destroyed unfinished downloads are interrupted. You
+ * QML. Files are written by the FileWriter thread: data is appended to the
+ * .part file as it arrives and the file is synced and renamed when the
+ * download is complete, so the status only becomes Downloaded once the file
+ * is on disk. The download progress is notified at most a few times per
+ * second. When this class is destroyed unfinished downloads are interrupted. You
  * should create instances using RemoteFileProviderFactory so that download can
  * continue in background
  */
@@ -298,6 +302,19 @@ private:
 	 */
 	void setError(Error error);
 
+	/**
+	 * \brief The function called when the part file could not be created
+	 */
+	void partFileNotCreated();
+
+	/**
+	 * \brief The function called when the part file has been renamed to the
+	 *        destination file
+	 *
+	 * \param success false if the file could not be written or renamed
+	 */
+	void partFileRenamed(bool success);
+
 	/**
 	 * \brief The current status
 	 */
@@ -334,9 +351,28 @@ private:
 	QFileSystemWatcher m_fileWatcher;
 
 	/**
-	 * \brief The file where partially downloaded data is written
+	 * \brief The FileWriter stream writing the part file
+	 *
+	 * This is -1 if no part file is being written
+	 */
+	int m_partStream;
+
+	/**
+	 * \brief The number of bytes received in the current download
+	 */
+	qint64 m_receivedBytes;
+
+	/**
+	 * \brief The size of the remote file
+	 *
+	 * This is -1 if not known yet, 0 if the server didn't send it
+	 */
+	qint64 m_totalBytes;
+
+	/**
+	 * \brief The timer to limit the rate of progress notifications
 	 */
-	QFile m_partFile;
+	QElapsedTimer m_progressTimer;
 };
 
 #endif
@@ -0,0 +1,266 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __ROLE_NAMES_TABLE_H__
+#define __ROLE_NAMES_TABLE_H__
+
+#include <QtGlobal>
+
+namespace __internal {
+	// Helper functions used by RoleNamesTable
+
+	/**
+	 * \brief Returns the code of a character of a name
+	 *
+	 * \param c the character
+	 * \return the code of the character
+	 */
+	constexpr quint32 roleNameCharCode(char c)
+	{
+		return static_cast<unsigned char>(c);
+	}
+
+	/**
+	 * \brief Returns the code of a character of a name (UTF-16 version)
+	 *
+	 * \param c the character
+	 * \return the code of the character
+	 */
+	constexpr quint32 roleNameCharCode(ushort c)
+	{
+		return c;
+	}
+
+	/**
+	 * \brief Returns the length of a null-terminated string
+	 *
+	 * \param s the string
+	 * \return the length of the string
+	 */
+	constexpr int roleNameLength(const char* s)
+	{
+		int l = 0;
+		while (s[l] != '\0') {
+			++l;
+		}
+
+		return l;
+	}
+
+	/**
+	 * \brief The FNV-1a hash of a name, with a seed
+	 *
+	 * \param name the characters of the name
+	 * \param length the number of characters of the name
+	 * \param seed the seed of the hash
+	 * \return the hash of the name
+	 */
+	template <class Char>
+	constexpr quint32 roleNameHash(const Char* name, int length, quint32 seed)
+	{
+		quint32 h = 2166136261u ^ seed;
+		for (int i = 0; i < length; ++i) {
+			h = (h ^ roleNameCharCode(name[i])) * 16777619u;
+		}
+
+		return h;
+	}
+
+	/**
+	 * \brief Returns true if a name is equal to a null-terminated string
+	 *
+	 * \param s the null-terminated string
+	 * \param name the characters of the name
+	 * \param length the number of characters of the name
+	 * \return true if the two strings are equal
+	 */
+	template <class Char>
+	constexpr bool roleNameEqual(const char* s, const Char* name, int length)
+	{
+		for (int i = 0; i < length; ++i) {
+			if ((s[i] == '\0') || (roleNameCharCode(s[i]) != roleNameCharCode(name[i]))) {
+				return false;
+			}
+		}
+
+		return s[length] == '\0';
+	}
+
+	/**
+	 * \brief Returns the smallest power of two not less than n
+	 *
+	 * \param n the number
+	 * \return the smallest power of two not less than n
+	 */
+	constexpr int nextPowerOfTwo(int n)
+	{
+		int p = 1;
+		while (p < n) {
+			p *= 2;
+		}
+
+		return p;
+	}
+
+	/**
+	 * \brief The maximum number of seeds tried when building a table
+	 */
+	constexpr quint32 roleNamesTableMaxSeeds = 1 << 16;
+}
+
+/**
+ * \brief A perfect hash table from names of roles to indexes
+ *
+ * The table is built at compile time from the names of roles in a RolesList
+ * (the template parameter), which must have the static constexpr functions
+ * numRoles() and nameAt(). Names are hashed with FNV-1a: the seed of the hash
+ * is chosen so that no two names fall in the same slot, so a lookup is one
+ * hash computation and one string comparison, without allocating anything.
+ * Names can be given as 8-bit characters or as UTF-16 code units (e.g. the
+ * data of a QString). Building the table never fails for any reasonable
+ * number of roles, isValid() checks it anyway
+ */
+template <class RoleListType>
+class RoleNamesTable
+{
+public:
+	/**
+	 * \brief The number of roles
+	 */
+	static constexpr int numRoles = RoleListType::numRoles();
+
+	/**
+	 * \brief The number of slots of the table
+	 *
+	 * Four slots per role make finding a seed quick
+	 */
+	static constexpr int numSlots = __internal::nextPowerOfTwo(4 * numRoles);
+
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * Builds the table, this is meant to be evaluated at compile time
+	 */
+	constexpr RoleNamesTable()
+		: m_names{}
+		, m_lengths{}
+		, m_slots{}
+		, m_seed(0)
+	{
+		for (int i = 0; i < numRoles; ++i) {
+			m_names[i] = RoleListType::nameAt(i);
+			m_lengths[i] = __internal::roleNameLength(m_names[i]);
+		}
+
+		// Trying seeds until there is no collision
+		for (; m_seed < __internal::roleNamesTableMaxSeeds; ++m_seed) {
+			for (int s = 0; s < numSlots; ++s) {
+				m_slots[s] = -1;
+			}
+
+			bool collision = false;
+			for (int i = 0; (i < numRoles) && !collision; ++i) {
+				const int s = slot(m_names[i], m_lengths[i]);
+				if (m_slots[s] == -1) {
+					m_slots[s] = i;
+				} else {
+					collision = true;
+				}
+			}
+
+			if (!collision) {
+				break;
+			}
+		}
+	}
+
+	/**
+	 * \brief Returns true if a seed without collisions was found
+	 *
+	 * \return true if the table is valid
+	 */
+	constexpr bool isValid() const
+	{
+		return m_seed < __internal::roleNamesTableMaxSeeds;
+	}
+
+	/**
+	 * \brief Returns the name of the role with the given index
+	 *
+	 * \param index the index of the role
+	 * \return the name of the role
+	 */
+	constexpr const char* name(int index) const
+	{
+		return m_names[index];
+	}
+
+	/**
+	 * \brief Returns the index of the role with the given name
+	 *
+	 * \param name the characters of the name
+	 * \param length the number of characters of the name
+	 * \return the index of the role or -1 if no role exists with that name
+	 */
+	template <class Char>
+	constexpr int index(const Char* name, int length) const
+	{
+		const int i = m_slots[slot(name, length)];
+
+		return ((i != -1) && (m_lengths[i] == length) && __internal::roleNameEqual(m_names[i], name, length)) ? i : -1;
+	}
+
+private:
+	/**
+	 * \brief Returns the slot of a name with the current seed
+	 *
+	 * \param name the characters of the name
+	 * \param length the number of characters of the name
+	 * \return the slot for the name
+	 */
+	template <class Char>
+	constexpr int slot(const Char* name, int length) const
+	{
+		return static_cast<int>(__internal::roleNameHash(name, length, m_seed) & (numSlots - 1));
+	}
+
+	/**
+	 * \brief The names of roles
+	 */
+	const char* m_names[numRoles];
+
+	/**
+	 * \brief The lengths of the names of roles
+	 */
+	int m_lengths[numRoles];
+
+	/**
+	 * \brief The slots of the table, with the index of a role or -1
+	 */
+	int m_slots[numSlots];
+
+	/**
+	 * \brief The seed of the hash function
+	 */
+	quint32 m_seed;
+};
+
+#endif
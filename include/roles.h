@@ -26,6 +26,8 @@
 #include <array>
 #include <utility>
 #include <functional>
+#include <bitset>
+#include <type_traits>
 #include "include/roleshelpers.h"
 #include "include/utilities.h"
 
@@ -50,8 +52,7 @@
  *	public:
  *		using RoleType = <data_type_for_role>;
  *
- *		// The index parameter must be stored in i
- *		RoleName(int index);
+ *		RoleName();
  *
  *		RoleName(const RoleName& other);
  *
@@ -59,43 +60,395 @@
  *		RoleName(RoleName&& other);
  *
  *		// Returns the value of the role
- *		RoleType toRoleType() const;
+ *		const RoleType& toRoleType() const;
  *
  *		// Sets the value of the role
  *		void fromRoleType(const RoleType& d);
  *
+ *		// Sets the value of the role moving d (only needed if setData
+ *		// is called with an rvalue)
+ *		void fromRoleType(RoleType&& d);
+ *
+ *		// Returns the value as a QVariant (used for qml and JSON)
+ *		QVariant toVariant() const;
+ *
+ *		// Sets the value from a QVariant (used for qml and JSON)
+ *		void fromVariant(const QVariant& d);
+ *
+ *		// Resets the value to the default one
+ *		void reset();
+ *
  *		// This is the role name used in qml
  *		static constexpr const char* s = "role_name";
  *
- *		// The index of the role (set in the constructor)
- *		const int i;
- *
- *		// This is data exposed to qml (it must always be present)
- *		QVariant v;
+ *		// The value of the role, with its native type
+ *		RoleType v;
  *	};
  * \endcode
  */
 
+/**
+ * \brief The base class of objects observing changes of Roles
+ *
+ * Observers are kept by Roles in an intrusive singly linked list, so that
+ * registering an observer requires no allocation. The template parameter is
+ * the number of roles, so that the set of changed roles is a fixed-size
+ * bitmask: the bit of each role is the role index
+ */
+template <int NumRoles>
+class RolesObserver
+{
+public:
+	/**
+	 * \brief The type of the set of changed roles
+	 */
+	using ChangedRoles = std::bitset<NumRoles>;
+
+public:
+	/**
+	 * \brief Constructor
+	 */
+	RolesObserver()
+		: m_nextObserver(nullptr)
+	{
+	}
+
+	/**
+	 * \brief Destructor
+	 *
+	 * Observers must be removed from the Roles object they observe before
+	 * being destroyed
+	 */
+	virtual ~RolesObserver()
+	{
+	}
+
+	/**
+	 * \brief The function called when roles change
+	 *
+	 * This is called once per change outside of transactions and once per
+	 * transaction otherwise
+	 * \param changedRoles the set of roles that changed
+	 */
+	virtual void rolesChanged(const ChangedRoles& changedRoles) = 0;
+
+private:
+	/**
+	 * \brief The next observer in the list
+	 */
+	RolesObserver* m_nextObserver;
+
+	/**
+	 * \brief Roles is friend to manage the list of observers
+	 */
+	template <class>
+	friend class Roles;
+};
+
 /**
  * \brief The class modelling a list of roles with access vectors
  *
  * This class puts together a RolesVector and RolesList. You should use this
- * instead of inheriting from those two classes directly. It also allows setting
- * the callback after creation
+ * instead of inheriting from those two classes directly. It also allows adding
+ * observers after creation, which are notified when roles change. Changes can
+ * be grouped by calling beginUpdate() and commit(): during a transaction the
+ * changed roles are collected in a bitmask and observers are notified only
+ * once, when the outermost transaction is committed. An observer may delete
+ * the observed object from rolesChanged() only if it is the last one in the
+ * list (i.e. the first one that was added). This is the object notified when
+ * data of roles changes and the one knowing the outermost list of roles, so
+ * the index of a role is a compile-time constant and lists of roles only store
+ * values
  */
 template <class RolesListType>
-class Roles : public RolesCallbackStorage, public RolesVectors<RolesListType>, public RolesListType
+class Roles : public RolesChangeNotifier, public RolesVectors<RolesListType>, public RolesListType
 {
+public:
+	/**
+	 * \brief The type of observers of this list of roles
+	 */
+	using Observer = RolesObserver<RolesListType::numRoles()>;
+
+	/**
+	 * \brief The type of the set of changed roles
+	 */
+	using ChangedRoles = typename Observer::ChangedRoles;
+
 public:
 	/**
 	 * \brief Constructor
 	 */
 	Roles()
-		: RolesCallbackStorage()
-		, RolesVectors<RolesListType>(static_cast<RolesCallbackStorage*>(this))
-		, RolesListType(static_cast<RolesCallbackStorage*>(this), RolesVectors<RolesListType>::m_roleValues.data())
+		: RolesChangeNotifier()
+		, RolesVectors<RolesListType>()
+		, RolesListType()
+		, m_firstObserver(nullptr)
+		, m_changedRoles()
+		, m_updateDepth(0)
+	{
+	}
+
+	/**
+	 * \brief Copy constructor
+	 *
+	 * Only data of roles is copied, observers are not
+	 * \param other the object to copy
+	 */
+	Roles(const Roles<RolesListType>& other)
+		: Roles()
+	{
+		this->copyDataFromOtherRolesList(other);
+	}
+
+	/**
+	 * \brief Copy operator
+	 *
+	 * Only data of roles is copied, observers, pending changes and the
+	 * update depth of this object are kept. Observers are not notified
+	 * \param other the object to copy
+	 * \return a reference to this
+	 */
+	Roles<RolesListType>& operator=(const Roles<RolesListType>& other)
+	{
+		if (this != &other) {
+			this->copyDataFromOtherRolesList(other);
+		}
+
+		return *this;
+	}
+
+	/**
+	 * \brief Destructor
+	 */
+	virtual ~Roles()
+	{
+	}
+
+	/**
+	 * \brief Adds an observer
+	 *
+	 * The observer is not owned by this object
+	 * \param observer the observer to add
+	 */
+	void addObserver(Observer* observer)
 	{
+		observer->m_nextObserver = m_firstObserver;
+		m_firstObserver = observer;
 	}
+
+	/**
+	 * \brief Removes an observer
+	 *
+	 * \param observer the observer to remove
+	 * \return false if the observer was not in the list, true otherwise
+	 */
+	bool removeObserver(Observer* observer)
+	{
+		for (Observer** o = &m_firstObserver; *o != nullptr; o = &((*o)->m_nextObserver)) {
+			if (*o == observer) {
+				*o = observer->m_nextObserver;
+				observer->m_nextObserver = nullptr;
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * \brief Starts a transaction
+	 *
+	 * Until the matching call to commit(), observers are not notified of
+	 * changes. Transactions can be nested
+	 */
+	void beginUpdate()
+	{
+		++m_updateDepth;
+	}
+
+	/**
+	 * \brief Ends a transaction
+	 *
+	 * When the outermost transaction ends, observers are notified once with
+	 * all the roles changed during the transaction (if any)
+	 */
+	void commit()
+	{
+		if ((--m_updateDepth == 0) && m_changedRoles.any()) {
+			const ChangedRoles changedRoles = m_changedRoles;
+			m_changedRoles.reset();
+
+			notifyObservers(changedRoles);
+		}
+	}
+
+	/**
+	 * \brief Returns true if a transaction is running
+	 *
+	 * \return true if a transaction is running
+	 */
+	bool isUpdating() const
+	{
+		return m_updateDepth > 0;
+	}
+
+	/**
+	 * \brief Returns the index of the given role
+	 *
+	 * The role is passed as the template parameter. This is evaluated at
+	 * compile time
+	 * \return the index of the given role
+	 */
+	template <class R>
+	static constexpr int getIndex()
+	{
+		static_assert(std::is_base_of<R, RolesListType>::value, "The role is not in the list");
+
+		return RolesListType::template localIndex<R>();
+	}
+
+	/**
+	 * \brief Sets the value for the given role
+	 *
+	 * The role is passed as the template parameter
+	 * \param d the new value for the given role
+	 * \param ignoreCallback if true the callback is not called, otherwise
+	 *                       it is called
+	 */
+	template <class R>
+	void setData(const typename R::RoleType& d, bool ignoreCallback = false)
+	{
+		(static_cast<R*>(this))->fromRoleType(d);
+		if (!ignoreCallback) {
+			roleChanged(getIndex<R>());
+		}
+	}
+
+	/**
+	 * \brief Sets the value for the given role (move version)
+	 *
+	 * The role is passed as the template parameter
+	 * \param d the new value for the given role, which is moved
+	 * \param ignoreCallback if true the callback is not called, otherwise
+	 *                       it is called
+	 */
+	template <class R>
+	void setData(typename R::RoleType&& d, bool ignoreCallback = false)
+	{
+		(static_cast<R*>(this))->fromRoleType(std::move(d));
+		if (!ignoreCallback) {
+			roleChanged(getIndex<R>());
+		}
+	}
+
+	/**
+	 * \brief Resets the values of all roles
+	 *
+	 * If callbacks are not ignored, observers are notified once
+	 * \param ignoreCallback if true observers are not notified
+	 */
+	void reset(bool ignoreCallback)
+	{
+		beginUpdate();
+		RolesListType::resetData();
+		if (!ignoreCallback) {
+			m_changedRoles.set();
+		}
+		commit();
+	}
+
+	/**
+	 * \brief Calls the visitor on each role
+	 *
+	 * The visitor is called as visitor(index, name, value), where value is
+	 * a reference to the data of the role with its native type (use a
+	 * generic lambda to handle all types). Roles are visited in the order
+	 * of the list, which is not the order of indexes. Setting values
+	 * through the reference does not call the callback
+	 * \param visitor the function to call on each role
+	 */
+	template <class Visitor>
+	void visitRoles(Visitor&& visitor)
+	{
+		RolesListType::visitRolesData(visitor, 0);
+	}
+
+	/**
+	 * \brief Calls the visitor on each role (const version)
+	 *
+	 * \param visitor the function to call on each role
+	 */
+	template <class Visitor>
+	void visitRoles(Visitor&& visitor) const
+	{
+		RolesListType::visitRolesData(visitor, 0);
+	}
+
+protected:
+	/**
+	 * \brief The function called when roles change, before observers
+	 *
+	 * Subclasses can override this to keep data derived from roles up to
+	 * date. The default implementation does nothing
+	 * \param changedRoles the set of roles that changed
+	 */
+	virtual void rolesChanged(const ChangedRoles& changedRoles)
+	{
+		Q_UNUSED(changedRoles)
+	}
+
+private:
+	/**
+	 * \brief The function called by roles lists when data changes
+	 *
+	 * \param roleIndex the index of the role that changed
+	 */
+	void roleChanged(int roleIndex) override
+	{
+		if (m_updateDepth > 0) {
+			m_changedRoles.set(roleIndex);
+		} else {
+			ChangedRoles changedRoles;
+			changedRoles.set(roleIndex);
+
+			notifyObservers(changedRoles);
+		}
+	}
+
+	/**
+	 * \brief Notifies the subclass and all observers
+	 *
+	 * \param changedRoles the set of roles that changed
+	 */
+	void notifyObservers(const ChangedRoles& changedRoles)
+	{
+		rolesChanged(changedRoles);
+
+		// Taking the next observer before calling the current one, which is then allowed to
+		// remove itself from the list
+		Observer* o = m_firstObserver;
+		while (o != nullptr) {
+			Observer* const next = o->m_nextObserver;
+			o->rolesChanged(changedRoles);
+			o = next;
+		}
+	}
+
+	/**
+	 * \brief The first observer in the list
+	 */
+	Observer* m_firstObserver;
+
+	/**
+	 * \brief The roles changed during the current transaction
+	 */
+	ChangedRoles m_changedRoles;
+
+	/**
+	 * \brief The number of nested transactions
+	 */
+	int m_updateDepth;
 };
 
 #endif
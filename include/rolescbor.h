@@ -0,0 +1,305 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __ROLES_CBOR_H__
+#define __ROLES_CBOR_H__
+
+#include <QCborStreamWriter>
+#include <QCborStreamReader>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+#include <QDateTime>
+#include "include/roles.h"
+
+/**
+ * \brief The class with functions to write and read roles as CBOR streams
+ *
+ * Roles are written as a CBOR map from role names to values, walking the list
+ * of roles at compile time (see RolesList::visitRoles()): values are written
+ * with their native type, without building QVariants or JSON objects, so
+ * writing a list of roles does not allocate anything besides the output.
+ * Reading is done one key at a time: the name is read in a buffer on the stack
+ * and looked up in the table of role names, then the value is read directly
+ * into the role. Booleans and integers are stored as CBOR booleans and
+ * integers, dates as the number of milliseconds since the epoch (the minimum
+ * qint64 for invalid dates), strings and urls (in encoded form) as text
+ * strings and lists of strings as arrays of text strings. A role of a type not
+ * handled here does not compile
+ */
+class RolesCbor
+{
+public:
+	/**
+	 * \brief Writes all roles as a map
+	 *
+	 * \param writer the CBOR writer
+	 * \param roles the roles to write
+	 */
+	template <class RolesListType>
+	static void write(QCborStreamWriter& writer, const Roles<RolesListType>& roles)
+	{
+		writer.startMap(Roles<RolesListType>::numRoles());
+		roles.visitRoles([&writer](int, const char* name, const auto& value) {
+			writer.append(name);
+			writeValue(writer, value);
+		});
+		writer.endMap();
+	}
+
+	/**
+	 * \brief Writes some roles as a map
+	 *
+	 * \param writer the CBOR writer
+	 * \param roles the roles to write
+	 * \param which the set of roles to write
+	 */
+	template <class RolesListType>
+	static void write(QCborStreamWriter& writer, const Roles<RolesListType>& roles, const typename Roles<RolesListType>::ChangedRoles& which)
+	{
+		writer.startMap(which.count());
+		roles.visitRoles([&writer, &which](int index, const char* name, const auto& value) {
+			if (which.test(index)) {
+				writer.append(name);
+				writeValue(writer, value);
+			}
+		});
+		writer.endMap();
+	}
+
+	/**
+	 * \brief Reads a map of roles
+	 *
+	 * Roles not in the map are left untouched. If callbacks are not
+	 * ignored, observers are notified once with all the roles that have
+	 * been read. Unknown keys and values of the wrong type are skipped
+	 * \param reader the CBOR reader, positioned on the map
+	 * \param roles the roles to set
+	 * \param ignoreCallback if true observers are not notified
+	 * \return false if the stream is not a map, is invalid or contains
+	 *         unknown keys or values of the wrong type
+	 */
+	template <class RolesListType>
+	static bool read(QCborStreamReader& reader, Roles<RolesListType>& roles, bool ignoreCallback)
+	{
+		if (!reader.isMap() || !reader.enterContainer()) {
+			return false;
+		}
+
+		bool ok = true;
+		RolesChangeNotifier& notifier = roles;
+		roles.beginUpdate();
+		while (reader.hasNext() && (reader.lastError() == QCborError::NoError)) {
+			// Reading the key and then the value. Both are always consumed
+			const int index = readRoleIndex<Roles<RolesListType>>(reader);
+			if (index == -1) {
+				reader.next();
+				ok = false;
+
+				continue;
+			}
+
+			bool valueRead = false;
+			roles.visitRoles([&reader, &valueRead, index](int i, const char*, auto& value) {
+				if (i == index) {
+					valueRead = readValue(reader, value);
+				}
+			});
+
+			if (!valueRead) {
+				ok = false;
+			} else if (!ignoreCallback) {
+				notifier.roleChanged(index);
+			}
+		}
+		roles.commit();
+
+		return reader.leaveContainer() && ok;
+	}
+
+	/**
+	 * \brief Writes a boolean
+	 *
+	 * \param writer the CBOR writer
+	 * \param value the value to write
+	 */
+	static void writeValue(QCborStreamWriter& writer, bool value);
+
+	/**
+	 * \brief Writes an unsigned integer
+	 *
+	 * \param writer the CBOR writer
+	 * \param value the value to write
+	 */
+	static void writeValue(QCborStreamWriter& writer, unsigned int value);
+
+	/**
+	 * \brief Writes an integer
+	 *
+	 * \param writer the CBOR writer
+	 * \param value the value to write
+	 */
+	static void writeValue(QCborStreamWriter& writer, int value);
+
+	/**
+	 * \brief Writes a date
+	 *
+	 * \param writer the CBOR writer
+	 * \param value the value to write
+	 */
+	static void writeValue(QCborStreamWriter& writer, const QDateTime& value);
+
+	/**
+	 * \brief Writes a string
+	 *
+	 * \param writer the CBOR writer
+	 * \param value the value to write
+	 */
+	static void writeValue(QCborStreamWriter& writer, const QString& value);
+
+	/**
+	 * \brief Writes an url
+	 *
+	 * \param writer the CBOR writer
+	 * \param value the value to write
+	 */
+	static void writeValue(QCborStreamWriter& writer, const QUrl& value);
+
+	/**
+	 * \brief Writes a list of strings
+	 *
+	 * \param writer the CBOR writer
+	 * \param value the value to write
+	 */
+	static void writeValue(QCborStreamWriter& writer, const QStringList& value);
+
+	/**
+	 * \brief Reads a boolean
+	 *
+	 * The value is always consumed, but it is only stored if it has the
+	 * correct type
+	 * \param reader the CBOR reader
+	 * \param value the variable where the value is put
+	 * \return false if the value has the wrong type
+	 */
+	static bool readValue(QCborStreamReader& reader, bool& value);
+
+	/**
+	 * \brief Reads an unsigned integer
+	 *
+	 * \param reader the CBOR reader
+	 * \param value the variable where the value is put
+	 * \return false if the value has the wrong type
+	 */
+	static bool readValue(QCborStreamReader& reader, unsigned int& value);
+
+	/**
+	 * \brief Reads an integer
+	 *
+	 * \param reader the CBOR reader
+	 * \param value the variable where the value is put
+	 * \return false if the value has the wrong type
+	 */
+	static bool readValue(QCborStreamReader& reader, int& value);
+
+	/**
+	 * \brief Reads a 64 bits integer
+	 *
+	 * \param reader the CBOR reader
+	 * \param value the variable where the value is put
+	 * \return false if the value has the wrong type
+	 */
+	static bool readValue(QCborStreamReader& reader, qint64& value);
+
+	/**
+	 * \brief Reads a date
+	 *
+	 * \param reader the CBOR reader
+	 * \param value the variable where the value is put
+	 * \return false if the value has the wrong type
+	 */
+	static bool readValue(QCborStreamReader& reader, QDateTime& value);
+
+	/**
+	 * \brief Reads a string
+	 *
+	 * \param reader the CBOR reader
+	 * \param value the variable where the value is put
+	 * \return false if the value has the wrong type
+	 */
+	static bool readValue(QCborStreamReader& reader, QString& value);
+
+	/**
+	 * \brief Reads an url
+	 *
+	 * \param reader the CBOR reader
+	 * \param value the variable where the value is put
+	 * \return false if the value has the wrong type
+	 */
+	static bool readValue(QCborStreamReader& reader, QUrl& value);
+
+	/**
+	 * \brief Reads a list of strings
+	 *
+	 * \param reader the CBOR reader
+	 * \param value the variable where the value is put
+	 * \return false if the value has the wrong type
+	 */
+	static bool readValue(QCborStreamReader& reader, QStringList& value);
+
+private:
+	/**
+	 * \brief Reads a key and returns the index of the role with that name
+	 *
+	 * The key is always consumed
+	 * \param reader the CBOR reader
+	 * \return the index of the role or -1 if the key is not the name of a
+	 *         role
+	 */
+	template <class RolesType>
+	static int readRoleIndex(QCborStreamReader& reader)
+	{
+		// Names of roles are short, the key is read in a buffer on the stack
+		char name[maxRoleNameLength];
+		const int length = readKey(reader, name, maxRoleNameLength);
+
+		return (length == -1) ? -1 : RolesType::getRoleIndexFromName(name, length);
+	}
+
+	/**
+	 * \brief Reads a key in the given buffer
+	 *
+	 * The key is always consumed
+	 * \param reader the CBOR reader
+	 * \param buffer the buffer where the key is put (UTF-8, not
+	 *               null-terminated)
+	 * \param bufferSize the size of the buffer
+	 * \return the length of the key or -1 if the key is not a string or
+	 *         is longer than bufferSize
+	 */
+	static int readKey(QCborStreamReader& reader, char* buffer, int bufferSize);
+
+	/**
+	 * \brief The maximum length of names of roles read from streams
+	 */
+	static const int maxRoleNameLength = 64;
+};
+
+#endif
@@ -22,13 +22,16 @@
 #define __ROLES_HELPERS_H__
 
 #include <QVariant>
-#include <QHash>
+#include <QByteArray>
+#include <QString>
 #include <array>
 #include <utility>
 #include <functional>
+#include <type_traits>
 #include "include/utilities.h"
+#include "include/rolenamestable.h"
 
-class RolesCallbackStorage;
+class RolesChangeNotifier;
 template <class>
 class RolesVectors;
 template <class>
@@ -40,7 +43,9 @@ class RolesQMLAccessor;
  * \brief This macro helps in defining a new role
  *
  * By using this you only have to specify the role name and the QVariant
- * function to get the underlying type (e.g. toString, toUrl, toInt...). It is
+ * function to get the underlying type (e.g. toString, toUrl, toInt...). The
+ * value is stored with its native type, the function is only used to convert
+ * from QVariant (e.g. when data comes from QML or JSON). It is
  * advisable to define related roles inside a namespace or class, to avoid
  * polluting the global namespace (remember that each role is a class). The name
  * of the role (as a string) will be the same as the name of the  class, so you
@@ -51,83 +56,48 @@ class RolesQMLAccessor;
 	{\
 	public:\
 		using RoleType = decltype(std::declval<QVariant>().ConversionFunction());\
-		RoleName(int index) : i(index) {}\
-		RoleName(const RoleName& other) : i(other.i), v(other.v) {}\
-		RoleName(RoleName&& other) : i(other.i), v(std::move(other.v)) {}\
-		RoleType toRoleType() const { return v.ConversionFunction(); }\
+		RoleName() : v() {}\
+		RoleName(const RoleName& other) : v(other.v) {}\
+		RoleName(RoleName&& other) : v(std::move(other.v)) {}\
+		const RoleType& toRoleType() const { return v; }\
 		void fromRoleType(const RoleType& d) { v = d; }\
+		void fromRoleType(RoleType&& d) { v = std::move(d); }\
+		QVariant toVariant() const { return QVariant::fromValue(v); }\
+		void fromVariant(const QVariant& d) { v = d.ConversionFunction(); }\
+		void reset() { v = RoleType(); }\
 		static constexpr const char* s = #RoleName;\
-		const int i;\
-		QVariant v;\
+		RoleType v;\
 	};
 
 /**
- * \brief An helper function to call all callbacks with the given role index
+ * \brief The interface of the object notified when data of roles changes
  *
- * \param s the object containing the list of callbacks to call
- * \param roleIndex the index to pass to callbacks
- */
-void callSetDataCallbacks(const RolesCallbackStorage* s, int roleIndex);
-
-/**
- * \brief An helper class storing callbacks used by RolesLists
- *
- * We need this to create the variable of the list of functors before the list
- * of roles (the list take a reference to the list of functors)
+ * The Roles class implements this and calls roleChanged() whenever the
+ * setData function is called (unless callbacks are ignored), RolesVectors
+ * reaches it through the Roles object it is a base of. What to do with the
+ * notification (e.g. collecting changes during a transaction and notifying
+ * observers) is up to the implementation, see the Roles class
  * \warning You should not use this class directly, use the Roles class instead
  */
-class RolesCallbackStorage
+class RolesChangeNotifier
 {
 public:
 	/**
-	 * \brief Constructor
-	 */
-	RolesCallbackStorage();
-
-	/**
-	 * \brief Adds a callback to call when setData of roles is called
-	 *
-	 * \param setDataCallback a function to call when setData() of RolesList
-	 *                        is called. The function must take an int
-	 *                        parameter (the index of the role that has
-	 *                        changed) and return void.
-	 * \return the id of the callback. You need it in case you want to
-	 *         remove the callback
-	 */
-	int addCallbackForSetData(const std::function<void(int)>& setDataCallback);
-
-	/**
-	 * \brief Removes a callback to call when setData of roles is called
+	 * \brief The function called when data of a role changes
 	 *
-	 * \param id the id of the callback to remove (the one returned when
-	 *           addCallbackForSetData was called)
-	 * \return false if no callback with the given id exists, true otherwise
+	 * \param roleIndex the index of the role that changed
 	 */
-	bool removeCallbackForSetData(int id);
+	virtual void roleChanged(int roleIndex) = 0;
 
-private:
+protected:
 	/**
-	 * \brief The function called when the setData function is called
+	 * \brief Destructor
 	 *
-	 * The parameter is the index of the Role that was changed
-	 */
-	QHash<int, std::function<void(int)>> m_setDataCallbacks;
-
-	/**
-	 * \brief The id to use for the next callback
-	 */
-	int m_nextCallbackID;
-
-	/**
-	 * \brief Roles is friend to call access m_setDataCallback
-	 */
-	template <class>
-	friend class Roles;
-
-	/**
-	 * \brief callSetDataCallbacks is friend to access the list of callbacks
+	 * This is protected, objects are never destroyed through this interface
 	 */
-	friend void callSetDataCallbacks(const RolesCallbackStorage* s, int roleIndex);
+	~RolesChangeNotifier()
+	{
+	}
 };
 
 /**
@@ -137,10 +107,13 @@ private:
  * template parameters of this class should only be roles (see the template
  * specializations below for other kinds of parameters). You can access a role
  * index, name or value by using the Role name (i.e. the class name) as template
- * parameter of functions below. The index of roles in each list are consecutive
- * starting at startIndex(). You can register a function to be called whenever
- * the setData function is called. Notice that the function is not called if the
- * value of the role is changed via the vector passed in valuesVector.
+ * parameter of functions below. The index of roles in each list are consecutive.
+ * Values are stored with their native type, QVariants are only built when data
+ * is accessed by index (see RolesVectors). Everything else is computed at
+ * compile time: the index of a role depends only on the type of the outermost
+ * list (see Roles::getIndex()), so lists store nothing but the values of roles.
+ * Setting data and notifying changes is done by the Roles class, which is the
+ * only one knowing the outermost list and the object to notify
  * \warning You should not use this class directly, use the Roles class instead
  */
 template <typename Role_t, typename... OtherRoles>
@@ -160,35 +133,24 @@ public:
 public:
 	/**
 	 * \brief Constructor
-	 *
-	 * \param callbacks the object with all the callbacks
-	 * \param valuesVector this is filled with the data of roles (the value
-	 *                     of the role with index i will be in the vector at
-	 *                     position i)
-	 * \param indexOffset the offset to use for indexes of roles. Always
-	 *                    set to 0 (this is for internal use only)
-	 */
-	RolesList(const RolesCallbackStorage* callbacks, QVariant** valuesVector, int indexOffset = 0)
-		: Role(sizeof...(OtherRoles) + indexOffset)
-		, InnerList(callbacks, valuesVector, indexOffset)
-		, m_startIndex(indexOffset)
-		, m_callbacks(callbacks)
-	{
-		if (valuesVector) {
-			valuesVector[Role::i] = &(Role::v);
-		}
+	 */
+	RolesList()
+		: Role()
+		, InnerList()
+	{
 	}
 
 	/**
-	 * \brief Returns the index of the given role
+	 * \brief Returns the index of the given role inside this list
 	 *
-	 * The role is passed as the template parameter
-	 * \return the index of the given role
+	 * The role is passed as the template parameter. For the outermost list
+	 * this is the index of the role
+	 * \return the index of the given role inside this list
 	 */
 	template <class R>
-	int getIndex() const
+	static constexpr int localIndex()
 	{
-		return (static_cast<const R*>(this))->i;
+		return std::is_same<R, Role>::value ? static_cast<int>(sizeof...(OtherRoles)) : InnerList::template localIndex<R>();
 	}
 
 	/**
@@ -198,38 +160,33 @@ public:
 	 * \return the name of the given role
 	 */
 	template <class R>
-	const char* getName() const
+	static constexpr const char* getName()
 	{
-		return (static_cast<const R*>(this))->s;
+		return R::s;
 	}
 
 	/**
-	 * \brief Returns the value for the given role
+	 * \brief Returns the name of the role with the given index
 	 *
-	 * The role is passed as the template parameter
-	 * \return the value for the given role
+	 * This can be evaluated at compile time
+	 * \param index the index of the role inside this list
+	 * \return the name of the role
 	 */
-	template <class R>
-	typename R::RoleType getData() const
+	static constexpr const char* nameAt(int index)
 	{
-		return (static_cast<const R*>(this))->toRoleType();
+		return (index == localIndex<Role>()) ? Role::s : InnerList::nameAt(index);
 	}
 
 	/**
-	 * \brief Sets the value for the given role
+	 * \brief Returns the value for the given role
 	 *
 	 * The role is passed as the template parameter
-	 * \param d the new value for the given role
-	 * \param ignoreCallback if true the callback is not called, otherwise
-	 *                       it is called
+	 * \return a const reference to the value for the given role
 	 */
 	template <class R>
-	void setData(const typename R::RoleType& d, bool ignoreCallback = false)
+	const typename R::RoleType& getData() const
 	{
-		(static_cast<R*>(this))->fromRoleType(d);
-		if (!ignoreCallback) {
-			callSetDataCallbacks(m_callbacks, getIndex<R>());
-		}
+		return (static_cast<const R*>(this))->toRoleType();
 	}
 
 	/**
@@ -243,89 +200,137 @@ public:
 	}
 
 	/**
-	 * \brief Returns the start index for roles in this list
+	 * \brief Copies the data for all roles from the other list
 	 *
-	 * \return the start index for roles in this list
+	 * \param other the list to copy
 	 */
-	int startIndex() const
+	void copyDataFromOtherRolesList(const RolesList<Role, OtherRoles...>& other)
 	{
-		return m_startIndex;
+		Role::v = (static_cast<const Role&>(other)).v;
+		InnerList::copyDataFromOtherRolesList(other);
 	}
 
 	/**
-	 * \brief Copies the data for all roles from the other list
+	 * \brief Moves the data for all roles from the other list
 	 *
-	 * \param other the list to copy
+	 * Values are moved, so nothing is copied or allocated. The other list
+	 * is left with unspecified (but valid) values, reset it before
+	 * using it again
+	 * \param other the list whose data is moved here
 	 */
-	void copyDataFromOtherRolesList(const RolesList<Role, OtherRoles...>& other)
+	void moveDataFromOtherRolesList(RolesList<Role, OtherRoles...>&& other)
 	{
-		Role::v = (static_cast<const Role&>(other)).v;
-		InnerList::copyDataFromOtherRolesList(other);
+		Role::v = std::move((static_cast<Role&>(other)).v);
+		InnerList::moveDataFromOtherRolesList(std::move(other));
 	}
 
 	/**
 	 * \brief Resets the values of all roles
 	 *
-	 * \param ignoreCallback if true the callback is not called, otherwise
-	 *                       it is called for each role
+	 * Nobody is notified, see Roles::reset()
 	 */
-	void reset(bool ignoreCallback)
+	void resetData()
 	{
-		Role::v = QVariant();
-		if (!ignoreCallback) {
-			callSetDataCallbacks(m_callbacks, Role::i);
-		}
-		InnerList::reset(ignoreCallback);
+		Role::reset();
+		InnerList::resetData();
+	}
+
+protected:
+	/**
+	 * \brief Calls the visitor on each role of the list
+	 *
+	 * See Roles::visitRoles() for the description of the visitor
+	 * \param visitor the function to call on each role
+	 * \param offset the index of the first role of this list
+	 */
+	template <class Visitor>
+	void visitRolesData(Visitor&& visitor, int offset)
+	{
+		visitor(offset + localIndex<Role>(), Role::s, Role::v);
+		InnerList::visitRolesData(visitor, offset);
+	}
+
+	/**
+	 * \brief Calls the visitor on each role of the list (const version)
+	 *
+	 * \param visitor the function to call on each role
+	 * \param offset the index of the first role of this list
+	 */
+	template <class Visitor>
+	void visitRolesData(Visitor&& visitor, int offset) const
+	{
+		visitor(offset + localIndex<Role>(), Role::s, Role::v);
+		InnerList::visitRolesData(visitor, offset);
 	}
 
 private:
+
 	/**
-	 * \brief The starting index for roles in this list
+	 * \brief The function to fill the array of functions returning data as
+	 *        QVariant
+	 *
+	 * The functions take the complete list (of type FullList), putting
+	 * them at the correct index
+	 * \param getters the array of functions returning a QVariant
+	 * \param offset the start index of this list
 	 */
-	const int m_startIndex;
+	template <class FullList, class GettersArray>
+	static void fillVariantGetters(GettersArray& getters, int offset)
+	{
+		getters[offset + localIndex<Role>()] = &getVariant<FullList>;
+		InnerList::template fillVariantGetters<FullList>(getters, offset);
+	}
 
 	/**
-	 * \brief The object with all the callbacks
+	 * \brief The function to fill the array of functions setting data from
+	 *        QVariant
+	 *
+	 * The functions take the complete list (of type FullList), putting
+	 * them at the correct index
+	 * \param setters the array of functions setting data from a QVariant
+	 * \param offset the start index of this list
 	 */
-	const RolesCallbackStorage* m_callbacks;
+	template <class FullList, class SettersArray>
+	static void fillVariantSetters(SettersArray& setters, int offset)
+	{
+		setters[offset + localIndex<Role>()] = &setVariant<FullList>;
+		InnerList::template fillVariantSetters<FullList>(setters, offset);
+	}
 
 	/**
-	 * \brief The function to fill the array with names of roles
+	 * \brief Returns the value of the role of this level as a QVariant
 	 *
-	 * This function takes an array of const char* and fills it with the
-	 * name of roles, putting names at the correct index
-	 * \param a the array to fill
+	 * \param l the complete list
+	 * \return the value of the role
 	 */
-	template <class Array>
-	void fillNameArray(Array& a)
+	template <class FullList>
+	static QVariant getVariant(const FullList& l)
 	{
-		a[Role::i] = Role::s;
-		this->InnerList::fillNameArray(a);
+		return static_cast<const RolesList<Role_t, OtherRoles...>&>(l).Role::toVariant();
 	}
 
 	/**
-	 * \brief The function to fill the map of role names to indexes
+	 * \brief Sets the value of the role of this level from a QVariant
 	 *
-	 * This function takes a map of strings to integers and fills it with
-	 * the name of roles and the corresponding role index
-	 * \param a the array to fill
+	 * \param l the complete list
+	 * \param value the value to set
 	 */
-	void fillNameIndexMap(QHash<QByteArray, int>& h)
+	template <class FullList>
+	static void setVariant(FullList& l, const QVariant& value)
 	{
-		h[Role::s] = Role::i;
-		this->InnerList::fillNameIndexMap(h);
+		static_cast<RolesList<Role_t, OtherRoles...>&>(l).Role::fromVariant(value);
 	}
 
 	/**
-	 * \brief RolesVector is friend to call fillNameArray() and
-	 *        fillNameIndexMap()
+	 * \brief RolesVector is friend to call fillVariantGetters() and
+	 *        fillVariantSetters()
 	 */
 	template <class>
 	friend class RolesVectors;
 
 	/**
 	 * \brief All RolesList template specializations are friend to call
-	 *        fillNameArray() and fillNameIndexMap()
+	 *        fillVariantGetters() and fillVariantSetters()
 	 */
 	template <typename, typename...>
 	friend class RolesList;
@@ -349,34 +354,23 @@ public:
 public:
 	/**
 	 * \brief Constructor
-	 *
-	 * \param callbacks the object with all the callbacks
-	 * \param valuesVector this is filled with the data of roles (the value
-	 *                     of the role with index i will be in the vector at
-	 *                     position i)
-	 * \param indexOffset the offset to use for indexes of roles. Always
-	 *                    set to 0 (this is for intenal use only)
 	 */
-	RolesList(const RolesCallbackStorage* callbacks, QVariant** valuesVector, int indexOffset = 0)
-		: Role(0 + indexOffset)
-		, m_startIndex(indexOffset)
-		, m_callbacks(callbacks)
+	RolesList()
+		: Role()
 	{
-		if (valuesVector) {
-			valuesVector[Role::i] = &(Role::v);
-		}
 	}
 
 	/**
-	 * \brief Returns the index of the given role
+	 * \brief Returns the index of the given role inside this list
 	 *
 	 * The role is passed as the template parameter
-	 * \return the index of the given role
+	 * \return the index of the given role inside this list or -1 if the
+	 *         role is not in the list
 	 */
 	template <class R>
-	int getIndex() const
+	static constexpr int localIndex()
 	{
-		return (static_cast<const R*>(this))->i;
+		return std::is_same<R, Role>::value ? 0 : -1;
 	}
 
 	/**
@@ -386,38 +380,33 @@ public:
 	 * \return the name of the given role
 	 */
 	template <class R>
-	const char* getName() const
+	static constexpr const char* getName()
 	{
-		return (static_cast<const R*>(this))->s;
+		return R::s;
 	}
 
 	/**
-	 * \brief Returns the value for the given role
+	 * \brief Returns the name of the role with the given index
 	 *
-	 * The role is passed as the template parameter
-	 * \return the value for the given role
+	 * This can be evaluated at compile time
+	 * \param index the index of the role inside this list
+	 * \return the name of the role
 	 */
-	template <class R>
-	typename R::RoleType getData() const
+	static constexpr const char* nameAt(int index)
 	{
-		return (static_cast<const R*>(this))->toRoleType();
+		return (index == 0) ? Role::s : nullptr;
 	}
 
 	/**
-	 * \brief Sets the value for the given role
+	 * \brief Returns the value for the given role
 	 *
 	 * The role is passed as the template parameter
-	 * \param d the new value for the given role
-	 * \param ignoreCallback if true the callback is not called, otherwise
-	 *                       it is called
+	 * \return a const reference to the value for the given role
 	 */
 	template <class R>
-	void setData(const typename R::RoleType& d, bool ignoreCallback = false)
+	const typename R::RoleType& getData() const
 	{
-		(static_cast<R*>(this))->fromRoleType(d);
-		if (!ignoreCallback) {
-			callSetDataCallbacks(m_callbacks, getIndex<R>());
-		}
+		return (static_cast<const R*>(this))->toRoleType();
 	}
 
 	/**
@@ -431,85 +420,130 @@ public:
 	}
 
 	/**
-	 * \brief Returns the start index for roles in this list
+	 * \brief Copies the data for all roles from the other list
 	 *
-	 * \return the start index for roles in this list
+	 * \param other the list to copy
 	 */
-	int startIndex() const
+	void copyDataFromOtherRolesList(const RolesList<Role>& other)
 	{
-		return m_startIndex;
+		Role::v = (static_cast<const Role&>(other)).v;
 	}
 
 	/**
-	 * \brief Copies the data for all roles from the other list
+	 * \brief Moves the data for all roles from the other list
 	 *
-	 * \param other the list to copy
+	 * Values are moved, so nothing is copied or allocated. The other list
+	 * is left with unspecified (but valid) values, reset it before
+	 * using it again
+	 * \param other the list whose data is moved here
 	 */
-	void copyDataFromOtherRolesList(const RolesList<Role>& other)
+	void moveDataFromOtherRolesList(RolesList<Role>&& other)
 	{
-		Role::v = (static_cast<const Role&>(other)).v;
+		Role::v = std::move((static_cast<Role&>(other)).v);
 	}
 
 	/**
 	 * \brief Resets the values of all roles
 	 *
-	 * \param ignoreCallback if true the callback is not called, otherwise
-	 *                       it is called for each role
+	 * Nobody is notified, see Roles::reset()
 	 */
-	void reset(bool ignoreCallback)
+	void resetData()
 	{
-		Role::v = QVariant();
-		if (!ignoreCallback) {
-			callSetDataCallbacks(m_callbacks, Role::i);
-		}
+		Role::reset();
+	}
+
+protected:
+	/**
+	 * \brief Calls the visitor on each role of the list
+	 *
+	 * See Roles::visitRoles() for the description of the visitor
+	 * \param visitor the function to call on each role
+	 * \param offset the index of the first role of this list
+	 */
+	template <class Visitor>
+	void visitRolesData(Visitor&& visitor, int offset)
+	{
+		visitor(offset, Role::s, Role::v);
+	}
+
+	/**
+	 * \brief Calls the visitor on each role of the list (const version)
+	 *
+	 * \param visitor the function to call on each role
+	 * \param offset the index of the first role of this list
+	 */
+	template <class Visitor>
+	void visitRolesData(Visitor&& visitor, int offset) const
+	{
+		visitor(offset, Role::s, Role::v);
 	}
 
 private:
+
 	/**
-	 * \brief The starting index for roles in this list
+	 * \brief The function to fill the array of functions returning data as
+	 *        QVariant
+	 *
+	 * The functions take the complete list (of type FullList), putting
+	 * them at the correct index
+	 * \param getters the array of functions returning a QVariant
+	 * \param offset the start index of this list
 	 */
-	const int m_startIndex;
+	template <class FullList, class GettersArray>
+	static void fillVariantGetters(GettersArray& getters, int offset)
+	{
+		getters[offset] = &getVariant<FullList>;
+	}
 
 	/**
-	 * \brief The object with all the callbacks
+	 * \brief The function to fill the array of functions setting data from
+	 *        QVariant
+	 *
+	 * The functions take the complete list (of type FullList), putting
+	 * them at the correct index
+	 * \param setters the array of functions setting data from a QVariant
+	 * \param offset the start index of this list
 	 */
-	const RolesCallbackStorage* m_callbacks;
+	template <class FullList, class SettersArray>
+	static void fillVariantSetters(SettersArray& setters, int offset)
+	{
+		setters[offset] = &setVariant<FullList>;
+	}
 
 	/**
-	 * \brief The function to fill the array with names of roles
+	 * \brief Returns the value of the role of this level as a QVariant
 	 *
-	 * This function takes an array of const char* and fills it with the
-	 * name of roles, putting names at the correct index
-	 * \param a the array to fill
+	 * \param l the complete list
+	 * \return the value of the role
 	 */
-	template <class Array>
-	void fillNameArray(Array& a)
+	template <class FullList>
+	static QVariant getVariant(const FullList& l)
 	{
-		a[Role::i] = Role::s;
+		return static_cast<const RolesList<Role_t>&>(l).Role::toVariant();
 	}
 
 	/**
-	 * \brief The function to fill the map of role names to indexes
+	 * \brief Sets the value of the role of this level from a QVariant
 	 *
-	 * This function takes a map of strings to integers and fills it with
-	 * the name of roles and the corresponding role index
-	 * \param a the array to fill
+	 * \param l the complete list
+	 * \param value the value to set
 	 */
-	void fillNameIndexMap(QHash<QByteArray, int>& h)
+	template <class FullList>
+	static void setVariant(FullList& l, const QVariant& value)
 	{
-		h[Role::s] = Role::i;
+		static_cast<RolesList<Role_t>&>(l).Role::fromVariant(value);
 	}
 
 	/**
-	 * \brief RolesVector is friend to call fillNameArray() and
-	 *        fillNameIndexMap()
+	 * \brief RolesVector is friend to call fillVariantGetters() and
+	 *        fillVariantSetters()
 	 */
 	template <class>
 	friend class RolesVectors;
 
 	/**
 	 * \brief All RolesList template specializations are friend to call
-	 *        fillNameArray() and fillNameIndexMap()
+	 *        fillVariantGetters() and fillVariantSetters()
 	 */
 	template <typename, typename...>
 	friend class RolesList;
@@ -520,7 +554,8 @@ private:
  *
  * This is the template specialization that can be used to merge two lists. This
  * only works with RolesLists, if you want to add one Role, wrap it in a
- * RolesList.
+ * RolesList. This has no data of its own, functions are forwarded to the list
+ * containing the role
  */
 template <typename... RolesFirstList, typename... RolesSecondList>
 class RolesList<RolesList<RolesFirstList...>, RolesList<RolesSecondList...>> : public RolesList<RolesFirstList...>, public RolesList<RolesSecondList...>
@@ -536,35 +571,33 @@ public:
 	 */
 	using SecondList = RolesList<RolesSecondList...>;
 
+	/**
+	 * \brief A typedef for the list containing the role R
+	 */
+	template <class R>
+	using ListWithRole = typename std::conditional<std::is_base_of<R, FirstList>::value, FirstList, SecondList>::type;
+
 public:
 	/**
 	 * \brief Constructor
-	 *
-	 * \param callbacks the object with all the callbacks
-	 * \param valuesVector this is filled with the data of roles (the value
-	 *                     of the role with index i will be in the vector at
-	 *                     position i)
-	 * \param indexOffset the offset to use for indexes of roles. Always
-	 *                    set to 0 (this is for intenal use only)
 	 */
-	RolesList(const RolesCallbackStorage* callbacks, QVariant** valuesVector, int indexOffset = 0)
-		: FirstList(callbacks, valuesVector, 0 + indexOffset)
-		, SecondList(callbacks, valuesVector, FirstList::numRoles() + indexOffset)
-		, m_startIndex(indexOffset)
-		, m_callbacks(callbacks)
+	RolesList()
+		: FirstList()
+		, SecondList()
 	{
 	}
 
 	/**
-	 * \brief Returns the index of the given role
+	 * \brief Returns the index of the given role inside this list
 	 *
-	 * The role is passed as the template parameter
-	 * \return the index of the given role
+	 * The role is passed as the template parameter. For the outermost list
+	 * this is the index of the role
+	 * \return the index of the given role inside this list
 	 */
 	template <class R>
-	int getIndex() const
+	static constexpr int localIndex()
 	{
-		return (static_cast<const R*>(this))->i;
+		return std::is_base_of<R, FirstList>::value ? FirstList::template localIndex<R>() : (FirstList::numRoles() + SecondList::template localIndex<R>());
 	}
 
 	/**
@@ -574,38 +607,33 @@ public:
 	 * \return the name of the given role
 	 */
 	template <class R>
-	const char* getName() const
+	static constexpr const char* getName()
 	{
-		return (static_cast<const R*>(this))->s;
+		return R::s;
 	}
 
 	/**
-	 * \brief Returns the value for the given role
+	 * \brief Returns the name of the role with the given index
 	 *
-	 * The role is passed as the template parameter
-	 * \return the value for the given role
+	 * This can be evaluated at compile time
+	 * \param index the index of the role inside this list
+	 * \return the name of the role
 	 */
-	template <class R>
-	typename R::RoleType getData() const
+	static constexpr const char* nameAt(int index)
 	{
-		return (static_cast<const R*>(this))->toRoleType();
+		return (index < FirstList::numRoles()) ? FirstList::nameAt(index) : SecondList::nameAt(index - FirstList::numRoles());
 	}
 
 	/**
-	 * \brief Sets the value for the given role
+	 * \brief Returns the value for the given role
 	 *
 	 * The role is passed as the template parameter
-	 * \param d the new value for the given role
-	 * \param ignoreCallback if true the callback is not called, otherwise
-	 *                       it is called
+	 * \return a const reference to the value for the given role
 	 */
 	template <class R>
-	void setData(const typename R::RoleType& d, bool ignoreCallback = false)
+	const typename R::RoleType& getData() const
 	{
-		(static_cast<R*>(this))->fromRoleType(d);
-		if (!ignoreCallback) {
-			callSetDataCallbacks(m_callbacks, getIndex<R>());
-		}
+		return ListWithRole<R>::template getData<R>();
 	}
 
 	/**
@@ -619,86 +647,114 @@ public:
 	}
 
 	/**
-	 * \brief Returns the start index for roles in this list
+	 * \brief Copies the data for all roles from the other list
 	 *
-	 * \return the start index for roles in this list
+	 * \param other the list to copy
 	 */
-	int startIndex() const
+	void copyDataFromOtherRolesList(const RolesList<RolesList<RolesFirstList...>, RolesList<RolesSecondList...>>& other)
 	{
-		return m_startIndex;
+		FirstList::copyDataFromOtherRolesList(other);
+		SecondList::copyDataFromOtherRolesList(other);
 	}
 
 	/**
-	 * \brief Copies the data for all roles from the other list
+	 * \brief Moves the data for all roles from the other list
 	 *
-	 * \param other the list to copy
+	 * Values are moved, so nothing is copied or allocated. The other list
+	 * is left with unspecified (but valid) values, reset it before
+	 * using it again
+	 * \param other the list whose data is moved here
 	 */
-	void copyDataFromOtherRolesList(const RolesList<RolesList<RolesFirstList...>, RolesList<RolesSecondList...>>& other)
+	void moveDataFromOtherRolesList(RolesList<RolesList<RolesFirstList...>, RolesList<RolesSecondList...>>&& other)
 	{
-		FirstList::copyDataFromOtherList(other);
-		SecondList::copyDataFromOtherList(other);
+		// The two lists are distinct subobjects, moving from other twice is safe
+		FirstList::moveDataFromOtherRolesList(std::move(other));
+		SecondList::moveDataFromOtherRolesList(std::move(other));
 	}
 
 	/**
 	 * \brief Resets the values of all roles
 	 *
-	 * \param ignoreCallback if true the callback is not called, otherwise
-	 *                       it is called for each role
+	 * Nobody is notified, see Roles::reset()
 	 */
-	void reset(bool ignoreCallback)
+	void resetData()
 	{
-		FirstList::reset(ignoreCallback);
-		SecondList::reset(ignoreCallback);
+		FirstList::resetData();
+		SecondList::resetData();
 	}
 
-private:
+protected:
 	/**
-	 * \brief The starting index for roles in this list
+	 * \brief Calls the visitor on each role of the list
+	 *
+	 * See Roles::visitRoles() for the description of the visitor
+	 * \param visitor the function to call on each role
+	 * \param offset the index of the first role of this list
 	 */
-	const int m_startIndex;
+	template <class Visitor>
+	void visitRolesData(Visitor&& visitor, int offset)
+	{
+		FirstList::visitRolesData(visitor, offset);
+		SecondList::visitRolesData(visitor, offset + FirstList::numRoles());
+	}
 
 	/**
-	 * \brief The object with all the callbacks
+	 * \brief Calls the visitor on each role of the list (const version)
+	 *
+	 * \param visitor the function to call on each role
+	 * \param offset the index of the first role of this list
 	 */
-	const RolesCallbackStorage* m_callbacks;
+	template <class Visitor>
+	void visitRolesData(Visitor&& visitor, int offset) const
+	{
+		FirstList::visitRolesData(visitor, offset);
+		SecondList::visitRolesData(visitor, offset + FirstList::numRoles());
+	}
+
+private:
 
 	/**
-	 * \brief The function to fill the array with names of roles
+	 * \brief The function to fill the array of functions returning data as
+	 *        QVariant
 	 *
-	 * This function takes an array of const char* and fills it with the
-	 * name of roles, putting names at the correct index
-	 * \param a the array to fill
+	 * The functions take the complete list (of type FullList), putting
+	 * them at the correct index
+	 * \param getters the array of functions returning a QVariant
+	 * \param offset the start index of this list
 	 */
-	template <class Array>
-	void fillNameArray(Array& a)
+	template <class FullList, class GettersArray>
+	static void fillVariantGetters(GettersArray& getters, int offset)
 	{
-		this->FirstList::fillNameArray(a);
-		this->SecondList::fillNameArray(a);
+		FirstList::template fillVariantGetters<FullList>(getters, offset);
+		SecondList::template fillVariantGetters<FullList>(getters, offset + FirstList::numRoles());
 	}
 
 	/**
-	 * \brief The function to fill the map of role names to indexes
+	 * \brief The function to fill the array of functions setting data from
+	 *        QVariant
 	 *
-	 * This function takes a map of strings to integers and fills it with
-	 * the name of roles and the corresponding role index
-	 * \param a the array to fill
+	 * The functions take the complete list (of type FullList), putting
+	 * them at the correct index
+	 * \param setters the array of functions setting data from a QVariant
+	 * \param offset the start index of this list
 	 */
-	void fillNameIndexMap(QHash<QByteArray, int>& h)
+	template <class FullList, class SettersArray>
+	static void fillVariantSetters(SettersArray& setters, int offset)
 	{
-		this->FirstList::fillNameIndexMap(h);
-		this->SecondList::fillNameIndexMap(h);
+		FirstList::template fillVariantSetters<FullList>(setters, offset);
+		SecondList::template fillVariantSetters<FullList>(setters, offset + FirstList::numRoles());
 	}
 
 	/**
-	 * \brief RolesVector is friend to call fillNameArray() and
-	 *        fillNameIndexMap()
+	 * \brief RolesVector is friend to call fillVariantGetters() and
+	 *        fillVariantSetters()
 	 */
 	template <class>
 	friend class RolesVectors;
 
 	/**
 	 * \brief All RolesList template specializations are friend to call
-	 *        fillNameArray() and fillNameIndexMap()
+	 *        fillVariantGetters() and fillVariantSetters()
 	 */
 	template <typename, typename...>
 	friend class RolesList;
@@ -707,26 +763,36 @@ private:
 /**
  * \brief A class with additional data structures for faster access to roles
  *
- * This contains data structures for faster access to roles. This should be
- * constructed before a RolesList (this means that if you inherit from both this
- * and RolesList, this should come before RolesList in the list of inherited
- * classes) and its members should be passed to the RolesList constructor. The
- * rolesValue array is initialized when the RolesList is constructed, while the
- * rolesNames array and the rolesNamesToIndex map are const static members.
+ * This contains data structures to access roles by index. Roles store data with
+ * their native type, here we have the tables of functions converting data of
+ * the role with a given index from and to QVariant (used at the boundaries with
+ * QML and JSON) and the table of role names (a perfect hash built at compile
+ * time, see RoleNamesTable). Tables are const static members, so they take no
+ * space in instances. Looking up the index of a role by name does not allocate:
+ * callers needing the same role many times (e.g. from QML) should look up the
+ * index once and use it afterwards. This must only be used as a base of Roles,
+ * which also inherits from RoleListType and RolesChangeNotifier.
  * \warning You should not use this class directly, use the Roles class
  */
 template <class RoleListType>
 class RolesVectors
 {
+private:
+	/**
+	 * \brief The type of functions returning data of a role as a QVariant
+	 */
+	using VariantGetter = QVariant (*)(const RoleListType&);
+
+	/**
+	 * \brief The type of functions setting data of a role from a QVariant
+	 */
+	using VariantSetter = void (*)(RoleListType&, const QVariant&);
+
 public:
 	/**
 	 * \brief Constructor
-	 *
-	 * \param callbacks the object with all the callbacks
 	 */
-	RolesVectors(const RolesCallbackStorage* callbacks)
-		: m_roleValues()
-		, m_callbacks(callbacks)
+	RolesVectors()
 	{
 	}
 
@@ -738,7 +804,30 @@ public:
 	 */
 	static const char* getRoleNameFromIndex(int index)
 	{
-		return m_roleNames[index];
+		return m_roleNamesTable.name(index);
+	}
+
+	/**
+	 * \brief Returns the index of the role with the given name
+	 *
+	 * \param name the name of the role
+	 * \param length the length of the name
+	 * \return the index of the role or -1 if no role exists with that name
+	 */
+	static int getRoleIndexFromName(const char* name, int length)
+	{
+		return m_roleNamesTable.index(name, length);
+	}
+
+	/**
+	 * \brief Returns the index of the role with the given name
+	 *
+	 * \param name the name of the role (null-terminated)
+	 * \return the index of the role or -1 if no role exists with that name
+	 */
+	static int getRoleIndexFromName(const char* name)
+	{
+		return m_roleNamesTable.index(name, static_cast<int>(qstrlen(name)));
 	}
 
 	/**
@@ -749,24 +838,38 @@ public:
 	 */
 	static int getRoleIndexFromName(const QByteArray& name)
 	{
-		return m_roleNamesToIndex.value(name, -1);
+		return m_roleNamesTable.index(name.constData(), name.size());
+	}
+
+	/**
+	 * \brief Returns the index of the role with the given name
+	 *
+	 * The name is not converted, the lookup uses the UTF-16 data directly
+	 * \param name the name of the role
+	 * \return the index of the role or -1 if no role exists with that name
+	 */
+	static int getRoleIndexFromName(const QString& name)
+	{
+		return m_roleNamesTable.index(name.utf16(), name.size());
 	}
 
 protected:
 	/**
 	 * \brief Returns data as QVariant for the given role
 	 *
+	 * The QVariant is built from the data of the role
 	 * \param index the index of the role for which to return data
-	 * \return a const reference to QVariant data for the role
+	 * \return QVariant data for the role
 	 */
-	const QVariant& getVariantData(int index) const
+	QVariant getVariantData(int index) const
 	{
-		return *(m_roleValues[index]);
+		return m_variantGetters[index](static_cast<const Roles<RoleListType>&>(*this));
 	}
 
 	/**
 	 * \brief Sets data from a QVariant for the given role
 	 *
+	 * The QVariant is converted to the type of the role
 	 * \param index the index of the role to modify
 	 * \param value the value to set
 	 * \param ignoreCallback if true the callback is not called, otherwise
@@ -774,68 +877,59 @@ protected:
 	 */
 	void setVariantData(int index, const QVariant& value, bool ignoreCallback = false)
 	{
-		*(m_roleValues[index]) = value;
+		m_variantSetters[index](static_cast<Roles<RoleListType>&>(*this), value);
 		if (!ignoreCallback) {
-			callSetDataCallbacks(m_callbacks, index);
+			RolesChangeNotifier* const notifier = static_cast<Roles<RoleListType>*>(this);
+			notifier->roleChanged(index);
 		}
 	}
 
 private:
 	/**
-	 * \brief Generates the array of roles names
+	 * \brief Generates the array of functions returning data as QVariant
 	 *
-	 * \return the array of roles names
+	 * \return the array of functions returning data as QVariant
 	 */
-	static std::array<const char*, RoleListType::numRoles()> generateRoleNames()
+	static std::array<VariantGetter, RoleListType::numRoles()> generateVariantGetters()
 	{
-		// The simplest way of filling the vector is to generate a list and call its
-		// functions. We can set parameters to nullptr, we are sure not to dereference them
-		RoleListType l(nullptr, nullptr);
-		std::array<const char*, RoleListType::numRoles()> a;
+		std::array<VariantGetter, RoleListType::numRoles()> getters;
 
-		l.fillNameArray(a);
+		RoleListType::template fillVariantGetters<RoleListType>(getters, 0);
 
-		return a;
+		return getters;
 	}
 
 	/**
-	 * \brief Generates the map of roles names to indexes
+	 * \brief Generates the array of functions setting data from QVariant
 	 *
-	 * \return the map of roles names to indexes
+	 * \return the array of functions setting data from QVariant
 	 */
-	static QHash<QByteArray, int> generateRoleNamesToIndex()
+	static std::array<VariantSetter, RoleListType::numRoles()> generateVariantSetters()
 	{
-		// The simplest way of filling the vector is to generate a list and call its
-		// functions. We can set parameters to nullptr, we are sure not to dereference them
-		RoleListType l(nullptr, nullptr);
-		QHash<QByteArray, int> h;
+		std::array<VariantSetter, RoleListType::numRoles()> setters;
 
-		l.fillNameIndexMap(h);
+		RoleListType::template fillVariantSetters<RoleListType>(setters, 0);
 
-		return h;
+		return setters;
 	}
 
 	/**
-	 * \brief The vector of pointers to values of roles
+	 * \brief The table with names of roles, built at compile time
 	 */
-	std::array<QVariant*, RoleListType::numRoles()> m_roleValues;
+	static constexpr RoleNamesTable<RoleListType> m_roleNamesTable{};
 
-	/**
-	 * \brief The vector of pointers to names of roles
-	 */
-	static const std::array<const char*, RoleListType::numRoles()> m_roleNames;
+	// The table is built at compile time, this should never fail
+	static_assert(m_roleNamesTable.isValid(), "Cannot build the table of role names");
 
 	/**
-	 * \brief The dictionary with indexes for role names
+	 * \brief The functions returning data of roles as QVariant
 	 */
-	static const QHash<QByteArray, int> m_roleNamesToIndex;
+	static const std::array<VariantGetter, RoleListType::numRoles()> m_variantGetters;
 
 	/**
-	 * \brief The object with all the callbacks
-	 *
-	 * Callbacks is called when setVariantData is called
+	 * \brief The functions setting data of roles from QVariant
 	 */
-	const RolesCallbackStorage* m_callbacks;
+	static const std::array<VariantSetter, RoleListType::numRoles()> m_variantSetters;
 
 	/**
 	 * \brief Roles is friend to call access m_rolesValues
@@ -850,12 +944,16 @@ private:
 	friend class RolesQMLAccessor;
 };
 
-// Definition of the array with roles names
+// Definition of the table with roles names
+template <class RoleListType>
+constexpr RoleNamesTable<RoleListType> RolesVectors<RoleListType>::m_roleNamesTable;
+
+// Definition of the array of functions returning data as QVariant
 template <class RoleListType>
-const std::array<const char*, RoleListType::numRoles()> RolesVectors<RoleListType>::m_roleNames(generateRoleNames());
+const std::array<typename RolesVectors<RoleListType>::VariantGetter, RoleListType::numRoles()> RolesVectors<RoleListType>::m_variantGetters(generateVariantGetters());
 
-// Definition of the map from role names to indexes
+// Definition of the array of functions setting data from QVariant
 template <class RoleListType>
-const QHash<QByteArray, int> RolesVectors<RoleListType>::m_roleNamesToIndex(generateRoleNamesToIndex());
+const std::array<typename RolesVectors<RoleListType>::VariantSetter, RoleListType::numRoles()> RolesVectors<RoleListType>::m_variantSetters(generateVariantSetters());
 
 #endif
@@ -72,6 +72,26 @@ public:
 	 */
 	Q_INVOKABLE virtual QVariant roleValue(QByteArray roleName) = 0;
 
+	/**
+	 * \brief Returns the index of a role
+	 *
+	 * The index can be used with roleValueAt() and setRoleValueAt() to
+	 * avoid looking up the name every time. Indexes are the same for all
+	 * objects with the same type of roles (e.g. all news of a channel)
+	 * \param roleName the name of the role
+	 * \return the index of the role or -1 if the role does not exists
+	 */
+	Q_INVOKABLE virtual int roleIndex(QByteArray roleName) = 0;
+
+	/**
+	 * \brief Returns the value of a role given its index
+	 *
+	 * \param roleIndex the index of the role (see roleIndex())
+	 * \return the value of a role. An invalid value is returned if the
+	 *         role does not exists
+	 */
+	Q_INVOKABLE virtual QVariant roleValueAt(int roleIndex) = 0;
+
 public slots:
 	/**
 	 * \brief Sets the value of a role
@@ -82,6 +102,15 @@ public slots:
 	 */
 	virtual bool setRoleValue(QByteArray roleName, QVariant value) = 0;
 
+	/**
+	 * \brief Sets the value of a role given its index
+	 *
+	 * \param roleIndex the index of the role (see roleIndex())
+	 * \param value the new value of the role
+	 * \return false if the role doesn't exists
+	 */
+	virtual bool setRoleValueAt(int roleIndex, QVariant value) = 0;
+
 signals:
 	/**
 	 * \brief The signal emitted when a role changes
@@ -112,7 +141,7 @@ protected:
  *                 properties are not seen from QML...
  */
 template<class RolesType>
-class RolesQMLAccessor : public AbstractRolesQMLAccessor
+class RolesQMLAccessor : public AbstractRolesQMLAccessor, private RolesType::Observer
 {
 public:
 	/**
@@ -138,6 +167,23 @@ public:
 	 */
 	virtual QVariant roleValue(QByteArray roleName) override;
 
+	/**
+	 * \brief Returns the index of a role
+	 *
+	 * \param roleName the name of the role
+	 * \return the index of the role or -1 if the role does not exists
+	 */
+	virtual int roleIndex(QByteArray roleName) override;
+
+	/**
+	 * \brief Returns the value of a role given its index
+	 *
+	 * \param roleIndex the index of the role
+	 * \return the value of a role. An invalid value is returned if the
+	 *         role does not exists
+	 */
+	virtual QVariant roleValueAt(int roleIndex) override;
+
 	/**
 	 * \brief Sets the value of a role
 	 *
@@ -147,26 +193,39 @@ public:
 	 */
 	virtual bool setRoleValue(QByteArray roleName, QVariant value) override;
 
-private:
 	/**
-	 * \brief The function called when a role in the wrapped roles list
-	 *        changes
+	 * \brief Sets the value of a role given its index
+	 *
+	 * \param roleIndex the index of the role
+	 * \param value the new value of the role
+	 * \return false if the role doesn't exists
+	 */
+	virtual bool setRoleValueAt(int roleIndex, QVariant value) override;
+
+	/**
+	 * \brief Makes this object expose the roles of another object
 	 *
-	 * This syncs the dynamic property associated to the role that changed
-	 * \param roleIndex the index of the role that has changed
+	 * The roleChanged signal is emitted for all roles, so that QML
+	 * refreshes bindings. Use this to keep the same QObject (e.g. the one
+	 * held by a view) when the object with roles is replaced
+	 * \param rolesObj the object whose roles will be exposed from now on
 	 */
-	void roleDataChanged(int roleIndex);
+	void rebind(RolesType* rolesObj);
 
+private:
 	/**
-	 * \brief The object whose roles we expose as dynamic properties
+	 * \brief The function called when roles in the wrapped roles list
+	 *        change
+	 *
+	 * This emits the roleChanged signal for each role that changed
+	 * \param changedRoles the set of roles that changed
 	 */
-	RolesType* const m_rolesObj;
+	void rolesChanged(const typename RolesType::ChangedRoles& changedRoles) override;
 
 	/**
-	 * \brief The id of the callback we register (to remove it in the
-	 *        destructor)
+	 * \brief The object whose roles we expose as dynamic properties
 	 */
-	const int m_callbackId;
+	RolesType* m_rolesObj;
 };
 
 // Implementation of template functions
@@ -174,24 +233,35 @@ private:
 template<class RolesType>
 RolesQMLAccessor<RolesType>::RolesQMLAccessor(RolesType* rolesObj, QObject* parent)
 	: AbstractRolesQMLAccessor(parent)
+	, RolesType::Observer()
 	, m_rolesObj(rolesObj)
-	, m_callbackId(m_rolesObj->addCallbackForSetData([this](int roleIndex) { this->roleDataChanged(roleIndex); }))
 {
+	m_rolesObj->addObserver(this);
 }
 
 template<class RolesType>
 RolesQMLAccessor<RolesType>::~RolesQMLAccessor()
 {
-	// Removing the callback
-	m_rolesObj->removeCallbackForSetData(m_callbackId);
+	// Removing ourself from the observers
+	m_rolesObj->removeObserver(this);
 }
 
 template<class RolesType>
 QVariant RolesQMLAccessor<RolesType>::roleValue(QByteArray roleName)
 {
-	const int roleIndex = m_rolesObj->getRoleIndexFromName(roleName);
+	return roleValueAt(roleIndex(roleName));
+}
 
-	if (roleIndex == -1) {
+template<class RolesType>
+int RolesQMLAccessor<RolesType>::roleIndex(QByteArray roleName)
+{
+	return m_rolesObj->getRoleIndexFromName(roleName);
+}
+
+template<class RolesType>
+QVariant RolesQMLAccessor<RolesType>::roleValueAt(int roleIndex)
+{
+	if ((roleIndex < 0) || (roleIndex >= RolesType::numRoles())) {
 		return QVariant();
 	} else {
 		return m_rolesObj->getVariantData(roleIndex);
@@ -200,14 +270,18 @@ QVariant RolesQMLAccessor<RolesType>::roleValue(QByteArray roleName)
 
 template<class RolesType>
 bool RolesQMLAccessor<RolesType>::setRoleValue(QByteArray roleName, QVariant value)
+{
+	return setRoleValueAt(roleIndex(roleName), value);
+}
+
+template<class RolesType>
+bool RolesQMLAccessor<RolesType>::setRoleValueAt(int roleIndex, QVariant value)
 {
 	if (m_qmlReadOnlyRoles) {
 		return false;
 	}
 
-	const int roleIndex = m_rolesObj->getRoleIndexFromName(roleName);
-
-	if (roleIndex == -1) {
+	if ((roleIndex < 0) || (roleIndex >= RolesType::numRoles())) {
 		return false;
 	}
 
@@ -220,15 +294,31 @@ bool RolesQMLAccessor<RolesType>::setRoleValue(QByteArray roleName, QVariant val
 	// changing and can emit the signal by ourself
 	m_rolesObj->setVariantData(roleIndex, value, true);
 
-	emit roleChanged(roleName);
+	emit roleChanged(m_rolesObj->getRoleNameFromIndex(roleIndex));
 
 	return true;
 }
 
 template<class RolesType>
-void RolesQMLAccessor<RolesType>:: roleDataChanged(int roleIndex)
+void RolesQMLAccessor<RolesType>::rebind(RolesType* rolesObj)
 {
-	emit roleChanged(m_rolesObj->getRoleNameFromIndex(roleIndex));
+	m_rolesObj->removeObserver(this);
+	m_rolesObj = rolesObj;
+	m_rolesObj->addObserver(this);
+
+	for (unsigned int i = 0; i < RolesType::numRoles(); ++i) {
+		emit roleChanged(RolesType::getRoleNameFromIndex(i));
+	}
+}
+
+template<class RolesType>
+void RolesQMLAccessor<RolesType>::rolesChanged(const typename RolesType::ChangedRoles& changedRoles)
+{
+	for (int i = 0; i < RolesType::numRoles(); ++i) {
+		if (changedRoles.test(i)) {
+			emit roleChanged(m_rolesObj->getRoleNameFromIndex(i));
+		}
+	}
 }
 
 #endif
@@ -0,0 +1,241 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __SLAB_POOL_H__
+#define __SLAB_POOL_H__
+
+#include <QVector>
+#include <QtGlobal>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * \brief A pool allocating objects of type T in contiguous slabs
+ *
+ * Objects are constructed in slabs of slabSize elements, so that creating many
+ * objects does not require one allocation for each of them and objects created
+ * one after the other are close in memory. The memory of destroyed objects is
+ * reused for the next ones. Objects are owned by handles (a unique_ptr with a
+ * deleter that gives the memory back to the pool): when the handle is
+ * destroyed, the object is destroyed too. A handle can release the pointer
+ * (e.g. to store it in a container that cannot hold move-only types) and the
+ * pointer can then be given back to a handle with adopt(). All objects must
+ * be destroyed before the pool. This class is not thread-safe
+ */
+template <class T, int slabSize = 64>
+class SlabPool
+{
+	static_assert(slabSize > 0, "The size of slabs must be positive");
+
+private:
+	/**
+	 * \brief The storage for a single object
+	 *
+	 * When the object is not alive, the storage holds the pointer to the
+	 * next free element
+	 */
+	union Slot {
+		/**
+		 * \brief The storage for the object
+		 */
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type object;
+
+		/**
+		 * \brief The next free slot or nullptr
+		 */
+		Slot* nextFree;
+	};
+
+public:
+	/**
+	 * \brief The deleter used by handles
+	 */
+	class Deleter
+	{
+	public:
+		/**
+		 * \brief Constructor
+		 *
+		 * \param pool the pool the object belongs to
+		 */
+		Deleter(SlabPool<T, slabSize>* pool = nullptr)
+			: m_pool(pool)
+		{
+		}
+
+		/**
+		 * \brief Destroys the object and gives memory back to the pool
+		 *
+		 * \param obj the object to destroy
+		 */
+		void operator()(T* obj) const
+		{
+			m_pool->destroy(obj);
+		}
+
+	private:
+		/**
+		 * \brief The pool the object belongs to
+		 */
+		SlabPool<T, slabSize>* m_pool;
+	};
+
+	/**
+	 * \brief The handle owning an object of the pool
+	 */
+	using Handle = std::unique_ptr<T, Deleter>;
+
+public:
+	/**
+	 * \brief Constructor
+	 */
+	SlabPool()
+		: m_slabs()
+		, m_firstFree(nullptr)
+		, m_numAlive(0)
+	{
+	}
+
+	/**
+	 * \brief Destructor
+	 *
+	 * This only releases memory, all objects must have been destroyed
+	 */
+	~SlabPool()
+	{
+		Q_ASSERT(m_numAlive == 0);
+
+		for (auto s: m_slabs) {
+			delete[] s;
+		}
+	}
+
+	/**
+	 * \brief Copy constructor is deleted
+	 */
+	SlabPool(const SlabPool<T, slabSize>&) = delete;
+
+	/**
+	 * \brief Copy operator is deleted
+	 */
+	SlabPool& operator=(const SlabPool<T, slabSize>&) = delete;
+
+	/**
+	 * \brief Constructs a new object in the pool
+	 *
+	 * \param args the arguments for the constructor of T
+	 * \return the handle owning the new object
+	 */
+	template <class... Args>
+	Handle create(Args&&... args)
+	{
+		if (m_firstFree == nullptr) {
+			addSlab();
+		}
+
+		// The object overwrites the pointer to the next free slot, reading it before. The list of
+		// free slots is only updated after the constructor succeeded
+		Slot* const slot = m_firstFree;
+		Slot* const nextFree = slot->nextFree;
+		T* const obj = new (&(slot->object)) T(std::forward<Args>(args)...);
+
+		m_firstFree = nextFree;
+		++m_numAlive;
+
+		return Handle(obj, Deleter(this));
+	}
+
+	/**
+	 * \brief Returns a handle for an object of the pool
+	 *
+	 * Use this to give back ownership of an object whose handle released
+	 * the pointer
+	 * \param obj the object, it must have been created by this pool
+	 * \return the handle owning the object
+	 */
+	Handle adopt(T* obj)
+	{
+		return Handle(obj, Deleter(this));
+	}
+
+	/**
+	 * \brief Returns the number of objects alive
+	 *
+	 * \return the number of objects alive
+	 */
+	int numAlive() const
+	{
+		return m_numAlive;
+	}
+
+private:
+	/**
+	 * \brief Destroys an object and puts its slot in the free list
+	 *
+	 * \param obj the object to destroy
+	 */
+	void destroy(T* obj)
+	{
+		if (obj == nullptr) {
+			return;
+		}
+
+		obj->~T();
+
+		Slot* const slot = reinterpret_cast<Slot*>(obj);
+		slot->nextFree = m_firstFree;
+		m_firstFree = slot;
+		--m_numAlive;
+	}
+
+	/**
+	 * \brief Allocates a new slab and puts all its slots in the free list
+	 */
+	void addSlab()
+	{
+		Slot* const slab = new Slot[slabSize];
+		m_slabs.append(slab);
+
+		// Adding slots in reverse order, so that they are used in memory order
+		for (int i = slabSize - 1; i >= 0; --i) {
+			slab[i].nextFree = m_firstFree;
+			m_firstFree = &(slab[i]);
+		}
+	}
+
+	/**
+	 * \brief The slabs
+	 */
+	QVector<Slot*> m_slabs;
+
+	/**
+	 * \brief The first free slot or nullptr if all slots are used
+	 */
+	Slot* m_firstFree;
+
+	/**
+	 * \brief The number of objects alive
+	 */
+	int m_numAlive;
+};
+
+#endif
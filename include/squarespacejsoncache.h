@@ -0,0 +1,197 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __SQUARESPACE_JSON_CACHE_H__
+#define __SQUARESPACE_JSON_CACHE_H__
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QUrl>
+#include <QJsonObject>
+#include <functional>
+#include "include/dataavailablenotifee.h"
+#include "include/utilities.h"
+
+/**
+ * \brief The class caching items of Squarespace collections
+ *
+ * www.ilribelle.com and raz24 are built with Squarespace, which returns a JSON
+ * representation of collections and items when "format=json" is added to the
+ * query of the url. The JSON of a collection contains many items, each with the
+ * html of its body. This class downloads the collection containing an item
+ * only once and keeps all its items, so that news of the same collection can
+ * be completed without downloading their pages. Collections are downloaded at
+ * most once per refresh: call invalidate() when news are refreshed. Use the
+ * SquarespaceCache alias to access the unique instance of this class
+ * \warning This class is not thread-safe nor reentrant
+ */
+class SquarespaceJsonCache : private AllDataArrivedNotifee
+{
+public:
+	/**
+	 * \brief Constructor
+	 */
+	SquarespaceJsonCache();
+
+	/**
+	 * \brief Destructor
+	 */
+	virtual ~SquarespaceJsonCache();
+
+	/**
+	 * \brief Returns the JSON item for the page with the given url
+	 *
+	 * If the collection of the item has already been downloaded, the
+	 * callback is called immediately, otherwise it is called when the
+	 * collection has been downloaded. The callback is called with an empty
+	 * object if the item could not be found. Call cancel() with the same
+	 * id if the callback must not be called anymore
+	 * \param id the id of the request (e.g. the news id). Only one request
+	 *           for each id can be pending
+	 * \param itemUrl the url of the page of the item
+	 * \param callback the function to call with the item
+	 */
+	void item(unsigned int id, const QUrl& itemUrl, const std::function<void(QJsonObject)>& callback);
+
+	/**
+	 * \brief Cancels a pending request
+	 *
+	 * Does nothing if there is no pending request with the given id
+	 * \param id the id of the request
+	 */
+	void cancel(unsigned int id);
+
+	/**
+	 * \brief Removes all downloaded collections
+	 *
+	 * Collections are downloaded again the next time they are needed
+	 */
+	void invalidate();
+
+	/**
+	 * \brief Returns the url of the JSON representation of a page
+	 *
+	 * \param url the url of the page
+	 * \return the url of the JSON representation of the page
+	 */
+	static QUrl jsonUrl(const QUrl& url);
+
+	/**
+	 * \brief Returns the body of an item
+	 *
+	 * \param data the JSON representation of an item page
+	 * \return the html of the body or an empty string if data is not a
+	 *         valid item
+	 */
+	static QString itemBody(const QByteArray& data);
+
+private:
+	/**
+	 * \brief The function called when all data has been received
+	 *
+	 * \param id the request ID
+	 * \param data the data that has just arrived
+	 */
+	virtual void allDataArrived(int id, const QByteArray& data) override;
+
+	/**
+	 * \brief The function called after the request is completed
+	 *
+	 * Here we call the callbacks of pending requests, both in case of
+	 * success and in case of network errors
+	 * \param id the ID of the request that has finished
+	 */
+	virtual void requestCompleted(int id) override;
+
+	/**
+	 * \brief Returns the url of the collection of an item
+	 *
+	 * This is the first component of the path of the item url
+	 * \param itemUrl the url of the page of the item
+	 * \return the url of the collection or an invalid url if itemUrl has
+	 *         no path
+	 */
+	static QUrl collectionUrl(const QUrl& itemUrl);
+
+	/**
+	 * \brief The structure with a request waiting for a collection
+	 */
+	struct PendingRequest {
+		/**
+		 * \brief The id of the request
+		 */
+		unsigned int id;
+
+		/**
+		 * \brief The path of the item
+		 */
+		QString itemPath;
+
+		/**
+		 * \brief The callback to call with the item
+		 */
+		std::function<void(QJsonObject)> callback;
+	};
+
+	/**
+	 * \brief The structure with a collection
+	 */
+	struct Collection {
+		/**
+		 * \brief True if the collection has been downloaded (possibly
+		 *        with errors)
+		 */
+		bool downloaded;
+
+		/**
+		 * \brief The items of the collection, the key is the path of the
+		 *        item page
+		 */
+		QHash<QString, QJsonObject> items;
+
+		/**
+		 * \brief The requests waiting for the collection
+		 */
+		QList<PendingRequest> pendingRequests;
+	};
+
+	/**
+	 * \brief The collections, the key is the collection url
+	 */
+	QHash<QUrl, Collection> m_collections;
+
+	/**
+	 * \brief The map from network request ids to collection urls
+	 */
+	QHash<int, QUrl> m_requests;
+
+	/**
+	 * \brief The id of the next network request
+	 */
+	int m_nextRequestId;
+};
+
+/**
+ * \brief A simple alias to access the unique SquarespaceJsonCache instance
+ */
+using SquarespaceCache = Singleton<SquarespaceJsonCache>;
+
+#endif
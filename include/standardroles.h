@@ -74,6 +74,11 @@ namespace NewsRoles {
 	 */
 	DEFINE_ROLE(permalink, toUrl)
 
+	/**
+	 * \brief The string uniquely identifying the news in the feed
+	 */
+	DEFINE_ROLE(guid, toString)
+
 	/**
 	 * \brief Indicates when the news was published
 	 */
@@ -99,6 +104,26 @@ namespace NewsRoles {
 	 * \brief Whether the news is complete
 	 */
 	DEFINE_ROLE(complete, toBool)
+
+	/**
+	 * \brief The list of files downloaded on request of the user (e.g.
+	 *        audio resources). They are not stored in the data directory
+	 *        and are kept when the news is completed again
+	 */
+	DEFINE_ROLE(downloadedFiles, toStringList)
+
+	/**
+	 * \brief The last time the news was read or its media was played
+	 */
+	DEFINE_ROLE(lastAccess, toDateTime)
+
+	/**
+	 * \brief Whether attached files have been removed to free space
+	 *
+	 * If true the news is not complete and is only completed again when
+	 * needed (e.g. when it is visible)
+	 */
+	DEFINE_ROLE(attachmentsEvicted, toBool)
 }
 
 /**
@@ -106,7 +131,13 @@ namespace NewsRoles {
  *
  * All news must have these roles
  */
-using StandardNewsRoles = RolesList<NewsRoles::title, NewsRoles::link, NewsRoles::description, NewsRoles::authorEMail, NewsRoles::categories, NewsRoles::enclosureUrl, NewsRoles::enclosureLength, NewsRoles::enclosureType, NewsRoles::permalink, NewsRoles::pubDate, NewsRoles::creator, NewsRoles::qmlItem, NewsRoles::attachedFiles, NewsRoles::complete>;
+using StandardNewsRoles = RolesList<NewsRoles::title, NewsRoles::link, NewsRoles::description, NewsRoles::authorEMail, NewsRoles::categories, NewsRoles::enclosureUrl, NewsRoles::enclosureLength, NewsRoles::enclosureType, NewsRoles::permalink, NewsRoles::guid, NewsRoles::pubDate, NewsRoles::creator, NewsRoles::qmlItem, NewsRoles::attachedFiles, NewsRoles::complete, NewsRoles::downloadedFiles, NewsRoles::lastAccess, NewsRoles::attachmentsEvicted>;
+
+// Lists of roles must only store the values of roles, indexes are computed at compile time and
+// changes are notified by the Roles object (see Roles)
+static_assert(sizeof(RolesList<NewsRoles::title>) == sizeof(NewsRoles::title), "A list with one role must only contain its value");
+static_assert(sizeof(RolesList<NewsRoles::title, NewsRoles::link>) == (sizeof(NewsRoles::title) + sizeof(NewsRoles::link)), "A list of roles must only contain the values of roles");
+static_assert(sizeof(RolesList<RolesList<NewsRoles::title>, RolesList<NewsRoles::link>>) == (sizeof(NewsRoles::title) + sizeof(NewsRoles::link)), "Merged lists of roles must only contain the values of roles");
 
 /**
  * \brief The namespace with standard roles for channels
@@ -0,0 +1,268 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#ifndef __STORAGE_QUOTA_H__
+#define __STORAGE_QUOTA_H__
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QThreadPool>
+#include <array>
+#include <functional>
+#include <memory>
+
+/**
+ * \brief The class keeping files of news within a storage budget
+ *
+ * Files belonging to news are of two types: files attached to the news (e.g.
+ * images, see the attachedFiles role) and files downloaded on request of the
+ * user (e.g. audio resources, see the downloadedFiles role). Each type has its
+ * own quota in bytes. check() measures the size of all files of the given news
+ * in a separate thread (sizes of files that have already been measured are
+ * cached, files are never modified once written) and chooses the files to
+ * evict to stay under the quotas: news are taken from the least recently
+ * accessed one, only news marked as evictable are considered. The callback
+ * receives the list of evictions in the main thread, removing the files is up
+ * to the caller. The bytes used by each type of files (once evictions have
+ * been done) are available with usedBytes() after the first check. Only one
+ * check can run at a time
+ */
+class StorageQuota
+{
+public:
+	/**
+	 * \brief The types of files
+	 */
+	enum FileType {
+		AttachedFiles = 0,
+		DownloadedFiles = 1
+	};
+
+	/**
+	 * \brief The number of types of files
+	 */
+	static const int numFileTypes = 2;
+
+	/**
+	 * \brief The type with a number of bytes for each type of files
+	 */
+	using Bytes = std::array<qint64, numFileTypes>;
+
+	/**
+	 * \brief The files of a news
+	 */
+	struct NewsFiles {
+		/**
+		 * \brief The id of the news
+		 */
+		unsigned int id;
+
+		/**
+		 * \brief The last time the news was accessed in milliseconds
+		 *        since the epoch
+		 */
+		qint64 lastAccess;
+
+		/**
+		 * \brief If false files of the news are never evicted
+		 */
+		bool evictable;
+
+		/**
+		 * \brief The absolute paths of the files of each type
+		 */
+		std::array<QStringList, numFileTypes> files;
+	};
+
+	/**
+	 * \brief The files of a news that have to be evicted
+	 */
+	struct Eviction {
+		/**
+		 * \brief The id of the news
+		 */
+		unsigned int id;
+
+		/**
+		 * \brief The type of files to evict
+		 */
+		FileType type;
+	};
+
+	/**
+	 * \brief The type of the function called when a check has finished
+	 */
+	using Callback = std::function<void(const QList<Eviction>&)>;
+
+public:
+	/**
+	 * \brief Constructor
+	 */
+	StorageQuota();
+
+	/**
+	 * \brief Destructor
+	 *
+	 * This waits for a running check to finish, its callback is not called
+	 */
+	~StorageQuota();
+
+	/**
+	 * \brief Copy constructor is disabled
+	 */
+	StorageQuota(const StorageQuota&) = delete;
+
+	/**
+	 * \brief Copy operator is disabled
+	 */
+	StorageQuota& operator=(const StorageQuota&) = delete;
+
+	/**
+	 * \brief Starts checking files against quotas
+	 *
+	 * This does nothing if a check is already running
+	 * \param news the files of all news
+	 * \param quotas the maximum number of bytes for each type of files. If
+	 *               0 there is no limit
+	 * \param callback the function called in the main thread with the
+	 *                 files to evict
+	 */
+	void check(QVector<NewsFiles> news, Bytes quotas, Callback callback);
+
+	/**
+	 * \brief Returns true if a check is running
+	 *
+	 * \return true if a check is running
+	 */
+	bool isChecking() const
+	{
+		return bool(m_check);
+	}
+
+	/**
+	 * \brief Returns the number of bytes used by a type of files
+	 *
+	 * This is the value computed by the last check, once files have been
+	 * evicted
+	 * \param type the type of files
+	 * \return the number of bytes used by files of the given type
+	 */
+	qint64 usedBytes(FileType type) const
+	{
+		return m_usedBytes[type];
+	}
+
+private:
+	/**
+	 * \brief The state of a check
+	 *
+	 * This is shared between the main thread and the thread doing the
+	 * check. The thread only uses it until the event to end the check is
+	 * posted
+	 */
+	struct Check {
+		/**
+		 * \brief The object that started the check
+		 */
+		StorageQuota* storageQuota;
+
+		/**
+		 * \brief The files of all news
+		 */
+		QVector<NewsFiles> news;
+
+		/**
+		 * \brief The quota for each type of files
+		 */
+		Bytes quotas;
+
+		/**
+		 * \brief The function to call when the check finishes
+		 */
+		Callback callback;
+
+		/**
+		 * \brief The size of files, by absolute path
+		 *
+		 * This is the cache of the previous check when the check starts,
+		 * it only contains the files that still exist at the end
+		 */
+		QHash<QString, qint64> fileSizes;
+
+		/**
+		 * \brief The bytes used by each type of files once evictions have
+		 *        been done
+		 */
+		Bytes usedBytes;
+
+		/**
+		 * \brief The files to evict
+		 */
+		QList<Eviction> evictions;
+
+		/**
+		 * \brief This is set to true in the main thread if the result of
+		 *        the check must be ignored
+		 */
+		bool cancelled;
+	};
+
+	/**
+	 * \brief Measures files and chooses the ones to evict
+	 *
+	 * This is called by the thread of m_pool. When done the main thread is
+	 * asked to call checkFinished()
+	 * \param check the state of the check
+	 */
+	static void measureAndEvict(const std::shared_ptr<Check>& check);
+
+	/**
+	 * \brief Stores the result of a check and calls the callback
+	 *
+	 * \param check the state of the check
+	 */
+	void checkFinished(const std::shared_ptr<Check>& check);
+
+	/**
+	 * \brief The thread doing checks
+	 */
+	QThreadPool m_pool;
+
+	/**
+	 * \brief The check that is running, if any
+	 */
+	std::shared_ptr<Check> m_check;
+
+	/**
+	 * \brief The size of files measured by the last check, by absolute
+	 *        path
+	 */
+	QHash<QString, qint64> m_fileSizes;
+
+	/**
+	 * \brief The bytes used by each type of files after the last check
+	 */
+	Bytes m_usedBytes;
+};
+
+#endif
@@ -27,6 +27,7 @@
 #include <QByteArray>
 #include <QEvent>
 #include <QObject>
+#include <QRunnable>
 #include <functional>
 #include <memory>
 #include <type_traits>
@@ -257,6 +258,40 @@ private:
 	std::function<void()> m_command;
 };
 
+/**
+ * \brief A runnable executing a command
+ *
+ * This is a QRunnable that carries a std::function<void()> object, executed by
+ * run(). Use it to execute commands in a QThreadPool. The object is deleted by
+ * the pool once the command has been executed
+ */
+class CommandRunnable : public QRunnable
+{
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * \param command the command to execute
+	 */
+	CommandRunnable(const std::function<void()>& command);
+
+	/**
+	 * \brief Destructor
+	 */
+	virtual ~CommandRunnable() = default;
+
+	/**
+	 * \brief Executes the command carried by this object
+	 */
+	virtual void run() override;
+
+private:
+	/**
+	 * \brief The command carried by this object
+	 */
+	std::function<void()> m_command;
+};
+
 /**
  * \brief The class receiving and handling command events
  *
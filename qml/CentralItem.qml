@@ -58,7 +58,10 @@ StackView {
 		id: listOfNews
 		visible: true
 
-		onNewsClicked: centralItem.push({item: news.roleValue("qmlItem"), properties: {news: news}})
+		onNewsClicked: {
+			newsAccessed(news.roleValue("link"))
+			centralItem.push({item: news.roleValue("qmlItem"), properties: {news: news}})
+		}
 	}
 
 	AboutScreen {
@@ -118,6 +118,7 @@ CentralSubItem {
 			onLoaded: {
 				item.remoteUrl = newsDetail.news.roleValue("audioResourceUrl")
 				item.filePath = newsDetail.news.roleValue("audioResourcePath")
+				item.playbackStarted.connect(function() { newsAccessed(newsDetail.news.roleValue("link")) })
 
 				item.color = "white"
 				height = item.height
@@ -143,13 +144,14 @@ CentralSubItem {
 		// Cycling all iframe urls and checking what type of links they are
 		var youtubeLinks = [];
 		var otherLinks = [];
-		var numIframes = news.roleValue("iframeUrls").length;
+		var iframeUrls = news.roleValue("iframeUrls");
+		var numIframes = iframeUrls.length;
 		for (var i = 0; i < numIframes; i++) {
 			var youtubePattern = new RegExp("^https?://www.youtube.com")
-			if (youtubePattern.test(news.roleValue("iframeUrls")[i])) {
-				youtubeLinks[youtubeLinks.length] = news.roleValue("iframeUrls")[i];
+			if (youtubePattern.test(iframeUrls[i])) {
+				youtubeLinks[youtubeLinks.length] = iframeUrls[i];
 			} else {
-				otherLinks[youtubeLinks.length] = news.roleValue("iframeUrls")[i];
+				otherLinks[youtubeLinks.length] = iframeUrls[i];
 			}
 		}
 
@@ -188,9 +190,14 @@ CentralSubItem {
 		console.log("Sharing Failed!")
 	}
 
-	// We need to connect signals from Facebook and Twitter
+	// We need to connect signals from Facebook and Twitter. We also pin the
+	// news so that the model doesn't reuse it for another news while we
+	// show it
 	Component.onCompleted: {
 		MiscNative.operationDone.connect(sharingOk)
 		MiscNative.error.connect(sharingFailed)
+		newsModel.pinAccessor(news)
 	}
+
+	Component.onDestruction: newsModel.unpinAccessor(news)
 }
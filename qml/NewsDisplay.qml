@@ -49,4 +49,9 @@ CentralSubItem {
 			}
 		}
 	}
+
+	// Pinning the news so that the model doesn't reuse it for another news
+	// while we show it
+	Component.onCompleted: newsModel.pinAccessor(news)
+	Component.onDestruction: newsModel.unpinAccessor(news)
 }
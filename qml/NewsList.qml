@@ -42,6 +42,54 @@ CentralSubItem {
 			// This property stores the item that has changed color
 			property var itemChangedColor: null
 
+			// The news the user clicked before it was complete. It
+			// is shown as soon as it is completed. Use
+			// setPendingNews() to change it, the accessor is pinned
+			// so that the model doesn't recycle it
+			property var pendingNews: null
+
+			// Replaces the pending news, pinning the new one and
+			// unpinning the old one
+			function setPendingNews(news)
+			{
+				if (news !== null) {
+					newsModel.pinAccessor(news)
+				}
+				if (pendingNews !== null) {
+					newsModel.unpinAccessor(pendingNews)
+				}
+
+				pendingNews = news
+			}
+
+			Component.onDestruction: setPendingNews(null)
+
+			// Telling the model which news are visible, so that they
+			// are completed first. We use a timer to avoid flooding
+			// the model while the list is scrolled
+			Timer {
+				id: visibleRangeTimer
+				interval: 200
+
+				onTriggered: {
+					var first = listOfNewsView.indexAt(0, listOfNewsView.contentY)
+					var last = listOfNewsView.indexAt(0, listOfNewsView.contentY + listOfNewsView.height - 1)
+
+					if (first === -1) {
+						first = 0
+					}
+					if (last === -1) {
+						last = listOfNewsView.count - 1
+					}
+
+					newsModel.setVisibleRange(first, last)
+				}
+			}
+
+			onContentYChanged: visibleRangeTimer.restart()
+			onHeightChanged: visibleRangeTimer.restart()
+			onCountChanged: visibleRangeTimer.restart()
+
 			// When the list becomes visible, we reset the color of
 			// the delegate which changed color before
 			onVisibleChanged: {
@@ -61,6 +109,21 @@ CentralSubItem {
 				// The size of borders
 				property real containersBorders: width * 0.02
 
+				// This is needed to know when the news becomes
+				// complete. If the user clicked on the news before,
+				// we show it now
+				property bool newsComplete: complete
+
+				onNewsCompleteChanged: {
+					if (newsComplete && (listOfNewsView.pendingNews !== null) && (listOfNewsView.pendingNews === model.roles)) {
+						listOfNewsView.setPendingNews(null)
+
+						if (listOfNews.visible && mouseAreasEnabled) {
+							listOfNews.newsClicked(model.roles)
+						}
+					}
+				}
+
 				Rectangle {
 					id: titleRectangle
 					x: (parent.width - width) / 2
@@ -94,13 +157,21 @@ CentralSubItem {
 				MouseArea {
 					anchors.fill: parent
 
-					// We enable clicking on the news only after it has been comepleted
-					enabled: complete && mouseAreasEnabled
+					enabled: mouseAreasEnabled
 
+					// If the news is not complete yet, we ask to
+					// complete it immediately and show it when done
 					onClicked: {
 						titleRectangle.color = titleRectangle.selectedColor
 						listOfNewsView.itemChangedColor = titleRectangle
-						listOfNews.newsClicked(model.roles)
+
+						if (complete) {
+							listOfNewsView.setPendingNews(null)
+							listOfNews.newsClicked(model.roles)
+						} else {
+							listOfNewsView.setPendingNews(model.roles)
+							newsModel.requestNewsCompletion(index)
+						}
 					}
 				}
 			}
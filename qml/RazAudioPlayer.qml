@@ -42,6 +42,9 @@ Rectangle {
 	// The signal emitted when there is an error
 	signal error(string reason)
 
+	// The signal emitted when the user starts playing the audio resource
+	signal playbackStarted()
+
 	// A dummy button (never shown), just to get the default height
 	Button {
 		id: dummyButton
@@ -254,6 +257,7 @@ Rectangle {
 							player.pause()
 						} else {
 							player.play()
+							mainItem.playbackStarted()
 						}
 					}
 				}
@@ -0,0 +1,516 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#include "include/channeljournal.h"
+#include "include/channel.h"
+#include "include/rolescbor.h"
+#include <QMutexLocker>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QtEndian>
+#include <QDebug>
+#include <array>
+
+namespace {
+	// The magic number at the beginning of the journal
+	const quint32 journalMagic = 0x434e5249; // "IRNC" in little endian
+	// The size of the journal header (magic and generation)
+	const int journalHeaderSize = 8;
+	// The size of the header of a record (payload size, type and CRC-32 of the payload)
+	const int recordHeaderSize = 9;
+	// The magic number at the beginning of the snapshot
+	const quint32 snapshotMagic = 0x33534e49; // "INS3" in little endian
+	// The size of the snapshot header (magic, generation, size of data and CRC-32 of data)
+	const int snapshotHeaderSize = 16;
+
+	// Builds the table used to compute the CRC-32 (the one of zlib and IEEE 802.3, with the
+	// reflected polynomial 0xEDB88320)
+	std::array<quint32, 256> crc32Table()
+	{
+		std::array<quint32, 256> table;
+
+		for (quint32 i = 0; i < 256; ++i) {
+			quint32 c = i;
+			for (int k = 0; k < 8; ++k) {
+				c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+			}
+			table[i] = c;
+		}
+
+		return table;
+	}
+
+	// Returns the CRC-32 of data. This is much stronger than the 16 bits checksum of qChecksum(),
+	// which would let through one damaged snapshot or record in 65536
+	quint32 crc32(const uchar* data, qint64 size)
+	{
+		static const std::array<quint32, 256> table = crc32Table();
+
+		quint32 crc = 0xFFFFFFFFu;
+		for (qint64 i = 0; i < size; ++i) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+
+		return crc ^ 0xFFFFFFFFu;
+	}
+}
+
+void ChannelJournal::writeKey(QCborStreamWriter& writer, const NewsSortKey& key)
+{
+	writer.startArray(2);
+	writer.append(key.pubDate());
+	writer.append(key.title());
+	writer.endArray();
+}
+
+bool ChannelJournal::readKey(QCborStreamReader& reader, NewsSortKey& key)
+{
+	if (!reader.isArray() || !reader.enterContainer()) {
+		return false;
+	}
+
+	qint64 pubDate;
+	QString title;
+	if (!RolesCbor::readValue(reader, pubDate) || !RolesCbor::readValue(reader, title) || reader.hasNext()) {
+		return false;
+	}
+
+	key = NewsSortKey(pubDate, title);
+
+	return reader.leaveContainer();
+}
+
+ChannelJournal::ChannelJournal(QString snapshotFile, QString journalFile)
+	: QThread()
+	, m_snapshotFile(snapshotFile)
+	, m_mappedSnapshot(snapshotFile)
+	, m_journalFile(journalFile)
+	, m_generation(0)
+	, m_journalSize(0)
+	, m_changesSinceCompaction(0)
+	, m_jobs()
+	, m_writing(false)
+	, m_stop(false)
+	, m_mutex()
+	, m_waitCondition()
+	, m_flushedCondition()
+{
+	// Creating the directories of the files, if they don't exist
+	for (const auto& f: {m_snapshotFile, journalFile}) {
+		const QString dir = QFileInfo(f).absolutePath();
+
+		if (!QFileInfo(dir).exists() && !QDir().mkpath(dir)) {
+			qDebug() << "Cannot create directory" << dir << "data will not be stored";
+		}
+	}
+}
+
+ChannelJournal::~ChannelJournal()
+{
+	// Nothing to do here
+}
+
+void ChannelJournal::restore(AbstractChannel* channel)
+{
+	// Loading the snapshot first, the journal is replayed afterwards
+	loadSnapshot(channel);
+}
+
+void ChannelJournal::finishRestore(AbstractChannel* channel, bool snapshotLoaded)
+{
+	// The snapshot is not needed anymore
+	m_mappedSnapshot.close();
+
+	// Now replaying the journal. Only the part that could be read is kept
+	bool dataFound = snapshotLoaded;
+	const qint64 validSize = replayJournal(channel);
+	if (validSize > journalHeaderSize) {
+		dataFound = true;
+	}
+	if ((validSize > 0) && (validSize < QFileInfo(m_journalFile.fileName()).size())) {
+		QFile::resize(m_journalFile.fileName(), validSize);
+	}
+
+	// Opening the journal for writing. If it could not be used, starting a new one
+	if (!m_journalFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+		qDebug() << "Cannot open the journal" << m_journalFile.fileName() << "changes will not be stored";
+	} else if (validSize == 0) {
+		resetJournal();
+	}
+
+	{
+		QMutexLocker locker(&m_mutex);
+		m_journalSize = m_journalFile.size();
+		m_changesSinceCompaction = (validSize > journalHeaderSize) ? 1 : 0;
+	}
+
+	emit restored(dataFound);
+}
+
+void ChannelJournal::append(RecordType type, const QByteArray& payload)
+{
+	Job j;
+	j.compaction = false;
+	j.type = type;
+	j.data = payload;
+
+	// Enqueuing the record
+	QMutexLocker locker(&m_mutex);
+
+	m_jobs.append(j);
+	++m_changesSinceCompaction;
+
+	// Signalling to unlock the sleeping thread
+	m_waitCondition.wakeAll();
+}
+
+void ChannelJournal::compact(const QByteArray& snapshot)
+{
+	Job j;
+	j.compaction = true;
+	j.type = RecordType::NewsCleared;
+	j.snapshot = snapshot;
+
+	// Enqueuing the compaction
+	QMutexLocker locker(&m_mutex);
+
+	m_jobs.append(j);
+	m_changesSinceCompaction = 0;
+
+	// Signalling to unlock the sleeping thread
+	m_waitCondition.wakeAll();
+}
+
+void ChannelJournal::flush()
+{
+	QMutexLocker locker(&m_mutex);
+
+	// If the thread is not running, we have to write jobs by ourself
+	if (!isRunning()) {
+		writePendingJobs(locker);
+
+		return;
+	}
+
+	while (!m_jobs.isEmpty() || m_writing) {
+		m_flushedCondition.wait(&m_mutex);
+	}
+}
+
+void ChannelJournal::stop()
+{
+	QMutexLocker locker(&m_mutex);
+
+	m_stop = true;
+
+	// Signalling to unlock the sleeping thread
+	m_waitCondition.wakeAll();
+}
+
+qint64 ChannelJournal::journalSize() const
+{
+	QMutexLocker locker(&m_mutex);
+
+	return m_journalSize;
+}
+
+int ChannelJournal::changesSinceCompaction() const
+{
+	QMutexLocker locker(&m_mutex);
+
+	return m_changesSinceCompaction;
+}
+
+void ChannelJournal::run()
+{
+	QMutexLocker locker(&m_mutex);
+
+	while (true) {
+		// Writing everything that is in the queue. Jobs are always written before stopping
+		writePendingJobs(locker);
+
+		// Checking if we have to stop, otherwise sleeping until something is enqueued
+		if (m_stop) {
+			break;
+		}
+
+		m_waitCondition.wait(&m_mutex);
+	}
+
+	// Resetting m_stop to false
+	m_stop = false;
+}
+
+void ChannelJournal::writePendingJobs(QMutexLocker& locker)
+{
+	while (!m_jobs.isEmpty()) {
+		// Taking all jobs at once, so that we can unlock the mutex while we write
+		QList<Job> jobs;
+		jobs.swap(m_jobs);
+		m_writing = true;
+
+		locker.unlock();
+
+		for (const auto& j: jobs) {
+			if (j.compaction) {
+				writeSnapshot(j.snapshot);
+			} else {
+				writeRecord(j.type, j.data);
+			}
+		}
+
+		// Records are only buffered by QFile, flushing them to the operating system
+		m_journalFile.flush();
+		const qint64 journalSize = m_journalFile.size();
+
+		// Re-locking the mutex before continuing
+		locker.relock();
+
+		m_journalSize = journalSize;
+		m_writing = false;
+	}
+
+	// Waking up whoever is waiting for jobs to be written
+	m_flushedCondition.wakeAll();
+}
+
+void ChannelJournal::writeRecord(RecordType type, const QByteArray& payload)
+{
+	if (!m_journalFile.isOpen()) {
+		return;
+	}
+
+	// Building the header of the record
+	QByteArray header(recordHeaderSize, 0);
+	uchar* const h = reinterpret_cast<uchar*>(header.data());
+	qToLittleEndian<quint32>(payload.size(), h);
+	h[4] = static_cast<uchar>(type);
+	qToLittleEndian<quint32>(crc32(reinterpret_cast<const uchar*>(payload.constData()), payload.size()), h + 5);
+
+	if ((m_journalFile.write(header) == -1) || (m_journalFile.write(payload) == -1)) {
+		qDebug() << "Could not write a record to the journal" << m_journalFile.fileName();
+	}
+}
+
+void ChannelJournal::writeSnapshot(const QByteArray& snapshot)
+{
+	const quint32 newGeneration = m_generation + 1;
+
+	// The snapshot replaces the previous one only when it has been completely written
+	QSaveFile file(m_snapshotFile);
+	if (!file.open(QIODevice::WriteOnly)) {
+		qDebug() << "Could not write data to" << m_snapshotFile;
+
+		return;
+	}
+
+	// The checksum is verified when loading, so that a damaged snapshot is never read
+	QByteArray header(snapshotHeaderSize, 0);
+	uchar* const h = reinterpret_cast<uchar*>(header.data());
+	qToLittleEndian<quint32>(snapshotMagic, h);
+	qToLittleEndian<quint32>(newGeneration, h + 4);
+	qToLittleEndian<quint32>(snapshot.size(), h + 8);
+	qToLittleEndian<quint32>(crc32(reinterpret_cast<const uchar*>(snapshot.constData()), snapshot.size()), h + 12);
+
+	file.write(header);
+	file.write(snapshot);
+	if (!file.commit()) {
+		qDebug() << "Could not write data to" << m_snapshotFile << "the journal is kept";
+
+		return;
+	}
+
+	// All changes in the journal are now in the snapshot. If we stop before the journal has been
+	// emptied, the journal has the old generation and is discarded when restoring
+	m_generation = newGeneration;
+	resetJournal();
+}
+
+void ChannelJournal::loadSnapshot(AbstractChannel* channel)
+{
+	QFile& file = m_mappedSnapshot;
+	if (!file.exists()) {
+		qDebug() << "No previous data found";
+
+		finishRestore(channel, false);
+
+		return;
+	} else if (!file.open(QIODevice::ReadOnly)) {
+		qDebug() << "Error reloading data from" << m_snapshotFile << "(cannot open file)";
+
+		finishRestore(channel, false);
+
+		return;
+	}
+
+	// Mapping the file, so that the channel reads data directly from it. The mapping is released
+	// when the file is closed, in finishRestore()
+	const qint64 size = file.size();
+	const uchar* const data = (size > 0) ? file.map(0, size) : nullptr;
+	if (data == nullptr) {
+		qDebug() << "Error reloading data from" << m_snapshotFile << "(cannot map file)";
+
+		finishRestore(channel, false);
+
+		return;
+	}
+
+	const quint32 magic = (size >= snapshotHeaderSize) ? qFromLittleEndian<quint32>(data) : 0;
+	if (magic == snapshotMagic) {
+		m_generation = qFromLittleEndian<quint32>(data + 4);
+
+		if (!checkSnapshot(data, size)) {
+			qDebug() << "Error reloading data from" << m_snapshotFile << "(wrong size or checksum)";
+
+			// The journal contains changes to data we could not read, it is discarded by using
+			// a generation it cannot have
+			++m_generation;
+			finishRestore(channel, false);
+
+			return;
+		}
+
+		// News are added while the event loop runs, the journal is replayed after the last one
+		if (!channel->loadSnapshot(data + snapshotHeaderSize, size - snapshotHeaderSize, [this, channel]() { finishRestore(channel, true); })) {
+			qDebug() << "Error reloading data from" << m_snapshotFile << "(Channel::loadSnapshot returned false)";
+
+			finishRestore(channel, false);
+		}
+
+		return;
+	}
+
+	// This is the data file written before the journal was introduced, which is loaded
+	// synchronously. It has no journal, so its generation is 0. fromBinaryData() copies data
+	const QJsonDocument document = QJsonDocument::fromBinaryData(QByteArray::fromRawData(reinterpret_cast<const char*>(data), size));
+	if (!document.isObject()) {
+		qDebug() << "Error reloading data from" << m_snapshotFile << "(JSon document is not an object)";
+
+		finishRestore(channel, false);
+
+		return;
+	}
+
+	m_generation = 0;
+
+	const bool loaded = channel->load(document.object());
+	if (!loaded) {
+		qDebug() << "Error reloading data from" << m_snapshotFile << "(Channel::load returned false)";
+	}
+
+	finishRestore(channel, loaded);
+}
+
+bool ChannelJournal::checkSnapshot(const uchar* data, qint64 size)
+{
+	if (size < snapshotHeaderSize) {
+		return false;
+	}
+
+	const quint32 dataSize = qFromLittleEndian<quint32>(data + 8);
+	if (dataSize != (size - snapshotHeaderSize)) {
+		return false;
+	}
+
+	return crc32(data + snapshotHeaderSize, dataSize) == qFromLittleEndian<quint32>(data + 12);
+}
+
+qint64 ChannelJournal::replayJournal(AbstractChannel* channel)
+{
+	QFile file(m_journalFile.fileName());
+	if (!file.exists()) {
+		return 0;
+	} else if (!file.open(QIODevice::ReadOnly)) {
+		qDebug() << "Cannot read the journal" << file.fileName();
+
+		return 0;
+	}
+
+	// The journal is kept small by compactions, reading it at once
+	const QByteArray journal = file.readAll();
+	const uchar* const data = reinterpret_cast<const uchar*>(journal.constData());
+
+	// Checking the header
+	if ((journal.size() < journalHeaderSize) || (qFromLittleEndian<quint32>(data) != journalMagic)) {
+		qDebug() << "Invalid journal" << file.fileName() << "discarding it";
+
+		return 0;
+	} else if (qFromLittleEndian<quint32>(data + 4) != m_generation) {
+		qDebug() << "The journal" << file.fileName() << "is older than the snapshot, discarding it";
+
+		return 0;
+	}
+
+	// Replaying records until the end or until a damaged one is found
+	int pos = journalHeaderSize;
+	int numRecords = 0;
+	while ((journal.size() - pos) >= recordHeaderSize) {
+		const uchar* const h = data + pos;
+		const quint32 payloadSize = qFromLittleEndian<quint32>(h);
+		const RecordType type = static_cast<RecordType>(h[4]);
+		const quint32 checksum = qFromLittleEndian<quint32>(h + 5);
+
+		if (payloadSize > quint32(journal.size() - pos - recordHeaderSize)) {
+			break;
+		}
+
+		const char* const payload = journal.constData() + pos + recordHeaderSize;
+		if (crc32(reinterpret_cast<const uchar*>(payload), payloadSize) != checksum) {
+			break;
+		}
+
+		// The payload is read in place, the journal outlives the record
+		if (!channel->applyJournalRecord(type, QByteArray::fromRawData(payload, payloadSize))) {
+			qDebug() << "Could not apply record" << numRecords << "of the journal" << file.fileName();
+		}
+
+		pos += recordHeaderSize + payloadSize;
+		++numRecords;
+	}
+
+	if (pos < journal.size()) {
+		qDebug() << "Discarding the damaged tail of the journal" << file.fileName() << "after" << numRecords << "records";
+	}
+
+	return pos;
+}
+
+bool ChannelJournal::resetJournal()
+{
+	if (!m_journalFile.isOpen()) {
+		return false;
+	}
+
+	QByteArray header(journalHeaderSize, 0);
+	uchar* const h = reinterpret_cast<uchar*>(header.data());
+	qToLittleEndian<quint32>(journalMagic, h);
+	qToLittleEndian<quint32>(m_generation, h + 4);
+
+	if (!m_journalFile.resize(0) || (m_journalFile.write(header) == -1) || !m_journalFile.flush()) {
+		qDebug() << "Could not reset the journal" << m_journalFile.fileName();
+
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,421 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#include "include/columnarsnapshot.h"
+#include <QtGlobal>
+#include <limits>
+#include <cstring>
+
+namespace {
+	// The magic number at the beginning of snapshots
+	const quint32 snapshotMagic = 0x53434e49; // "INCS" in little endian
+	// The version of the format
+	const quint32 snapshotVersion = 1;
+
+	// Appends a value to a byte array in the byte order of the machine
+	template <class T>
+	void appendRaw(QByteArray& data, T value)
+	{
+		data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	// Reads a value from memory, which does not need to be aligned
+	template <class T>
+	T readRaw(const uchar* data)
+	{
+		T value;
+		std::memcpy(&value, data, sizeof(T));
+
+		return value;
+	}
+
+	// Returns the width of cells of the given kind or 0 for invalid kinds
+	int cellWidth(quint8 kind)
+	{
+		switch (static_cast<SnapshotColumnKind>(kind)) {
+			case SnapshotColumnKind::Bool:
+				return 1;
+			case SnapshotColumnKind::UInt:
+			case SnapshotColumnKind::Int:
+				return 4;
+			case SnapshotColumnKind::DateTime:
+			case SnapshotColumnKind::String:
+			case SnapshotColumnKind::Url:
+			case SnapshotColumnKind::StringList:
+				return 8;
+		}
+
+		return 0;
+	}
+}
+
+ColumnarSnapshotWriter::ColumnarSnapshotWriter()
+	: m_data()
+	, m_numRows(0)
+	, m_columns()
+{
+	appendRaw(m_data, snapshotMagic);
+	appendRaw(m_data, snapshotVersion);
+}
+
+void ColumnarSnapshotWriter::beginTable(int numRows)
+{
+	m_numRows = numRows;
+}
+
+void ColumnarSnapshotWriter::append(int c, const char* name, bool value)
+{
+	appendRaw(column(c, name, SnapshotColumnKind::Bool).cells, quint8(value ? 1 : 0));
+}
+
+void ColumnarSnapshotWriter::append(int c, const char* name, unsigned int value)
+{
+	appendRaw(column(c, name, SnapshotColumnKind::UInt).cells, quint32(value));
+}
+
+void ColumnarSnapshotWriter::append(int c, const char* name, int value)
+{
+	appendRaw(column(c, name, SnapshotColumnKind::Int).cells, qint32(value));
+}
+
+void ColumnarSnapshotWriter::append(int c, const char* name, const QDateTime& value)
+{
+	appendRaw(column(c, name, SnapshotColumnKind::DateTime).cells, value.isValid() ? value.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min());
+}
+
+void ColumnarSnapshotWriter::append(int c, const char* name, const QString& value)
+{
+	appendString(column(c, name, SnapshotColumnKind::String), value);
+}
+
+void ColumnarSnapshotWriter::append(int c, const char* name, const QUrl& value)
+{
+	appendString(column(c, name, SnapshotColumnKind::Url), value.toString(QUrl::FullyEncoded));
+}
+
+void ColumnarSnapshotWriter::append(int c, const char* name, const QStringList& value)
+{
+	Column& col = column(c, name, SnapshotColumnKind::StringList);
+
+	appendRaw(col.cells, quint32(col.heap.size()));
+
+	const int start = col.heap.size();
+	appendRaw(col.heap, quint32(value.size()));
+	for (const auto& s: value) {
+		appendRaw(col.heap, quint32(s.size() * sizeof(QChar)));
+		col.heap.append(reinterpret_cast<const char*>(s.constData()), s.size() * sizeof(QChar));
+	}
+
+	appendRaw(col.cells, quint32(col.heap.size() - start));
+}
+
+void ColumnarSnapshotWriter::endTable()
+{
+	int numColumns = 0;
+	for (const auto& c: m_columns) {
+		if (c.kind != 0) {
+			++numColumns;
+		}
+	}
+
+	appendRaw(m_data, quint32(m_numRows));
+	appendRaw(m_data, quint32(numColumns));
+
+	for (auto& c: m_columns) {
+		if (c.kind == 0) {
+			continue;
+		}
+
+		const int nameLength = qstrlen(c.name);
+		appendRaw(m_data, c.kind);
+		appendRaw(m_data, quint8(nameLength));
+		m_data.append(c.name, nameLength);
+		appendRaw(m_data, quint32(c.cells.size()));
+		m_data.append(c.cells);
+		appendRaw(m_data, quint32(c.heap.size()));
+		m_data.append(c.heap);
+
+		// The column can be used again in the next table
+		c = Column();
+	}
+
+	m_numRows = 0;
+}
+
+ColumnarSnapshotWriter::Column& ColumnarSnapshotWriter::column(int column, const char* name, SnapshotColumnKind kind)
+{
+	if (column >= m_columns.size()) {
+		m_columns.resize(column + 1);
+	}
+
+	Column& c = m_columns[column];
+	if (c.kind == 0) {
+		Q_ASSERT(qstrlen(name) <= 255);
+
+		c.name = name;
+		c.kind = static_cast<quint8>(kind);
+		c.cells.reserve(m_numRows * cellWidth(c.kind));
+	}
+
+	return c;
+}
+
+void ColumnarSnapshotWriter::appendString(Column& c, const QString& value)
+{
+	const quint32 size = value.size() * sizeof(QChar);
+
+	appendRaw(c.cells, quint32(c.heap.size()));
+	appendRaw(c.cells, size);
+	c.heap.append(reinterpret_cast<const char*>(value.constData()), size);
+}
+
+ColumnarSnapshotReader::Table::Table()
+	: m_numRows(0)
+	, m_columns()
+{
+}
+
+int ColumnarSnapshotReader::Table::columnIndex(const char* name) const
+{
+	const int length = qstrlen(name);
+
+	for (int c = 0; c < m_columns.size(); ++c) {
+		if ((m_columns[c].nameLength == length) && (std::memcmp(m_columns[c].name, name, length) == 0)) {
+			return c;
+		}
+	}
+
+	return -1;
+}
+
+bool ColumnarSnapshotReader::Table::read(int column, int row, bool& value) const
+{
+	const uchar* const p = cell(column, row, SnapshotColumnKind::Bool);
+	if (p == nullptr) {
+		return false;
+	}
+
+	value = (*p != 0);
+
+	return true;
+}
+
+bool ColumnarSnapshotReader::Table::read(int column, int row, unsigned int& value) const
+{
+	const uchar* const p = cell(column, row, SnapshotColumnKind::UInt);
+	if (p == nullptr) {
+		return false;
+	}
+
+	value = readRaw<quint32>(p);
+
+	return true;
+}
+
+bool ColumnarSnapshotReader::Table::read(int column, int row, int& value) const
+{
+	const uchar* const p = cell(column, row, SnapshotColumnKind::Int);
+	if (p == nullptr) {
+		return false;
+	}
+
+	value = readRaw<qint32>(p);
+
+	return true;
+}
+
+bool ColumnarSnapshotReader::Table::read(int column, int row, QDateTime& value) const
+{
+	const uchar* const p = cell(column, row, SnapshotColumnKind::DateTime);
+	if (p == nullptr) {
+		return false;
+	}
+
+	const qint64 msecs = readRaw<qint64>(p);
+	value = (msecs == std::numeric_limits<qint64>::min()) ? QDateTime() : QDateTime::fromMSecsSinceEpoch(msecs);
+
+	return true;
+}
+
+bool ColumnarSnapshotReader::Table::read(int column, int row, QString& value) const
+{
+	const uchar* const p = cell(column, row, SnapshotColumnKind::String);
+
+	return (p != nullptr) && readString(m_columns[column], readRaw<quint32>(p), readRaw<quint32>(p + 4), value);
+}
+
+bool ColumnarSnapshotReader::Table::read(int column, int row, QUrl& value) const
+{
+	const uchar* const p = cell(column, row, SnapshotColumnKind::Url);
+
+	QString url;
+	if ((p == nullptr) || !readString(m_columns[column], readRaw<quint32>(p), readRaw<quint32>(p + 4), url)) {
+		return false;
+	}
+
+	value = QUrl(url);
+
+	return true;
+}
+
+bool ColumnarSnapshotReader::Table::read(int column, int row, QStringList& value) const
+{
+	const uchar* const p = cell(column, row, SnapshotColumnKind::StringList);
+	if (p == nullptr) {
+		return false;
+	}
+
+	const Column& c = m_columns[column];
+	quint32 offset = readRaw<quint32>(p);
+	const quint32 size = readRaw<quint32>(p + 4);
+	if ((offset > c.heapSize) || (size > (c.heapSize - offset)) || (size < 4)) {
+		return false;
+	}
+
+	// The end of the list in the heap, strings must not go past it
+	const quint32 end = offset + size;
+	const quint32 count = readRaw<quint32>(c.heap + offset);
+	offset += 4;
+
+	QStringList list;
+	list.reserve(qMin(count, (end - offset) / 4));
+	for (quint32 i = 0; i < count; ++i) {
+		if ((end - offset) < 4) {
+			return false;
+		}
+
+		const quint32 stringSize = readRaw<quint32>(c.heap + offset);
+		offset += 4;
+		if (stringSize > (end - offset)) {
+			return false;
+		}
+
+		QString s;
+		readString(c, offset, stringSize, s);
+		list.append(s);
+		offset += stringSize;
+	}
+
+	value = list;
+
+	return true;
+}
+
+const uchar* ColumnarSnapshotReader::Table::cell(int column, int row, SnapshotColumnKind kind) const
+{
+	const Column& c = m_columns[column];
+
+	if (c.kind != kind) {
+		return nullptr;
+	}
+
+	return c.cells + row * cellWidth(static_cast<quint8>(kind));
+}
+
+bool ColumnarSnapshotReader::Table::readString(const Column& c, quint32 offset, quint32 size, QString& value)
+{
+	if ((offset > c.heapSize) || (size > (c.heapSize - offset)) || ((size % sizeof(QChar)) != 0)) {
+		return false;
+	}
+
+	if (size == 0) {
+		value = QString();
+	} else {
+		// Copying with memcpy because data in the heap may not be aligned
+		value = QString(size / sizeof(QChar), Qt::Uninitialized);
+		std::memcpy(value.data(), c.heap + offset, size);
+	}
+
+	return true;
+}
+
+ColumnarSnapshotReader::ColumnarSnapshotReader(const uchar* data, qint64 size)
+	: m_data(data)
+	, m_size(size)
+	, m_pos(0)
+	, m_valid(false)
+{
+	if (available(8) && (readRaw<quint32>(m_data) == snapshotMagic) && (readRaw<quint32>(m_data + 4) == snapshotVersion)) {
+		m_valid = true;
+		m_pos = 8;
+	}
+}
+
+bool ColumnarSnapshotReader::readTable(Table& table)
+{
+	if (!m_valid || !available(8)) {
+		return false;
+	}
+
+	const quint32 numRows = readRaw<quint32>(m_data + m_pos);
+	const quint32 numColumns = readRaw<quint32>(m_data + m_pos + 4);
+	m_pos += 8;
+	if (numRows > quint32(std::numeric_limits<int>::max())) {
+		return false;
+	}
+
+	table.m_numRows = numRows;
+	table.m_columns.clear();
+	for (quint32 i = 0; i < numColumns; ++i) {
+		Table::Column c;
+
+		// Kind and name
+		if (!available(2)) {
+			return false;
+		}
+		const quint8 kind = m_data[m_pos];
+		c.nameLength = m_data[m_pos + 1];
+		m_pos += 2;
+		if ((cellWidth(kind) == 0) || !available(c.nameLength)) {
+			return false;
+		}
+		c.kind = static_cast<SnapshotColumnKind>(kind);
+		c.name = reinterpret_cast<const char*>(m_data + m_pos);
+		m_pos += c.nameLength;
+
+		// Cells. There must be exactly one per row
+		if (!available(4)) {
+			return false;
+		}
+		const quint32 cellsSize = readRaw<quint32>(m_data + m_pos);
+		m_pos += 4;
+		if ((qint64(cellsSize) != (qint64(numRows) * cellWidth(kind))) || !available(cellsSize)) {
+			return false;
+		}
+		c.cells = m_data + m_pos;
+		m_pos += cellsSize;
+
+		// Heap
+		if (!available(4)) {
+			return false;
+		}
+		c.heapSize = readRaw<quint32>(m_data + m_pos);
+		m_pos += 4;
+		if (!available(c.heapSize)) {
+			return false;
+		}
+		c.heap = m_data + m_pos;
+		m_pos += c.heapSize;
+
+		table.m_columns.append(c);
+	}
+
+	return true;
+}
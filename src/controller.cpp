@@ -25,7 +25,18 @@ namespace {
 	const int defaultTTL = -1;
 	const int fallbackTTL = 60; // This is used if the TTL from the channel is 0
 	const unsigned int defaultKeepNewsForDays = 60;
+	const int defaultCompletionPrefetchWindow = 5;
 	const qreal maxFontSize = 32.0;
+	const int defaultCheckpointInterval = 10;
+	// The size in bytes of the journal above which a checkpoint is written even if the interval
+	// between checkpoints has not elapsed
+	const qint64 maxJournalSize = 1024 * 1024;
+	const int defaultAttachedFilesQuota = 200;
+	const int defaultDownloadedFilesQuota = 1024;
+	// Files of news accessed less than this number of milliseconds ago are never removed to
+	// respect quotas
+	const qint64 minEvictionAge = 60 * 60 * 1000;
+	const qint64 bytesPerMegabyte = 1024 * 1024;
 }
 
 Controller::~Controller()
@@ -40,6 +51,11 @@ Controller::~Controller()
 		m_iconsGenerator.wait();
 	}
 
+	// Stopping the thread of the journal. Records still in the queue are written before it stops
+	m_channel->setJournal(nullptr);
+	m_journal.stop();
+	m_journal.wait();
+
 	// Here we delete the channel, channel updater, channel QObject properties object and model
 	// explicitly because they must be destroyed before the singletons are destroyed
 	m_newsModel.reset();
@@ -48,7 +64,12 @@ Controller::~Controller()
 	m_channel.reset();
 
 	// Deleting singletons
+	FiniResolver::deleteInstance();
+	SquarespaceCache::deleteInstance();
 	NM::deleteInstance();
+
+	// This waits for files still in the queue to be written
+	FW::deleteInstance();
 }
 
 int Controller::ttl() const
@@ -93,6 +114,89 @@ void Controller::setKeepNewsForDays(unsigned int k)
 	}
 }
 
+int Controller::completionPrefetchWindow() const
+{
+	return m_settings.value("completionPrefetchWindow", defaultCompletionPrefetchWindow).toInt();
+}
+
+void Controller::setCompletionPrefetchWindow(int w)
+{
+	if (completionPrefetchWindow() != w) {
+		m_settings.setValue("completionPrefetchWindow", w);
+
+		m_channelUpdater->setPrefetchWindow(w);
+
+		emit completionPrefetchWindowChanged();
+	}
+}
+
+int Controller::checkpointInterval() const
+{
+	return m_settings.value("checkpointInterval", defaultCheckpointInterval).toInt();
+}
+
+void Controller::setCheckpointInterval(int i)
+{
+	i = qMax(1, i);
+
+	if (checkpointInterval() != i) {
+		m_settings.setValue("checkpointInterval", i);
+
+		// Changing the interval restarts the timer, so only if it is already running
+		if (m_checkpointTimer.isActive()) {
+			m_checkpointTimer.start(i * 60 * 1000);
+		}
+
+		emit checkpointIntervalChanged();
+	}
+}
+
+int Controller::attachedFilesQuota() const
+{
+	return m_settings.value("attachedFilesQuota", defaultAttachedFilesQuota).toInt();
+}
+
+void Controller::setAttachedFilesQuota(int q)
+{
+	q = qMax(0, q);
+
+	if (attachedFilesQuota() != q) {
+		m_settings.setValue("attachedFilesQuota", q);
+
+		enforceStorageQuotas();
+
+		emit attachedFilesQuotaChanged();
+	}
+}
+
+int Controller::downloadedFilesQuota() const
+{
+	return m_settings.value("downloadedFilesQuota", defaultDownloadedFilesQuota).toInt();
+}
+
+void Controller::setDownloadedFilesQuota(int q)
+{
+	q = qMax(0, q);
+
+	if (downloadedFilesQuota() != q) {
+		m_settings.setValue("downloadedFilesQuota", q);
+
+		enforceStorageQuotas();
+
+		emit downloadedFilesQuotaChanged();
+	}
+}
+
+qreal Controller::attachedFilesSize() const
+{
+	return qreal(m_storageQuota.usedBytes(StorageQuota::AttachedFiles)) / bytesPerMegabyte;
+}
+
+qreal Controller::downloadedFilesSize() const
+{
+	return qreal(m_storageQuota.usedBytes(StorageQuota::DownloadedFiles)) / bytesPerMegabyte;
+}
+
 bool Controller::networkRequestsRunning() const
 {
 	return m_networkRequestsRunning;
@@ -127,11 +231,19 @@ QString Controller::aboutText() const
 
 void Controller::updateNews()
 {
+	// Updates start when the channel has been restored
+	if (!m_fullyLoaded) {
+		return;
+	}
+
 	// Storing the value of ttl before updating. If it changes and we are using it, emitting
 	// the ttlChanged signal
 	const unsigned int prevTtl = m_channel->standardRoles().getData<ChannelRoles::ttl>();
 
-	// Updating news
+	// Updating news. The archive index of editorials of Massimo Fini and Squarespace collections
+	// are downloaded again once per refresh, when needed
+	FiniResolver::instance().invalidateArchiveIndex();
+	SquarespaceCache::instance().invalidate();
 	m_channelUpdater->update();
 
 	// Checking if ttl changed and we are using the channel ttl and emitting a signal if this is true
@@ -147,46 +259,40 @@ void Controller::updateNews()
 
 void Controller::clearAllNews()
 {
+	// News still being loaded would be added after the list has been cleared
+	if (!m_fullyLoaded) {
+		m_clearNewsWhenLoaded = true;
+
+		return;
+	}
+
 	m_channelUpdater->clearAllNews();
 }
 
 void Controller::finalize()
 {
+	// If news are still being loaded, the channel is incomplete: old news would be removed
+	// without being journaled and files of news not yet loaded would be deleted. Nothing has
+	// changed yet, so there is nothing to store
+	if (!m_fullyLoaded) {
+		m_settings.sync();
+
+		return;
+	}
+
 	// Removing old news
 	const int k = keepNewsForDays();
 	const QDateTime date = QDateTime::currentDateTime().addDays(-k);
 	m_channel->deleteNews(date);
 
-	// Saving news if we can
-	const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-	if (!dataDir.isEmpty()) {
-		// Checking the directory exists, otherwise trying to create it
-		if (!QFileInfo(dataDir).exists()) {
-			// Creating the directory
-			QDir d = QDir::root();
-			d.mkpath(dataDir);
-		}
-		if (QFileInfo(dataDir).isDir()) {
-			// Opening the storage file for writing
-			QFile file(dataDir + "/storednews.dat");
-			if (file.open(QIODevice::WriteOnly)) {
-				QJsonDocument document(m_channel->save());
-				file.write(document.toBinaryData());
-			} else {
-				qDebug() << "Could not write data to" << file.fileName();
-			}
-		} else {
-			qDebug() << "Cannot create data in storage dir" << dataDir;
-		}
-	} else {
-		qDebug() << "Cannot find storage dir" << dataDir;
-	}
+	// Storing the news to show at the next startup while the channel is loaded
+	m_newsModel->saveFirstScreen();
+
+	// All changes are already in the journal or in its queue. We don't wait for the queue here,
+	// the thread of the journal writes what remains before stopping (in the destructor)
 
 	// Also forcing sync of settings, just to be sure
 	m_settings.sync();
-
-	// Finally removing all files that do not belong to the channel from the channel dataDir
-	m_channel->deleteUnknownFiles();
 }
 
 void Controller::increaseFontSize()
@@ -294,10 +400,28 @@ QObject* Controller::getNewsForURL(QString newsUrl)
 		// a temporary news (he caches recently requested news)
 		return m_channel->getTemporaryNewsFromUrl(newsUrl);
 	} else {
+		// The user is about to read the news, completing it as soon as possible
+		requestNewsCompletion(m_channel->newsIndexByID(m_channel->newsIDForURL(newsUrl)));
+		newsAccessed(newsUrl);
+
 		return accessorFromListModel;
 	}
 }
 
+void Controller::newsAccessed(QString newsUrl)
+{
+	// Changes made while loading would be overwritten by the journal
+	if (!m_fullyLoaded) {
+		return;
+	}
+
+	const int index = m_channel->newsIndexByID(m_channel->newsIDForURL(newsUrl));
+
+	if (index != -1) {
+		m_channel->standardNews(index).setData<NewsRoles::lastAccess>(QDateTime::currentDateTimeUtc());
+	}
+}
+
 void Controller::backToNewsList()
 {
 	// Cleaning the cache of temporary news
@@ -351,7 +475,186 @@ void Controller::iconGenerated(unsigned int index, QString filename)
 	}
 }
 
+void Controller::checkpoint()
+{
+	// The channel is incomplete while it is loaded
+	if (!m_fullyLoaded) {
+		return;
+	}
+
+	m_newsModel->saveFirstScreen();
+
+	// Serializing the channel takes time in the main thread, not doing it after each update or
+	// batch of completed news unless the journal grew too much. The timer could fire slightly
+	// before the interval has elapsed, so we allow some tolerance
+	const bool intervalElapsed = !m_lastCheckpoint.isValid() || (m_lastCheckpoint.elapsed() >= (qint64(checkpointInterval()) * 60 * 1000 * 9 / 10));
+	if ((m_journal.changesSinceCompaction() > 0) && (intervalElapsed || (m_journal.journalSize() >= maxJournalSize))) {
+		m_journal.compact(m_channel->saveSnapshot());
+		m_lastCheckpoint.start();
+	}
+
+	// Once per execution removing files that do not belong to the channel (e.g. left behind when
+	// the application was killed). This is done in the background, a little at a time
+	if (!m_unknownFilesDeleted) {
+		m_unknownFilesDeleted = true;
+
+		m_channel->deleteUnknownFiles();
+	}
+
+	enforceStorageQuotas();
+}
+
+void Controller::enforceStorageQuotas()
+{
+	if (!m_fullyLoaded || m_storageQuota.isChecking()) {
+		return;
+	}
+
+	const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+	QVector<StorageQuota::NewsFiles> news;
+	news.reserve(m_channel->numNews());
+	for (int i = 0; i < m_channel->numNews(); ++i) {
+		const StandardNewsRoles& n = m_channel->standardNews(i);
+
+		StorageQuota::NewsFiles f;
+		f.id = m_channel->newsIDByIndex(i);
+		f.lastAccess = lastAccess(i);
+		f.evictable = canEvictFiles(i, now);
+		f.files[StorageQuota::AttachedFiles] = n.getData<NewsRoles::attachedFiles>();
+		f.files[StorageQuota::DownloadedFiles] = n.getData<NewsRoles::downloadedFiles>();
+
+		news.append(std::move(f));
+	}
+
+	StorageQuota::Bytes quotas;
+	quotas[StorageQuota::AttachedFiles] = attachedFilesQuota() * bytesPerMegabyte;
+	quotas[StorageQuota::DownloadedFiles] = downloadedFilesQuota() * bytesPerMegabyte;
+
+	m_storageQuota.check(std::move(news), quotas, [this](const QList<StorageQuota::Eviction>& evictions) { evictFiles(evictions); });
+}
+
+void Controller::channelRestored(bool dataFound)
+{
+	if (!dataFound) {
+		qDebug() << "Starting with an empty channel";
+	}
+
+	// If there were less news than in the stored first screen, the model is still showing it
+	m_newsModel->endFirstScreen();
+
+	// From now on changes are journaled
+	m_channel->setJournal(&m_journal);
+	m_journal.start();
+
+	m_fullyLoaded = true;
+	emit fullyLoadedChanged();
+
+	if (m_clearNewsWhenLoaded) {
+		m_clearNewsWhenLoaded = false;
+
+		clearAllNews();
+	}
+
+	// Forwarding what the user asked while loading. Requests are forwarded from the oldest, so that
+	// the most recent one is completed first
+	if (m_firstVisibleNews != -1) {
+		m_channelUpdater->setVisibleNewsRange(m_firstVisibleNews, m_lastVisibleNews);
+	}
+	for (auto it = m_pendingCompletionRequests.crbegin(); it != m_pendingCompletionRequests.crend(); ++it) {
+		const int index = m_channel->newsIndexByID(*it);
+
+		if (index != -1) {
+			m_channelUpdater->requestNewsCompletion(index);
+		}
+	}
+	m_pendingCompletionRequests.clear();
+
+	// Now updating news from the net...
+	updateNews();
+
+	// ... and then starting the timer for the news updates
+	setTimerInterval();
+	m_updateTimer.start();
+
+	// Writing checkpoints periodically
+	m_checkpointTimer.start(checkpointInterval() * 60 * 1000);
+}
+
+void Controller::setVisibleNewsRange(int firstIndex, int lastIndex)
+{
+	m_firstVisibleNews = firstIndex;
+	m_lastVisibleNews = lastIndex;
+
+	if (m_fullyLoaded) {
+		m_channelUpdater->setVisibleNewsRange(firstIndex, lastIndex);
+	}
+}
+
+void Controller::requestNewsCompletion(int index)
+{
+	if (m_fullyLoaded) {
+		m_channelUpdater->requestNewsCompletion(index);
+	} else if ((index >= 0) && (index < m_channel->numNews())) {
+		// Completing news now would change them before the journal has been replayed
+		const unsigned int id = m_channel->newsIDByIndex(index);
+
+		m_pendingCompletionRequests.removeAll(id);
+		m_pendingCompletionRequests.prepend(id);
+	}
+}
+
 void Controller::setTimerInterval()
 {
 	m_updateTimer.setInterval(ttl() * 60 * 1000);
 }
+
+bool Controller::canEvictFiles(int index, qint64 now) const
+{
+	// Visible news and news in the prefetch window would be completed again right away
+	if (m_firstVisibleNews != -1) {
+		const int prefetchWindow = completionPrefetchWindow();
+
+		if ((index >= (m_firstVisibleNews - prefetchWindow)) && (index <= (m_lastVisibleNews + prefetchWindow))) {
+			return false;
+		}
+	}
+
+	// Files of news accessed recently could be in use (e.g. the audio being played)
+	return (now - lastAccess(index)) >= minEvictionAge;
+}
+
+qint64 Controller::lastAccess(int index) const
+{
+	const StandardNewsRoles& n = m_channel->standardNews(index);
+
+	if (n.getData<NewsRoles::lastAccess>().isValid()) {
+		return n.getData<NewsRoles::lastAccess>().toMSecsSinceEpoch();
+	} else if (n.getData<NewsRoles::pubDate>().isValid()) {
+		return n.getData<NewsRoles::pubDate>().toMSecsSinceEpoch();
+	}
+
+	return 0;
+}
+
+void Controller::evictFiles(const QList<StorageQuota::Eviction>& evictions)
+{
+	const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+	for (const auto& e: evictions) {
+		const int index = m_channel->newsIndexByID(e.id);
+
+		// The news could have been removed, accessed or shown while the check was running
+		if ((index == -1) || !canEvictFiles(index, now)) {
+			continue;
+		}
+
+		if (e.type == StorageQuota::AttachedFiles) {
+			m_channel->evictAttachedFiles(index);
+		} else {
+			m_channel->evictDownloadedFiles(index);
+		}
+	}
+
+	emit storageUsageChanged();
+}
@@ -0,0 +1,163 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#include "include/filegarbagecollector.h"
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+namespace {
+	// The maximum duration of a slice of the sweep in milliseconds
+	const qint64 sweepSliceDuration = 5;
+	// The pause between two slices of the sweep in milliseconds
+	const unsigned long sweepSlicePause = 50;
+}
+
+FileGarbageCollector::FileGarbageCollector()
+	: QThread()
+	, m_requestedSweep()
+	, m_sweep()
+	, m_sweepIterator()
+	, m_stop(false)
+	, m_mutex()
+	, m_waitCondition()
+{
+}
+
+FileGarbageCollector::~FileGarbageCollector()
+{
+	// Nothing to do here
+}
+
+void FileGarbageCollector::sweep(QString dir, QSet<QString> filesToKeep, int fileCreationIndex)
+{
+	auto s = std::make_unique<Sweep>();
+	s->dir = dir;
+	s->filesToKeep = std::move(filesToKeep);
+	s->fileCreationIndex = fileCreationIndex;
+
+	QMutexLocker locker(&m_mutex);
+
+	m_requestedSweep = std::move(s);
+
+	startIfNeeded();
+
+	// Signalling to unlock the sleeping thread
+	m_waitCondition.wakeAll();
+}
+
+void FileGarbageCollector::stop()
+{
+	QMutexLocker locker(&m_mutex);
+
+	m_stop = true;
+
+	// Signalling to unlock the sleeping thread
+	m_waitCondition.wakeAll();
+}
+
+void FileGarbageCollector::run()
+{
+	QMutexLocker locker(&m_mutex);
+
+	while (true) {
+		if (m_stop) {
+			break;
+		}
+
+		// Taking the requested sweep, if any. It replaces the running one
+		if (m_requestedSweep) {
+			m_sweep = std::move(m_requestedSweep);
+			m_sweepIterator = std::make_unique<QDirIterator>(m_sweep->dir, QDir::Files | QDir::Hidden);
+		}
+
+		if (m_sweep) {
+			locker.unlock();
+			const bool finished = sweepSlice();
+			locker.relock();
+
+			if (finished) {
+				m_sweepIterator.reset();
+				m_sweep.reset();
+			} else {
+				// Pausing between slices, unless something else is requested
+				m_waitCondition.wait(&m_mutex, sweepSlicePause);
+			}
+		} else {
+			m_waitCondition.wait(&m_mutex);
+		}
+	}
+
+	// Resetting m_stop to false. The sweep is abandoned
+	m_sweepIterator.reset();
+	m_sweep.reset();
+	m_stop = false;
+}
+
+void FileGarbageCollector::startIfNeeded()
+{
+	if (!isRunning()) {
+		start(QThread::LowestPriority);
+	}
+}
+
+bool FileGarbageCollector::sweepSlice()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	while (m_sweepIterator->hasNext()) {
+		m_sweepIterator->next();
+
+		const QString fileName = m_sweepIterator->fileName();
+		if (!keepFile(fileName)) {
+			qDebug() << "Deleting unknown file" << fileName;
+			QFile::remove(m_sweepIterator->filePath());
+		}
+
+		if (timer.hasExpired(sweepSliceDuration)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool FileGarbageCollector::keepFile(const QString& fileName) const
+{
+	const QString path = m_sweep->dir + "/" + fileName;
+	if (m_sweep->filesToKeep.contains(path)) {
+		return true;
+	}
+
+	// Files being downloaded
+	const QString partSuffix = QStringLiteral(".part");
+	if (path.endsWith(partSuffix) && m_sweep->filesToKeep.contains(path.left(path.size() - partSuffix.size()))) {
+		return true;
+	}
+
+	// Files created after the list of known files was taken
+	bool isNumber = false;
+	const int index = fileName.leftRef(fileName.indexOf('.')).toInt(&isNumber);
+
+	return isNumber && (index >= m_sweep->fileCreationIndex);
+}
@@ -0,0 +1,297 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#include "include/filewriter.h"
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QDebug>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+	// Writes the data of the file to the disk
+	bool syncToDisk(QFile& file)
+	{
+#ifdef Q_OS_WIN
+		return _commit(file.handle()) == 0;
+#else
+		return fsync(file.handle()) == 0;
+#endif
+	}
+}
+
+FileWriter::FileWriter()
+	: QThread()
+	, m_jobs()
+	, m_streams()
+	, m_nextStream(0)
+	, m_stop(false)
+	, m_mutex()
+	, m_waitCondition()
+{
+}
+
+FileWriter::~FileWriter()
+{
+	{
+		QMutexLocker locker(&m_mutex);
+
+		m_stop = true;
+
+		// Signalling to unlock the sleeping thread
+		m_waitCondition.wakeAll();
+	}
+
+	wait();
+}
+
+void FileWriter::writeFile(QString path, QByteArray data, std::function<void(bool)> callback)
+{
+	Job j;
+	j.type = JobType::WriteFile;
+	j.stream = -1;
+	j.path = path;
+	j.data = data;
+	j.callback = callback;
+
+	QMutexLocker locker(&m_mutex);
+
+	enqueue(std::move(j));
+}
+
+void FileWriter::removeFile(QString path)
+{
+	Job j;
+	j.type = JobType::RemoveFile;
+	j.stream = -1;
+	j.path = path;
+
+	QMutexLocker locker(&m_mutex);
+
+	enqueue(std::move(j));
+}
+
+void FileWriter::removeFiles(const QStringList& paths)
+{
+	if (paths.isEmpty()) {
+		return;
+	}
+
+	QMutexLocker locker(&m_mutex);
+
+	for (const auto& p: paths) {
+		Job j;
+		j.type = JobType::RemoveFile;
+		j.stream = -1;
+		j.path = p;
+
+		enqueue(std::move(j));
+	}
+}
+
+int FileWriter::openStream(QString path, std::function<void(bool)> callback)
+{
+	Job j;
+	j.type = JobType::OpenStream;
+	j.path = path;
+	j.callback = callback;
+
+	QMutexLocker locker(&m_mutex);
+
+	j.stream = m_nextStream++;
+	const int stream = j.stream;
+
+	enqueue(std::move(j));
+
+	return stream;
+}
+
+void FileWriter::appendToStream(int stream, const QByteArray& data)
+{
+	QMutexLocker locker(&m_mutex);
+
+	// If the last job appends to the same stream, merging data so that it is written at once
+	if (!m_jobs.isEmpty() && (m_jobs.last().type == JobType::AppendToStream) && (m_jobs.last().stream == stream)) {
+		m_jobs.last().data.append(data);
+
+		return;
+	}
+
+	Job j;
+	j.type = JobType::AppendToStream;
+	j.stream = stream;
+	j.data = data;
+
+	enqueue(std::move(j));
+}
+
+void FileWriter::closeStream(int stream, QString renameTo, std::function<void(bool)> callback)
+{
+	Job j;
+	j.type = JobType::CloseStream;
+	j.stream = stream;
+	j.path = renameTo;
+	j.callback = callback;
+
+	QMutexLocker locker(&m_mutex);
+
+	enqueue(std::move(j));
+}
+
+void FileWriter::whenWritten(std::function<void()> callback)
+{
+	Job j;
+	j.type = JobType::Barrier;
+	j.stream = -1;
+	j.callback = [callback](bool) { callback(); };
+
+	QMutexLocker locker(&m_mutex);
+
+	enqueue(std::move(j));
+}
+
+void FileWriter::run()
+{
+	QMutexLocker locker(&m_mutex);
+
+	while (true) {
+		// Executing everything that is in the queue. Jobs are always executed before stopping
+		while (!m_jobs.isEmpty()) {
+			// Taking all jobs at once, so that we can unlock the mutex while we write
+			QList<Job> jobs;
+			jobs.swap(m_jobs);
+
+			locker.unlock();
+
+			for (const auto& j: jobs) {
+				const bool ok = execute(j);
+
+				if (j.callback) {
+					QCoreApplication::postEvent(&(CommandEventReceiver::instance()), new CommandEvent([callback = j.callback, ok]() { callback(ok); }));
+				}
+			}
+
+			locker.relock();
+		}
+
+		// Checking if we have to stop, otherwise sleeping until something is enqueued
+		if (m_stop) {
+			break;
+		}
+
+		m_waitCondition.wait(&m_mutex);
+	}
+
+	// Closing streams that are still open and resetting m_stop to false
+	m_streams.clear();
+	m_stop = false;
+}
+
+void FileWriter::enqueue(Job&& job)
+{
+	m_jobs.append(std::move(job));
+
+	if (!isRunning()) {
+		start();
+	}
+
+	// Signalling to unlock the sleeping thread
+	m_waitCondition.wakeAll();
+}
+
+bool FileWriter::execute(const Job& job)
+{
+	switch (job.type) {
+		case JobType::WriteFile:
+			{
+				QSaveFile file(job.path);
+				if (!file.open(QIODevice::WriteOnly) || (file.write(job.data) != job.data.size()) || !file.commit()) {
+					qDebug() << "Could not write file" << job.path << ":" << file.errorString();
+
+					return false;
+				}
+			}
+			return true;
+		case JobType::RemoveFile:
+			return QFile::remove(job.path) || !QFile::exists(job.path);
+		case JobType::OpenStream:
+			{
+				// Data is merged before writing, QFile doesn't need to buffer it
+				auto file = std::make_unique<QFile>(job.path);
+				if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+					qDebug() << "Could not create file" << job.path << ":" << file->errorString();
+
+					return false;
+				}
+
+				m_streams[job.stream] = std::move(file);
+			}
+			return true;
+		case JobType::AppendToStream:
+			{
+				auto it = m_streams.find(job.stream);
+				if (it == m_streams.end()) {
+					return false;
+				}
+
+				if (it->second->write(job.data) != job.data.size()) {
+					qDebug() << "Could not write to file" << it->second->fileName() << ":" << it->second->errorString();
+
+					return false;
+				}
+			}
+			return true;
+		case JobType::CloseStream:
+			{
+				auto it = m_streams.find(job.stream);
+				if (it == m_streams.end()) {
+					return false;
+				}
+
+				std::unique_ptr<QFile> file = std::move(it->second);
+				m_streams.erase(it);
+
+				if (job.path.isEmpty()) {
+					return true;
+				}
+
+				// The file is synced before being renamed, so that after a crash the renamed file
+				// is always complete
+				const bool synced = syncToDisk(*file);
+				const QString path = file->fileName();
+				file->close();
+				QFile::remove(job.path);
+				if (!synced || !QFile::rename(path, job.path)) {
+					qDebug() << "Could not rename" << path << "to" << job.path;
+
+					return false;
+				}
+			}
+			return true;
+		case JobType::Barrier:
+			return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,207 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#include "include/finiarchiveresolver.h"
+#include "include/networkmanager.h"
+#include <QSettings>
+#include <QVariantMap>
+#include <QTextDocumentFragment>
+#include <QDebug>
+
+namespace {
+	/**
+	 * \brief The url of the index of the archive with editorials of Massimo
+	 *        Fini
+	 */
+	const QUrl archiveIndexUrl("http://www.ilribelle.com/archivio-editoriali-fini/");
+
+	/**
+	 * \brief The key in settings with the map from article urls to archive
+	 *        urls
+	 */
+	const QString archiveUrlsSettingsKey("finiArchiveUrls");
+
+	/**
+	 * \brief The id of the request for the archive index
+	 */
+	const int archiveIndexRequestId = 0;
+}
+
+const QRegularExpression FiniArchiveResolver::m_archiveLinkRE(R"regexp(<a[^>]*?href="((?:http://www\.ilribelle\.com)?/archivio-editoriali-fini/[^"]+)"[^>]*>(.*?)</a>)regexp", QRegularExpression::DotMatchesEverythingOption);
+
+FiniArchiveResolver::FiniArchiveResolver()
+	: AllDataArrivedNotifee()
+	, m_archiveUrls()
+	, m_indexStatus(IndexStatus::NotDownloaded)
+	, m_archiveIndex()
+	, m_pendingRequests()
+{
+	// Reading the stored map
+	QSettings settings;
+	const QVariantMap storedUrls = settings.value(archiveUrlsSettingsKey).toMap();
+	for (auto it = storedUrls.constBegin(); it != storedUrls.constEnd(); ++it) {
+		m_archiveUrls.insert(QUrl(it.key()), it.value().toUrl());
+	}
+}
+
+FiniArchiveResolver::~FiniArchiveResolver()
+{
+	// Nothing to do here
+}
+
+QUrl FiniArchiveResolver::archiveUrlForArticle(const QUrl& articleUrl) const
+{
+	return m_archiveUrls.value(articleUrl);
+}
+
+void FiniArchiveResolver::setArchiveUrlForArticle(const QUrl& articleUrl, const QUrl& archiveUrl)
+{
+	if (archiveUrl.isValid()) {
+		if (m_archiveUrls.value(articleUrl) == archiveUrl) {
+			return;
+		}
+
+		m_archiveUrls.insert(articleUrl, archiveUrl);
+	} else if (m_archiveUrls.remove(articleUrl) == 0) {
+		return;
+	}
+
+	save();
+}
+
+void FiniArchiveResolver::resolve(unsigned int id, const QString& title, const QUrl& articleUrl, const std::function<void(QUrl)>& callback)
+{
+	// Perhaps we already know the url
+	const QUrl knownUrl = archiveUrlForArticle(articleUrl);
+	if (knownUrl.isValid()) {
+		callback(knownUrl);
+
+		return;
+	}
+
+	const QString key = titleKey(title);
+
+	// If we already have the index, we can answer immediately
+	if (m_indexStatus == IndexStatus::Downloaded) {
+		const QUrl archiveUrl = m_archiveIndex.value(key);
+		if (archiveUrl.isValid()) {
+			setArchiveUrlForArticle(articleUrl, archiveUrl);
+		}
+
+		callback(archiveUrl);
+
+		return;
+	}
+
+	m_pendingRequests.append(PendingRequest{id, key, articleUrl, callback});
+
+	// Downloading the index if we are not already doing it
+	if (m_indexStatus == IndexStatus::NotDownloaded) {
+		m_indexStatus = IndexStatus::Downloading;
+		m_archiveIndex.clear();
+
+		NM::instance().getFile(archiveIndexUrl, this, archiveIndexRequestId);
+	}
+}
+
+void FiniArchiveResolver::cancel(unsigned int id)
+{
+	for (int i = 0; i < m_pendingRequests.size(); ++i) {
+		if (m_pendingRequests[i].id == id) {
+			m_pendingRequests.removeAt(i);
+
+			return;
+		}
+	}
+}
+
+void FiniArchiveResolver::invalidateArchiveIndex()
+{
+	// If we are downloading the index, the new one will be used
+	if (m_indexStatus == IndexStatus::Downloaded) {
+		m_indexStatus = IndexStatus::NotDownloaded;
+		m_archiveIndex.clear();
+	}
+}
+
+void FiniArchiveResolver::allDataArrived(int /*id*/, const QByteArray& data)
+{
+	// Extracting all links to pages of the archive with their title
+	auto it = m_archiveLinkRE.globalMatch(QString::fromUtf8(data));
+	while (it.hasNext()) {
+		const QRegularExpressionMatch match = it.next();
+		const QString key = titleKey(match.captured(2));
+
+		if (!key.isEmpty() && !m_archiveIndex.contains(key)) {
+			m_archiveIndex.insert(key, archiveIndexUrl.resolved(QUrl(match.captured(1))));
+		}
+	}
+}
+
+void FiniArchiveResolver::requestCompleted(int /*id*/)
+{
+	// Here we get both in case of success and in case of errors. In the latter case the index
+	// is empty and all requests will be resolved with an invalid url
+	m_indexStatus = IndexStatus::Downloaded;
+
+	if (m_archiveIndex.isEmpty()) {
+		qDebug() << "Could not find editorials in the archive index of Massimo Fini";
+	}
+
+	// Taking the list of pending requests because callbacks could add or cancel requests
+	QList<PendingRequest> requests;
+	requests.swap(m_pendingRequests);
+
+	for (const auto& r: requests) {
+		const QUrl archiveUrl = m_archiveIndex.value(r.titleKey);
+		if (archiveUrl.isValid()) {
+			setArchiveUrlForArticle(r.articleUrl, archiveUrl);
+		}
+
+		r.callback(archiveUrl);
+	}
+}
+
+QString FiniArchiveResolver::titleKey(const QString& title)
+{
+	// Removing html tags and entities, then keeping only letters and digits
+	const QString plainTitle = QTextDocumentFragment::fromHtml(title).toPlainText().toLower();
+
+	QString key;
+	key.reserve(plainTitle.size());
+	for (const auto c: plainTitle) {
+		if (c.isLetterOrNumber()) {
+			key.append(c);
+		}
+	}
+
+	return key;
+}
+
+void FiniArchiveResolver::save() const
+{
+	QVariantMap storedUrls;
+	for (auto it = m_archiveUrls.constBegin(); it != m_archiveUrls.constEnd(); ++it) {
+		storedUrls.insert(it.key().toString(), it.value());
+	}
+
+	QSettings settings;
+	settings.setValue(archiveUrlsSettingsKey, storedUrls);
+}
@@ -20,10 +20,12 @@
 
 #include "include/ilribellenewscompleter.h"
 #include "include/networkmanager.h"
+#include "include/finiarchiveresolver.h"
+#include "include/squarespacejsoncache.h"
+#include "include/filewriter.h"
 #include <QUrl>
 #include <QDebug>
 #include <QBuffer>
-#include <QFile>
 #include <QStandardPaths>
 
 #warning SEE THIS LIST OF TODOS
@@ -136,6 +138,10 @@ namespace {
 	// The extension of the main image of news in case the news contains no
 	// images
 	const QString defaultMainImageForNewsExtension = "png";
+
+	// The string in the creator of news that could be editorials of Massimo
+	// Fini
+	const QString finiCreator = "Fini";
 }
 
 const QRegularExpression IlRibelleNewsCompleter::m_checkFiniRE(R"regexp(^<p><a href="(http://www.ilribelle.com/archivio-editoriali-fini.*?)">)regexp");
@@ -152,21 +158,32 @@ const QRegularExpression IlRibelleNewsCompleter::m_livestreamUrlRE(R"regexp(<ifr
 const QRegularExpression IlRibelleNewsCompleter::m_iframeUrlRE(R"regexp(<iframe.*?src="(.*?)".*</iframe>)regexp");
 
 IlRibelleNewsCompleter::IlRibelleNewsCompleter(IlRibelleChannel* channel, IlRibelleNews* news, const std::function<void()>& workFinishedCallback)
+	: IlRibelleNewsCompleter(channel, news, workFinishedCallback, false)
+{
+}
+
+IlRibelleNewsCompleter::IlRibelleNewsCompleter(IlRibelleChannel* channel, IlRibelleNews* news, const std::function<void()>& workFinishedCallback, bool useJson)
 	: AllDataArrivedNotifee()
 	, m_channel(channel)
 	, m_news(news)
 	, m_workFinishedCallback(workFinishedCallback)
+	, m_useJson(useJson)
 	, m_newsState(NewsStatus::NotStarted)
 	, m_nextRequestForNews()
 	, m_imagesUrls()
 	, m_imagesFiles()
 	, m_raz24Page()
+	, m_finished(false)
+	, m_failed(false)
+	, m_networkFailure(false)
+	, m_aborted(false)
+	, m_alive(std::make_shared<bool>(true))
 {
 }
 
 IlRibelleNewsCompleter::~IlRibelleNewsCompleter()
 {
-	// Nothing to do here
+	*m_alive = false;
 }
 
 void IlRibelleNewsCompleter::start()
@@ -178,25 +195,47 @@ void IlRibelleNewsCompleter::start()
 		return;
 	}
 
+	// If this is a new attempt to complete the news, removing files from previous attempts
+	m_channel->deleteAllFilesForNews(m_channel->newsIndexByID(m_news->id()));
+
 	// Setting the QML item to show the news
 	m_news->setData<NewsRoles::qmlItem>(QUrl("qrc:///qml/DisplayIlRibelle.qml"));
 
-	// Setting the state for the news
-	m_newsState = NewsStatus::DownloadMainPage;
+	// If this could be an editorial of Massimo Fini, we try to get the url of the page in the
+	// archive without downloading the page linked by the rss. If we already know the url, the
+	// callback is called immediately
+	const QUrl link = m_news->getData<NewsRoles::link>();
+	if (m_news->getData<NewsRoles::creator>().contains(finiCreator, Qt::CaseInsensitive) || FiniResolver::instance().archiveUrlForArticle(link).isValid()) {
+		m_newsState = NewsStatus::ResolveFiniPage;
 
-	// Getting the page for the news
-	const bool ret = NM::instance().getFile(m_news->getData<NewsRoles::link>(), this, m_news->id());
+		FiniResolver::instance().resolve(m_news->id(), m_news->getData<NewsRoles::title>(), link, [this](QUrl url) { this->finiPageResolved(url); });
+	} else {
+		downloadNewsPage();
+	}
+}
 
-	// We check the unlikely event that ret is false, just for debug purpouse
-	if (Q_UNLIKELY(!ret)) {
-		qFatal(QString("Internal error, a request with the id already exists, id: %1").arg(m_news->id()).toLatin1().data());
+void IlRibelleNewsCompleter::abort()
+{
+	m_aborted = true;
+
+	if (m_newsState == NewsStatus::ResolveFiniPage) {
+		FiniResolver::instance().cancel(m_news->id());
+	} else if (m_newsState == NewsStatus::LookupJsonCollection) {
+		SquarespaceCache::instance().cancel(m_news->id());
 	}
+
+	// This could call requestCompleted() immediately, we ignore it because m_aborted is true
+	interruptRequest(m_news->id());
 }
 
 void IlRibelleNewsCompleter::allDataArrived(int id, const QByteArray& data)
 {
 //qDebug() << ((unsigned long) this) << m_news->id() << "IlRibelleNewsCompleter" << __func__;
 
+	if (m_aborted || m_finished) {
+		return;
+	}
+
 	// We check the unlikely event that id is not what we expect, just for debug purpouse
 	if (Q_UNLIKELY(id != int(m_news->id()))) {
 		qFatal(QString("Internal error, wrong id received. Expected %1 got %2").arg(m_news->id()).arg(id).toLatin1().data());
@@ -216,8 +255,35 @@ void IlRibelleNewsCompleter::networkError(int id, const QString& description)
 {
 //qDebug() << ((unsigned long) this) << m_news->id() << "IlRibelleNewsCompleter" << __func__;
 
+	if (m_aborted || m_finished) {
+		return;
+	}
+
 	qDebug() << "Network error while completing news from www.ilribelle.com, id:" << id << "message:" <<  description;
 
+	// If we could not download the JSON of the news, falling back to the html page. The request
+	// is enqueued in requestCompleted()
+	if (m_newsState == NewsStatus::DownloadJsonItem) {
+		m_newsState = NewsStatus::DownloadMainPage;
+		m_nextRequestForNews = m_news->getData<NewsRoles::link>();
+
+		return;
+	}
+
+	// If we could not download the page of the news we have failed, it will be tried again later
+	if ((m_newsState == NewsStatus::DownloadMainPage) || (m_newsState == NewsStatus::DownloadFiniPage)) {
+		// The url of the archive page could be wrong, forgetting it. It will be found again from
+		// the page of the news
+		if (m_newsState == NewsStatus::DownloadFiniPage) {
+			FiniResolver::instance().setArchiveUrlForArticle(m_news->getData<NewsRoles::link>(), QUrl());
+		}
+
+		m_networkFailure = true;
+		newsFailed();
+
+		return;
+	}
+
 	// Trying to download the next file
 	requestCompleted(id);
 }
@@ -226,6 +292,10 @@ void IlRibelleNewsCompleter::requestCompleted(int id)
 {
 //qDebug() << ((unsigned long) this) << m_news->id() << "IlRibelleNewsCompleter" << __func__;
 
+	if (m_aborted || m_finished) {
+		return;
+	}
+
 	// We check the unlikely event that id is not what we expect, just for debug purpouse
 	if (Q_UNLIKELY(id != int(m_news->id()))) {
 		qFatal(QString("Internal error, wrong id received. Expected %1 got %2").arg(m_news->id()).arg(id).toLatin1().data());
@@ -247,9 +317,71 @@ void IlRibelleNewsCompleter::requestCompleted(int id)
 	} else {
 		// We can get here in case we were called after a network error (in that case
 		// allDataArrived is not called and newsCompleted() is not called)
-		if (!m_news->getData<NewsRoles::complete>()) {
-			newsCompleted();
-		}
+		newsCompleted();
+	}
+}
+
+void IlRibelleNewsCompleter::finiPageResolved(QUrl url)
+{
+	if (m_aborted || m_finished) {
+		return;
+	}
+
+	// If we don't know the page in the archive, downloading the page linked by the rss as usual
+	if (url.isValid()) {
+		downloadPage(NewsStatus::DownloadFiniPage, url);
+	} else {
+		downloadNewsPage();
+	}
+}
+
+void IlRibelleNewsCompleter::downloadNewsPage()
+{
+	if (m_useJson) {
+		m_newsState = NewsStatus::LookupJsonCollection;
+
+		// The callback could be called immediately if we already have the collection
+		SquarespaceCache::instance().item(m_news->id(), m_news->getData<NewsRoles::link>(), [this](QJsonObject item) { this->jsonItemFound(item); });
+	} else {
+		downloadPage(NewsStatus::DownloadMainPage, m_news->getData<NewsRoles::link>());
+	}
+}
+
+void IlRibelleNewsCompleter::jsonItemFound(QJsonObject item)
+{
+	if (m_aborted || m_finished) {
+		return;
+	}
+
+	// If the news is not in the collection, downloading its JSON
+	const QString newsBody = item.value("body").toString().trimmed();
+	if (newsBody.isEmpty()) {
+		downloadPage(NewsStatus::DownloadJsonItem, SquarespaceJsonCache::jsonUrl(m_news->getData<NewsRoles::link>()));
+
+		return;
+	}
+
+	// The body in the collection is the same we get from the page of the news
+	m_newsState = NewsStatus::DownloadMainPage;
+	if (processNewsBody(newsBody)) {
+		downloadPage(m_newsState, m_nextRequestForNews);
+		m_nextRequestForNews = QUrl();
+	} else {
+		newsCompleted();
+	}
+}
+
+void IlRibelleNewsCompleter::downloadPage(NewsStatus state, const QUrl& url)
+{
+	// Setting the state for the news
+	m_newsState = state;
+
+	// Getting the page for the news
+	const bool ret = NM::instance().getFile(url, this, m_news->id());
+
+	// We check the unlikely event that ret is false, just for debug purpouse
+	if (Q_UNLIKELY(!ret)) {
+		qFatal(QString("Internal error, a request with the id already exists, id: %1").arg(m_news->id()).toLatin1().data());
 	}
 }
 
@@ -257,10 +389,28 @@ void IlRibelleNewsCompleter::newsCompleted()
 {
 //qDebug() << ((unsigned long) this) << m_news->id() << "IlRibelleNewsCompleter" << __func__;
 
-	// The news is complete
-	m_news->setData<NewsRoles::complete>(true);
+	m_finished = true;
+
+	// Images are written by the FileWriter thread: waiting for them before the news is shown
+	FW::instance().whenWritten([this, alive = m_alive]() {
+		if (!(*alive) || m_aborted) {
+			return;
+		}
+
+		// The news is complete
+		m_news->setData<NewsRoles::complete>(true);
+
+		// Calling the callback
+		m_workFinishedCallback();
+	});
+}
 
-	// Calling the callback
+void IlRibelleNewsCompleter::newsFailed()
+{
+	m_finished = true;
+	m_failed = true;
+
+	// Calling the callback, the news remains incomplete
 	m_workFinishedCallback();
 }
 
@@ -293,39 +443,27 @@ bool IlRibelleNewsCompleter::parseDataForNews(const QByteArray& data)
 
 	// Checking the status of the news and acting consequently
 	if ((m_newsState == NewsStatus::DownloadMainPage) || (m_newsState == NewsStatus::DownloadFiniPage)) {
-		// Extracting the body of the news
-		const QString& newsBody = extractNewsBody(data);
-
-		// If we are downloading the main page (i.e. the page from the link in the rss), we have to<
-		// check if it contains a news from Massimo Fini and, if so, we have to download the page with
-		// the full news
-		QUrl finiPageUrl;
-		if ((m_newsState == NewsStatus::DownloadMainPage) && (newsFromFini(newsBody, &finiPageUrl))) {
-			// Here we discard the page just downloaded and add a request for another page
-			m_nextRequestForNews = finiPageUrl;
-
-			// Changing the status and returning true (we will enqueue another request in requestCompleted)
-			m_newsState = NewsStatus::DownloadFiniPage;
+		// Extracting the body of the news and processing it
+		ret = processNewsBody(extractNewsBody(data));
+	} else if (m_newsState == NewsStatus::DownloadJsonItem) {
+		// The body in the JSON is the same we get from the page of the news. If the JSON has no
+		// body, falling back to the html page (we will enqueue another request in requestCompleted)
+		const QString newsBody = SquarespaceJsonCache::itemBody(data).trimmed();
+		m_newsState = NewsStatus::DownloadMainPage;
+		if (newsBody.isEmpty()) {
+			m_nextRequestForNews = m_news->getData<NewsRoles::link>();
 			ret = true;
 		} else {
-			// We have to extract the links to images from the page and substitute them with the
-			// files where images will be stored
-			setNewsDescriptionAndExtractStuffs(newsBody);
-
-			// If there are images to download, changing the status of the news
-			ret = checkFilesToDownloadForNews();
+			ret = processNewsBody(newsBody);
 		}
 	} else if (m_newsState == NewsStatus::DownloadImages) {
 		// The image we downloaded is the first in the list. Saving to the first file, then removing
 		// both from the lists
-		QFile imageFile(m_imagesFiles.first());
-		if (imageFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-			if (imageFile.write(data) == -1) {
-				qDebug() << "Could not save image" << m_imagesUrls.first() << "to file" << m_imagesFiles.first();
+		FW::instance().writeFile(m_imagesFiles.first(), data, [url = m_imagesUrls.first(), file = m_imagesFiles.first()](bool success) {
+			if (!success) {
+				qDebug() << "Could not save image" << url << "to file" << file;
 			}
-		} else {
-			qDebug() << "Could open file" << m_imagesFiles.first() << "to write image" << m_imagesUrls.first();
-		}
+		});
 
 		// Removing the image we have just saved
 		m_imagesUrls.removeFirst();
@@ -334,8 +472,10 @@ bool IlRibelleNewsCompleter::parseDataForNews(const QByteArray& data)
 		// Checking if there is more to download
 		ret = checkFilesToDownloadForNews();
 	} else if (m_newsState == NewsStatus::DownloadRaz24Page) {
-		// We have to extract the link to the mp3 and other information
-		extractMp3UrlFromRaz24(data);
+		// We have to extract the link to the mp3 and other information. If we requested the JSON of
+		// the page, we only need the body of the item
+		const QString raz24Body = m_useJson ? SquarespaceJsonCache::itemBody(data) : QString();
+		extractMp3UrlFromRaz24(raz24Body.isEmpty() ? data : raz24Body.toUtf8());
 
 		// Checking if there is more to download
 		ret = checkFilesToDownloadForNews();
@@ -366,6 +506,32 @@ bool IlRibelleNewsCompleter::parseDataForNews(const QByteArray& data)
 	return ret;
 }
 
+bool IlRibelleNewsCompleter::processNewsBody(const QString& newsBody)
+{
+	// If we are processing the main page (i.e. the page from the link in the rss), we have to
+	// check if it contains a news from Massimo Fini and, if so, we have to download the page with
+	// the full news
+	QUrl finiPageUrl;
+	if ((m_newsState == NewsStatus::DownloadMainPage) && (newsFromFini(newsBody, &finiPageUrl))) {
+		// Here we discard the page just downloaded and add a request for another page. We also
+		// remember the url, so that next time we can download the page directly
+		m_nextRequestForNews = finiPageUrl;
+		FiniResolver::instance().setArchiveUrlForArticle(m_news->getData<NewsRoles::link>(), finiPageUrl);
+
+		// Changing the status and returning true (we will enqueue another request)
+		m_newsState = NewsStatus::DownloadFiniPage;
+
+		return true;
+	}
+
+	// We have to extract the links to images from the page and substitute them with the
+	// files where images will be stored
+	setNewsDescriptionAndExtractStuffs(newsBody);
+
+	// If there are images to download, changing the status of the news
+	return checkFilesToDownloadForNews();
+}
+
 void IlRibelleNewsCompleter::setNewsDescriptionAndExtractStuffs(const QString& newsBody)
 {
 //qDebug() << ((unsigned long) this) << m_news->id() << "IlRibelleNewsCompleter" << __func__;
@@ -380,6 +546,9 @@ void IlRibelleNewsCompleter::setNewsDescriptionAndExtractStuffs(const QString& n
 		qFatal(QString("INTERNAL ERROR: Could not find index of news with ID %1").arg(m_news->id()).toLatin1().data());
 	}
 
+	// Many roles are set here, grouping changes so that observers are notified only once
+	m_news->beginUpdate();
+
 	// Doing a global match of the img regular expression in the newsBody then
 	// using the iterator
 	QRegularExpressionMatchIterator it = m_imgTagRE.globalMatch(newsBody);
@@ -528,6 +697,8 @@ void IlRibelleNewsCompleter::setNewsDescriptionAndExtractStuffs(const QString& n
 
 	// Setting the body of the news
 	m_news->setData<NewsRoles::description>(outputNewsBody);
+
+	m_news->commit();
 }
 
 QString IlRibelleNewsCompleter::extractNewsBody(const QByteArray& data) const
@@ -634,7 +805,7 @@ bool IlRibelleNewsCompleter::checkFilesToDownloadForNews()
 		m_newsState = NewsStatus::DownloadRaz24Page;
 
 		// Requesting the Raz24 webpage
-		m_nextRequestForNews = m_raz24Page;
+		m_nextRequestForNews = m_useJson ? SquarespaceJsonCache::jsonUrl(m_raz24Page) : m_raz24Page;
 
 		ret = true;
 	}
@@ -646,6 +817,9 @@ void IlRibelleNewsCompleter::extractMp3UrlFromRaz24(const QByteArray& data)
 {
 //qDebug() << ((unsigned long) this) << m_news->id() << "IlRibelleNewsCompleter" << __func__;
 
+	// Grouping changes to roles so that observers are notified only once
+	m_news->beginUpdate();
+
 	// Looking for tags with information. We expect only one, but check more than once just to be sure
 	QRegularExpressionMatchIterator it = m_audioStreamInfoRE.globalMatch(data);
 	bool foundOne = false;
@@ -676,8 +850,11 @@ void IlRibelleNewsCompleter::extractMp3UrlFromRaz24(const QByteArray& data)
 			QString filename = m_news->getData<IlRibelleRoles::audioResourceUrl>().path();
 			filename = audioDownloadPath + filename.mid(filename.lastIndexOf("/"));
 			m_news->setData<IlRibelleRoles::audioResourcePath>(filename);
+			m_news->setData<NewsRoles::downloadedFiles>(QStringList(filename));
 		}
 
 		foundOne = true;
 	}
+
+	m_news->commit();
 }
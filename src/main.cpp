@@ -66,7 +66,7 @@ int main(int argc, char *argv[])
 	qmlRegisterSingletonType<MiscNative>("com.ilribelle", 1, 0, "MiscNative", miscNativeSingletonProvider);
 
 	// Creating the main object of the application
-	Controller controller(Type2Type<IlRibelleChannel>(), Type2Type<IlRibelleChannelUpdater>(), "www_ilribelle_com", QUrl("http://www.ilribelle.com/la-voce-del-ribelle/rss.xml"), ":/resources/about.html");
+	Controller controller(Type2Type<IlRibelleChannel>(), Type2Type<IlRibelleJsonChannelUpdater>(), "www_ilribelle_com", QUrl("http://www.ilribelle.com/la-voce-del-ribelle/rss.xml"), ":/resources/about.html");
 
 	// Creating the view and making controller accessible from QML
 	QQmlApplicationEngine qmlApp;
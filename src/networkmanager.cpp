@@ -21,6 +21,9 @@
 #include "include/networkmanager.h"
 #include <QCoreApplication>
 #include <QDebug>
+#ifdef Q_OS_ANDROID
+#include <QtAndroidExtras>
+#endif
 
 namespace __internal {
 	NetworkReplyHandler::NetworkReplyHandler(NetworkManager* manager, const QNetworkRequest& request, int id, DataAvailableNotifee* notifee, QObject* parent)
@@ -225,6 +228,35 @@ bool NetworkManager::getFile(QUrl url, DataAvailableNotifee* notifee, int id)
 	return true;
 }
 
+bool NetworkManager::isConnectionUnmetered() const
+{
+#ifdef Q_OS_ANDROID
+	// Asking the ConnectivityManager, which knows whether the network is metered (e.g. also
+	// for tethered WiFi)
+	const QAndroidJniObject service = QAndroidJniObject::fromString("connectivity");
+	const QAndroidJniObject connectivityManager = QtAndroid::androidActivity().callObjectMethod("getSystemService", "(Ljava/lang/String;)Ljava/lang/Object;", service.object<jstring>());
+
+	if (!connectivityManager.isValid()) {
+		return false;
+	}
+
+	const bool metered = connectivityManager.callMethod<jboolean>("isActiveNetworkMetered");
+
+	// In case of exceptions we assume the connection is metered
+	QAndroidJniEnvironment env;
+	if (env->ExceptionCheck()) {
+		env->ExceptionClear();
+
+		return false;
+	}
+
+	return !metered;
+#else
+	// On desktop connections are practically never metered
+	return true;
+#endif
+}
+
 void NetworkManager::replyRedirected(__internal::NetworkReplyHandler* replyHandler, QUrl newUrl)
 {
 //qDebug() << ((unsigned long) this) << replyHandler->id() << "NetworkManager" << __func__;
@@ -20,7 +20,14 @@
 
 #include "include/remotefileprovider.h"
 #include "include/networkmanager.h"
+#include "include/filewriter.h"
 #include <QFileInfo>
+#include <QPointer>
+
+namespace {
+	// The minimum interval in milliseconds between two notifications of the download progress
+	const qint64 progressNotificationInterval = 250;
+}
 
 RemoteFileProvider::RemoteFileProvider(QObject* parent)
 	: QObject(parent)
@@ -31,7 +38,10 @@ RemoteFileProvider::RemoteFileProvider(QObject* parent)
 	, m_downloadProgress(0)
 	, m_error(NoError)
 	, m_fileWatcher()
-	, m_partFile()
+	, m_partStream(-1)
+	, m_receivedBytes(0)
+	, m_totalBytes(-1)
+	, m_progressTimer()
 {
 	// Connecting the signal from the file watcher
 	connect(&m_fileWatcher, &QFileSystemWatcher::fileChanged, this, &RemoteFileProvider::downloadedFileChanged);
@@ -42,6 +52,10 @@ RemoteFileProvider::~RemoteFileProvider()
 	if (Downloading == m_status) {
 		interruptRequest(17);
 	}
+
+	if (m_partStream != -1) {
+		FW::instance().closeStream(m_partStream);
+	}
 }
 
 void RemoteFileProvider::setRemoteUrl(QUrl url)
@@ -142,23 +156,20 @@ void RemoteFileProvider::startDownload()
 
 	// Resetting the progress indicator
 	m_downloadProgress = 0;
+	m_receivedBytes = 0;
+	m_totalBytes = -1;
+	m_progressTimer.invalidate();
 	emit downloadProgressChanged();
 
-	// Creating the output file. Here we just create an empty file
-	QFile destFile(m_filePath);
-	if (!destFile.open(QFile::WriteOnly | QFile::Truncate)) {
-		setError(CannotCreateFile);
-
-		return;
-	}
-
-	// Creating the part file
-	m_partFile.setFileName(m_filePath + ".part");
-	if (!m_partFile.open(QFile::WriteOnly | QFile::Truncate)) {
-		setError(CannotCreateFile);
-
-		return;
-	}
+	// Creating the output file (here we just create an empty file, see setFilePath()) and the part
+	// file. Files are created by the FileWriter thread, if that fails the download is interrupted
+	FW::instance().writeFile(m_filePath, QByteArray());
+	QPointer<RemoteFileProvider> guard(this);
+	m_partStream = FW::instance().openStream(m_filePath + ".part", [guard](bool success) {
+		if (!success && guard) {
+			guard->partFileNotCreated();
+		}
+	});
 
 	// We use 17 as the ID of all our requests (which are never parallel)
 	const bool ret = NM::instance().getFile(m_remoteUrl, this, 17);
@@ -173,11 +184,13 @@ void RemoteFileProvider::startDownload()
 
 void RemoteFileProvider::interruptDownload()
 {
-	if (Downloading == m_status) {
+	// If all data has arrived, the part file is already being renamed
+	if ((Downloading == m_status) && (m_partStream != -1)) {
 		interruptRequest(17);
 
 		setStatus(DownloadInterrupted);
-		m_partFile.close();
+		FW::instance().closeStream(m_partStream);
+		m_partStream = -1;
 	}
 }
 
@@ -186,9 +199,10 @@ void RemoteFileProvider::removeDownload()
 	// Interrupting download if running
 	interruptDownload();
 
-	// Removing both the audio file and the part file
-	QFile::remove(m_filePath);
-	QFile::remove(m_filePath + ".part");
+	// Removing both the audio file and the part file. This is done after files have been
+	// closed, renamed or written
+	FW::instance().removeFile(m_filePath);
+	FW::instance().removeFile(m_filePath + ".part");
 
 	// Setting the status to NoDownload and resetting the error flag
 	setStatus(NoDownload);
@@ -209,31 +223,50 @@ void RemoteFileProvider::downloadedFileChanged(const QString& path)
 
 void RemoteFileProvider::dataArrived(int /*id*/, const QByteArray& data)
 {
+	if (m_partStream == -1) {
+		return;
+	}
+
 	// Appending to the part file
-	m_partFile.write(data);
+	FW::instance().appendToStream(m_partStream, data);
+	m_receivedBytes += data.size();
 
-	// Update the download progress
-	const float partSize = m_partFile.size();
-	const float totalSize = reply(17)->header(QNetworkRequest::ContentLengthHeader).toInt();
-	m_downloadProgress = int((partSize / totalSize) * 100.0);
-	emit downloadProgressChanged();
+	// The size of the file is read only once
+	if (m_totalBytes == -1) {
+		m_totalBytes = qMax(0LL, reply(17)->header(QNetworkRequest::ContentLengthHeader).toLongLong());
+	}
+
+	// Updating the download progress, without flooding the user interface with notifications
+	if ((m_totalBytes > 0) && (!m_progressTimer.isValid() || m_progressTimer.hasExpired(progressNotificationInterval))) {
+		const int progress = int(qMin(100LL, (m_receivedBytes * 100) / m_totalBytes));
+
+		if (progress != m_downloadProgress) {
+			m_downloadProgress = progress;
+			m_progressTimer.start();
+
+			emit downloadProgressChanged();
+		}
+	}
 }
 
 void RemoteFileProvider::allDataAvailable(int /*id*/)
 {
+	if (m_partStream == -1) {
+		return;
+	}
+
 	// Setting download progress to 100
 	m_downloadProgress = 100;
 	emit downloadProgressChanged();
 
-	// Closing the part file and renaming it
-	m_partFile.close();
-	QFile::remove(m_filePath);
-
-	if (!QFile::rename(m_filePath + ".part", m_filePath)) {
-		setError(CannotCreateFile);
-	} else {
-		setStatus(Downloaded);
-	}
+	// Closing the part file and renaming it once everything has been written
+	QPointer<RemoteFileProvider> guard(this);
+	FW::instance().closeStream(m_partStream, m_filePath, [guard](bool success) {
+		if (guard) {
+			guard->partFileRenamed(success);
+		}
+	});
+	m_partStream = -1;
 }
 
 void RemoteFileProvider::networkError(int id, const QString& description)
@@ -244,6 +277,34 @@ void RemoteFileProvider::networkError(int id, const QString& description)
 	setError(NetworkError);
 }
 
+void RemoteFileProvider::partFileNotCreated()
+{
+	if ((Downloading == m_status) && (m_partStream != -1)) {
+		interruptRequest(17);
+
+		setStatus(DownloadInterrupted);
+		FW::instance().closeStream(m_partStream);
+		m_partStream = -1;
+	}
+
+	setError(CannotCreateFile);
+}
+
+void RemoteFileProvider::partFileRenamed(bool success)
+{
+	// The download could have been removed in the meantime
+	if (Downloading != m_status) {
+		return;
+	}
+
+	if (!success) {
+		setStatus(DownloadInterrupted);
+		setError(CannotCreateFile);
+	} else {
+		setStatus(Downloaded);
+	}
+}
+
 void RemoteFileProvider::setStatus(States status)
 {
 	if (m_status != status) {
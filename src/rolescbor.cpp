@@ -0,0 +1,235 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#include "include/rolescbor.h"
+#include <limits>
+
+namespace {
+	// The value written for invalid dates
+	const qint64 invalidDate = std::numeric_limits<qint64>::min();
+}
+
+void RolesCbor::writeValue(QCborStreamWriter& writer, bool value)
+{
+	writer.append(value);
+}
+
+void RolesCbor::writeValue(QCborStreamWriter& writer, unsigned int value)
+{
+	writer.append(quint64(value));
+}
+
+void RolesCbor::writeValue(QCborStreamWriter& writer, int value)
+{
+	writer.append(qint64(value));
+}
+
+void RolesCbor::writeValue(QCborStreamWriter& writer, const QDateTime& value)
+{
+	writer.append(value.isValid() ? value.toMSecsSinceEpoch() : invalidDate);
+}
+
+void RolesCbor::writeValue(QCborStreamWriter& writer, const QString& value)
+{
+	writer.append(value);
+}
+
+void RolesCbor::writeValue(QCborStreamWriter& writer, const QUrl& value)
+{
+	writer.append(value.toString(QUrl::FullyEncoded));
+}
+
+void RolesCbor::writeValue(QCborStreamWriter& writer, const QStringList& value)
+{
+	writer.startArray(value.size());
+	for (const QString& s: value) {
+		writer.append(s);
+	}
+	writer.endArray();
+}
+
+bool RolesCbor::readValue(QCborStreamReader& reader, bool& value)
+{
+	if (!reader.isBool()) {
+		reader.next();
+
+		return false;
+	}
+
+	value = reader.toBool();
+
+	return reader.next();
+}
+
+bool RolesCbor::readValue(QCborStreamReader& reader, unsigned int& value)
+{
+	if (!reader.isUnsignedInteger() || (reader.toUnsignedInteger() > std::numeric_limits<unsigned int>::max())) {
+		reader.next();
+
+		return false;
+	}
+
+	value = static_cast<unsigned int>(reader.toUnsignedInteger());
+
+	return reader.next();
+}
+
+bool RolesCbor::readValue(QCborStreamReader& reader, int& value)
+{
+	qint64 v;
+	if (!readValue(reader, v)) {
+		return false;
+	}
+
+	if ((v < std::numeric_limits<int>::min()) || (v > std::numeric_limits<int>::max())) {
+		return false;
+	}
+
+	value = static_cast<int>(v);
+
+	return true;
+}
+
+bool RolesCbor::readValue(QCborStreamReader& reader, qint64& value)
+{
+	if (!reader.isInteger()) {
+		reader.next();
+
+		return false;
+	}
+
+	// Unsigned values which don't fit in a qint64 are rejected
+	if (reader.isUnsignedInteger() && (reader.toUnsignedInteger() > quint64(std::numeric_limits<qint64>::max()))) {
+		reader.next();
+
+		return false;
+	}
+
+	value = reader.toInteger();
+
+	return reader.next();
+}
+
+bool RolesCbor::readValue(QCborStreamReader& reader, QDateTime& value)
+{
+	qint64 msecs;
+	if (!readValue(reader, msecs)) {
+		return false;
+	}
+
+	value = (msecs == invalidDate) ? QDateTime() : QDateTime::fromMSecsSinceEpoch(msecs);
+
+	return true;
+}
+
+bool RolesCbor::readValue(QCborStreamReader& reader, QString& value)
+{
+	if (!reader.isString()) {
+		reader.next();
+
+		return false;
+	}
+
+	// Strings can be split in chunks, here we concatenate them
+	QString s;
+	auto r = reader.readString();
+	while (r.status == QCborStreamReader::Ok) {
+		s += r.data;
+		r = reader.readString();
+	}
+
+	if (r.status == QCborStreamReader::Error) {
+		return false;
+	}
+
+	value = std::move(s);
+
+	return true;
+}
+
+bool RolesCbor::readValue(QCborStreamReader& reader, QUrl& value)
+{
+	QString s;
+	if (!readValue(reader, s)) {
+		return false;
+	}
+
+	value = QUrl(s, QUrl::StrictMode);
+
+	return true;
+}
+
+bool RolesCbor::readValue(QCborStreamReader& reader, QStringList& value)
+{
+	if (!reader.isArray() || !reader.enterContainer()) {
+		reader.next();
+
+		return false;
+	}
+
+	QStringList l;
+	if (reader.isLengthKnown()) {
+		l.reserve(static_cast<int>(qMin(reader.length(), quint64(std::numeric_limits<int>::max()))));
+	}
+
+	bool ok = true;
+	while (reader.hasNext() && (reader.lastError() == QCborError::NoError)) {
+		QString s;
+		if (readValue(reader, s)) {
+			l.append(std::move(s));
+		} else {
+			ok = false;
+		}
+	}
+
+	if (!reader.leaveContainer() || !ok) {
+		return false;
+	}
+
+	value = std::move(l);
+
+	return true;
+}
+
+int RolesCbor::readKey(QCborStreamReader& reader, char* buffer, int bufferSize)
+{
+	if (!reader.isString()) {
+		reader.next();
+
+		return -1;
+	}
+
+	// Reading chunks one after the other. If the key doesn't fit, the rest
+	// of the string is skipped
+	int length = 0;
+	bool fits = true;
+	auto r = reader.readStringChunk(buffer, bufferSize);
+	while (r.status == QCborStreamReader::Ok) {
+		if (fits && (r.data <= bufferSize - length)) {
+			length += static_cast<int>(r.data);
+		} else {
+			fits = false;
+		}
+
+		r = fits ? reader.readStringChunk(buffer + length, bufferSize - length) : reader.readStringChunk(nullptr, 0);
+	}
+
+	return ((r.status == QCborStreamReader::EndOfString) && fits) ? length : -1;
+}
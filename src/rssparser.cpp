@@ -238,10 +238,11 @@ void RssParser::readItemInfo()
 					m_status = States::ReadingChannel;
 
 					// Here we also set the list of categories
-					m_currentNewsRoles.setData<NewsRoles::categories>(m_newsCategories);
+					m_currentNewsRoles.setData<NewsRoles::categories>(std::move(m_newsCategories));
 
-					// Adding the news
-					m_channel->addStandardNews(m_currentNewsRoles);
+					// Adding the news. Data is moved into the news, m_currentNewsRoles and
+					// m_newsCategories are reset when the next item starts
+					m_channel->addStandardNews(std::move(m_currentNewsRoles));
 
 					return;
 				}
@@ -391,6 +392,7 @@ void RssParser::readItemTagData()
 			m_newsCategories.append(m_reader.text().toString());
 		} else if (m_openedTags[1] == "guid") {
 			const QString guid = m_reader.text().toString();
+			m_currentNewsRoles.setData<NewsRoles::guid>(guid);
 
 			if (m_guidIsPermalink) {
 				m_currentNewsRoles.setData<NewsRoles::permalink>(QUrl(guid));
@@ -0,0 +1,170 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#include "include/squarespacejsoncache.h"
+#include "include/networkmanager.h"
+#include <QUrlQuery>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QDebug>
+
+SquarespaceJsonCache::SquarespaceJsonCache()
+	: AllDataArrivedNotifee()
+	, m_collections()
+	, m_requests()
+	, m_nextRequestId(0)
+{
+}
+
+SquarespaceJsonCache::~SquarespaceJsonCache()
+{
+	// Nothing to do here
+}
+
+void SquarespaceJsonCache::item(unsigned int id, const QUrl& itemUrl, const std::function<void(QJsonObject)>& callback)
+{
+	const QUrl collection = collectionUrl(itemUrl);
+	if (!collection.isValid()) {
+		callback(QJsonObject());
+
+		return;
+	}
+
+	Collection& c = m_collections[collection];
+
+	// If we already have the collection, we can answer immediately
+	if (c.downloaded) {
+		callback(c.items.value(itemUrl.path()));
+
+		return;
+	}
+
+	// Downloading the collection if we are not already doing it
+	if (!m_requests.values().contains(collection)) {
+		const int requestId = m_nextRequestId++;
+		m_requests.insert(requestId, collection);
+
+		NM::instance().getFile(jsonUrl(collection), this, requestId);
+	}
+
+	c.pendingRequests.append(PendingRequest{id, itemUrl.path(), callback});
+}
+
+void SquarespaceJsonCache::cancel(unsigned int id)
+{
+	for (auto& c: m_collections) {
+		for (int i = 0; i < c.pendingRequests.size(); ++i) {
+			if (c.pendingRequests[i].id == id) {
+				c.pendingRequests.removeAt(i);
+
+				return;
+			}
+		}
+	}
+}
+
+void SquarespaceJsonCache::invalidate()
+{
+	// Collections being downloaded are kept, they are already up-to-date
+	for (auto it = m_collections.begin(); it != m_collections.end();) {
+		if (it.value().downloaded) {
+			it = m_collections.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+QUrl SquarespaceJsonCache::jsonUrl(const QUrl& url)
+{
+	QUrl ret = url;
+
+	QUrlQuery query(ret);
+	query.removeAllQueryItems("format");
+	query.addQueryItem("format", "json");
+	ret.setQuery(query);
+
+	return ret;
+}
+
+QString SquarespaceJsonCache::itemBody(const QByteArray& data)
+{
+	const QJsonDocument document = QJsonDocument::fromJson(data);
+
+	return document.object().value("item").toObject().value("body").toString();
+}
+
+void SquarespaceJsonCache::allDataArrived(int id, const QByteArray& data)
+{
+	auto it = m_collections.find(m_requests.value(id));
+	if (it == m_collections.end()) {
+		return;
+	}
+
+	// Storing all items with a body
+	const QJsonArray items = QJsonDocument::fromJson(data).object().value("items").toArray();
+	for (const auto& i: items) {
+		const QJsonObject item = i.toObject();
+		const QString path = item.value("fullUrl").toString();
+
+		if (!path.isEmpty() && !item.value("body").toString().isEmpty()) {
+			it.value().items.insert(QUrl(path).path(), item);
+		}
+	}
+}
+
+void SquarespaceJsonCache::requestCompleted(int id)
+{
+	// Here we get both in case of success and in case of errors. In the latter case there are
+	// no items and all requests are resolved with an empty object
+	auto it = m_collections.find(m_requests.take(id));
+	if (it == m_collections.end()) {
+		return;
+	}
+
+	it.value().downloaded = true;
+
+	if (it.value().items.isEmpty()) {
+		qDebug() << "No items found in the Squarespace collection" << it.key();
+	}
+
+	// Taking the list of pending requests and items because callbacks could add or cancel
+	// requests or invalidate the cache
+	QList<PendingRequest> requests;
+	requests.swap(it.value().pendingRequests);
+	const QHash<QString, QJsonObject> items = it.value().items;
+
+	for (const auto& r: requests) {
+		r.callback(items.value(r.itemPath));
+	}
+}
+
+QUrl SquarespaceJsonCache::collectionUrl(const QUrl& itemUrl)
+{
+	const QStringList pathComponents = itemUrl.path().split("/", QString::SkipEmptyParts);
+	if (pathComponents.size() < 2) {
+		return QUrl();
+	}
+
+	QUrl ret = itemUrl.adjusted(QUrl::RemoveQuery | QUrl::RemoveFragment);
+	ret.setPath("/" + pathComponents.first());
+
+	return ret;
+}
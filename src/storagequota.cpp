@@ -0,0 +1,151 @@
+/******************************************************************************
+ * IlRibelle.com                                                              *
+ * Copyright (C) 2014                                                         *
+ * Tomassino Ferrauto <t_ferrauto@yahoo.it>                                   *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or modify       *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation; either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software                *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ ******************************************************************************/
+
+#include "include/storagequota.h"
+#include "include/utilities.h"
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <algorithm>
+
+StorageQuota::StorageQuota()
+	: m_pool()
+	, m_check()
+	, m_fileSizes()
+	, m_usedBytes()
+{
+	// A single thread is enough, checks never run in parallel
+	m_pool.setMaxThreadCount(1);
+
+	m_usedBytes.fill(0);
+}
+
+StorageQuota::~StorageQuota()
+{
+	if (m_check) {
+		m_check->cancelled = true;
+	}
+	m_pool.waitForDone();
+}
+
+void StorageQuota::check(QVector<NewsFiles> news, Bytes quotas, Callback callback)
+{
+	if (m_check) {
+		return;
+	}
+
+	auto check = std::make_shared<Check>();
+	check->storageQuota = this;
+	check->news = std::move(news);
+	check->quotas = quotas;
+	check->callback = callback;
+	check->fileSizes.swap(m_fileSizes);
+	check->usedBytes.fill(0);
+	check->cancelled = false;
+
+	m_check = check;
+
+	m_pool.start(new CommandRunnable([check]() { measureAndEvict(check); }));
+}
+
+void StorageQuota::measureAndEvict(const std::shared_ptr<Check>& check)
+{
+	// Measuring files, the cache is rebuilt so that it only contains the files that still exist
+	QHash<QString, qint64> fileSizes;
+	QVector<Bytes> newsBytes(check->news.size());
+	for (int i = 0; i < check->news.size(); ++i) {
+		for (int t = 0; t < numFileTypes; ++t) {
+			newsBytes[i][t] = 0;
+
+			for (const auto& f: check->news[i].files[t]) {
+				auto it = check->fileSizes.constFind(f);
+				qint64 size = 0;
+
+				if (it != check->fileSizes.constEnd()) {
+					size = it.value();
+				} else {
+					// Files that don't exist (e.g. not downloaded yet) are not stored, they
+					// could be created later
+					QFileInfo info(f);
+					if (!info.exists()) {
+						continue;
+					}
+
+					size = info.size();
+				}
+
+				fileSizes.insert(f, size);
+				newsBytes[i][t] += size;
+			}
+
+			check->usedBytes[t] += newsBytes[i][t];
+		}
+	}
+
+	// The news whose files can be evicted, from the least recently accessed
+	QVector<int> candidates;
+	for (int i = 0; i < check->news.size(); ++i) {
+		if (check->news[i].evictable) {
+			candidates.append(i);
+		}
+	}
+	std::stable_sort(candidates.begin(), candidates.end(), [&check](int a, int b) { return check->news[a].lastAccess < check->news[b].lastAccess; });
+
+	for (int t = 0; t < numFileTypes; ++t) {
+		if (check->quotas[t] <= 0) {
+			continue;
+		}
+
+		for (int i = 0; (i < candidates.size()) && (check->usedBytes[t] > check->quotas[t]); ++i) {
+			const int c = candidates[i];
+
+			if (newsBytes[c][t] == 0) {
+				continue;
+			}
+
+			check->evictions.append(Eviction{check->news[c].id, static_cast<FileType>(t)});
+			check->usedBytes[t] -= newsBytes[c][t];
+
+			for (const auto& f: check->news[c].files[t]) {
+				fileSizes.remove(f);
+			}
+		}
+	}
+
+	check->fileSizes.swap(fileSizes);
+
+	// The list of news is not needed anymore
+	check->news.clear();
+
+	QCoreApplication::postEvent(&(CommandEventReceiver::instance()), new CommandEvent([check]() {
+		if (!check->cancelled) {
+			check->storageQuota->checkFinished(check);
+		}
+	}));
+}
+
+void StorageQuota::checkFinished(const std::shared_ptr<Check>& check)
+{
+	m_check.reset();
+
+	m_fileSizes.swap(check->fileSizes);
+	m_usedBytes = check->usedBytes;
+
+	check->callback(check->evictions);
+}
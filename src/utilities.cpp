@@ -67,6 +67,18 @@ void CommandEvent::executeCommand()
 	m_command();
 }
 
+CommandRunnable::CommandRunnable(const std::function<void()>& command)
+	: QRunnable()
+	, m_command(command)
+{
+	setAutoDelete(true);
+}
+
+void CommandRunnable::run()
+{
+	m_command();
+}
+
 CommandEventReceiverClass::CommandEventReceiverClass()
 	: QObject()
 {